@@ -19,6 +19,7 @@ extern "C" {
 
 #include "../../modem/include/esp_modem_dce_service.h"
 #include "../../modem/include/esp_modem.h"
+#include "../../modem/include/esp_modem_async.h"
 
 
 typedef enum
@@ -27,6 +28,59 @@ typedef enum
    EC21_DTR_CMD_MODE,                    /**< LowHigh on DTR: Change to command mode while remaining the connected call. */
    EC21_DTR_CMD_MODE_AND_DISCONNECT,    /**< LowHigh on DTR: Disconnect data call, and change  */
 }ec21_dtrMode_t;
+
+/**
+ * @brief Timing of the last ec21_configure()
+ *
+ */
+typedef struct {
+    uint32_t total_ms;              /*!< Duration of the configuration */
+    uint32_t waited_ms;             /*!< Time spent waiting for the module readiness */
+    uint32_t legacy_sleep_ms;       /*!< Fixed sleeps the previous sequence had on the same path */
+    int32_t saved_ms;               /*!< legacy_sleep_ms - waited_ms */
+    uint32_t fast_shutdown_retries; /*!< Failed attempts to enable the fast shutdown */
+    uint32_t baudrate;              /*!< Baud rate negotiated with the module */
+} ec21_startup_report_t;
+
+/**
+ * @brief Modem status read by ec21_poll_status_async()
+ *
+ */
+typedef struct {
+    uint32_t rssi;                          /*!< Received signal strength indication (AT+CSQ) */
+    uint32_t ber;                           /*!< Bit error ratio (AT+CSQ) */
+    modem_network_status_t network_status;  /*!< Network registration status (AT+CREG?) */
+    uint32_t bcs;                           /*!< Battery charge status (AT+CBC) */
+    uint32_t bcl;                           /*!< Battery connection level (AT+CBC) */
+    uint32_t voltage;                       /*!< Battery voltage (AT+CBC) */
+    esp_err_t result;                       /*!< ESP_OK if every value has been read */
+    int pending;                            /*!< Queries still in flight (internal) */
+    esp_modem_async_done_cb_t done_cb;      /*!< Completion callback (internal) */
+    void *context;                          /*!< Completion callback context (internal) */
+} ec21_status_t;
+
+/**
+ * @brief Network registration reported by the module (+CREG or +CEREG)
+ *
+ */
+typedef struct {
+    modem_network_status_t status;  /*!< Registration status */
+    uint32_t lac;                   /*!< Location area code (TAC for +CEREG), 0 if not reported */
+    uint32_t cell_id;               /*!< Cell ID, 0 if not reported */
+    int32_t act;                    /*!< Access technology (7: E-UTRAN), -1 if not reported */
+} ec21_registration_t;
+
+/**
+ * @brief Module identity read by ec21_get_module_info()
+ *
+ */
+typedef struct {
+    char name[MODEM_MAX_NAME_LENGTH];       /*!< Module name */
+    char imei[MODEM_IMEI_LENGTH + 1];       /*!< IMEI number */
+    char imsi[MODEM_IMSI_LENGTH + 1];       /*!< IMSI number */
+    char oper[MODEM_MAX_OPERATOR_LENGTH];   /*!< Operator name */
+} ec21_module_identity_t;
+
 /**
  * @brief Create and initialize EC21 object
  *
@@ -35,10 +89,57 @@ typedef enum
  */
 modem_dce_t *ec21_init(modem_dte_t *dte);
 
+/**
+ * @brief Configure the module once it has booted
+ *
+ * Every step is gated on the readiness reported by the module (RDY, +CPIN: READY, +QIND: SMS DONE/PB DONE)
+ * or on answered AT probes, with bounded waits instead of fixed sleeps.
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
 esp_err_t ec21_configure( modem_dce_t * dce );
 
+/**
+ * @brief Get the timing of the last ec21_configure(), including the time saved compared to fixed sleeps
+ *
+ * @param[out] report startup report
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t ec21_get_startup_report( ec21_startup_report_t *report );
+
+/**
+ * @brief Read the module identity (name, IMEI, IMSI) and the operator name into the DCE
+ *
+ * The identity is persisted in NVS, keyed on the SIM ICCID (AT+QCCID): while the same SIM is inserted it is
+ * served from the cache and checked in the background by the asynchronous command engine when started
+ * (esp_modem_async_start()), otherwise only the operator is read. A different SIM invalidates the cache.
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
 esp_err_t ec21_get_module_info( modem_dce_t * dce );
 
+/**
+ * @brief Copy the module identity and the operator name read by ec21_get_module_info()
+ *
+ * The background refresh of a cached identity updates the DCE fields from the command engine task:
+ * this copy is consistent with it, unlike reading the fields of the DCE directly.
+ *
+ * @param dce Modem DCE object
+ * @param[out] identity module identity
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid arguments
+ */
+esp_err_t ec21_get_identity( modem_dce_t * dce, ec21_module_identity_t * identity );
+
 esp_err_t ec21_enable_roaming( modem_dce_t * dce, bool isEnabled );
 
 esp_err_t ec21_get_band7_state( modem_dce_t * dce, bool * isEnabled );
@@ -47,6 +148,79 @@ esp_err_t ec21_set_band7_state(modem_dce_t *ec21_dce, bool enable );
 
 esp_err_t ec21_get_network_extended_info(modem_dce_t *dce );
 
+/**
+ * @brief Scan the available operators (AT+COPS=?)
+ *
+ * The response is streamed to the consumer, the operator list can be longer than the line buffer.
+ *
+ * @param dce Modem DCE object
+ * @param response_cb consumer of the response chunks
+ * @param context consumer context
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t ec21_get_operator_list( modem_dce_t * dce, modem_response_cb_t response_cb, void *context );
+
+/**
+ * @brief Read the neighbour cells information (AT+QENG="neighbourcell")
+ *
+ * @param dce Modem DCE object
+ * @param response_cb consumer of the response chunks, one +QENG line per cell
+ * @param context consumer context
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t ec21_get_neighbour_cells( modem_dce_t * dce, modem_response_cb_t response_cb, void *context );
+
+/**
+ * @brief Read signal quality, network registration and battery status in one round trip
+ *
+ * The queries are queued to the asynchronous command engine (esp_modem_async_start()), which sends them
+ * on one command line. Returns immediately, done_cb is called from the engine task once all values are read.
+ *
+ * @param dce Modem DCE object
+ * @param status status storage, must stay valid until done_cb is called
+ * @param done_cb completion callback, result is the first error of the queries
+ * @param context completion callback context
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL if the queries could not be queued
+ */
+esp_err_t ec21_poll_status_async( modem_dce_t * dce, ec21_status_t * status, esp_modem_async_done_cb_t done_cb, void *context );
+
+/**
+ * @brief Get the last network registration reported by the module, without sending any command
+ *
+ * ec21_configure() enables the unsolicited reports (AT+CREG=2, AT+CEREG=2), which keep the cache up to date
+ * in command mode and in PPP mode with the multiplexer started (esp_modem_start_cmux()).
+ * The EPS registration (+CEREG) is preferred when registered, the CS one (+CREG) otherwise.
+ *
+ * @param dce Modem DCE object
+ * @param[out] registration last registration reported
+ * @param[out] age_ms time elapsed since it was reported, NULL if not needed
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid arguments
+ *      - ESP_ERR_NOT_FOUND if nothing has been reported yet
+ */
+esp_err_t ec21_get_cached_registration( modem_dce_t * dce, ec21_registration_t * registration, uint32_t * age_ms );
+
+/**
+ * @brief Get the last signal quality reported by the module (+QIND: "csq" or AT+CSQ), without sending any command
+ *
+ * @param dce Modem DCE object
+ * @param[out] rssi received signal strength indication
+ * @param[out] ber bit error ratio
+ * @param[out] age_ms time elapsed since it was reported, NULL if not needed
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid arguments
+ *      - ESP_ERR_NOT_FOUND if nothing has been reported yet
+ */
+esp_err_t ec21_get_cached_signal_quality( modem_dce_t * dce, uint32_t * rssi, uint32_t * ber, uint32_t * age_ms );
+
 
 
 #ifdef __cplusplus
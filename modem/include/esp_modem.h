@@ -21,7 +21,11 @@ extern "C" {
 #include "esp_modem_dte.h"
 #include "esp_event.h"
 #include "driver/uart.h"
+#include "esp_heap_caps.h"
 #include "esp_modem_compat.h"
+#include "esp_modem_arena.h"
+#include "esp_modem_arbiter.h"
+#include "esp_modem_latency.h"
 
 /**
  * @brief Declare Event Base for ESP Modem
@@ -29,6 +33,8 @@ extern "C" {
  */
 ESP_EVENT_DECLARE_BASE(ESP_MODEM_EVENT);
 
+#define ESP_MODEM_URC_HANDLERS_MAX (16) /*!< Max handlers of unsolicited result codes per DTE */
+
 /**
  * @brief ESP Modem Event
  *
@@ -39,6 +45,19 @@ typedef enum {
     ESP_MODEM_EVENT_UNKNOWN   = 4        /*!< ESP Modem Unknown Response */
 } esp_modem_event_t;
 
+/**
+ * @brief Memory capabilities (MALLOC_CAP_*) of the DTE buffers
+ *
+ * Buffers are placed anywhere if no memory with the requested capabilities is left.
+ */
+typedef struct {
+    uint32_t dte_caps;              /*!< DTE object, touched on every received byte */
+    uint32_t line_caps;             /*!< Line buffer and line framer ring */
+    uint32_t rx_caps;               /*!< PPP RX chunk buffer */
+    uint32_t tx_caps;               /*!< TX staging buffer and CMUX TX buffer */
+    uint32_t event_caps;            /*!< Event ring, large and only used by unsolicited lines */
+} esp_modem_dte_placement_t;
+
 /**
  * @brief ESP Modem DTE Configuration
  *
@@ -54,13 +73,27 @@ typedef struct {
     int rx_io_num;                  /*!< RXD Pin Number */
     int rts_io_num;                 /*!< RTS Pin Number */
     int cts_io_num;                 /*!< CTS Pin Number */
+    int dtr_io_num;                 /*!< DTR Pin Number (active low), UART_PIN_NO_CHANGE if not wired */
     int rx_buffer_size;             /*!< UART RX Buffer Size */
     int tx_buffer_size;             /*!< UART TX Buffer Size */
-    int pattern_queue_size;         /*!< UART Pattern Queue Size */
+    int pattern_queue_size;         /*!< UART Pattern Queue Size (unused, lines are framed in software) */
     int event_queue_size;           /*!< UART Event Queue Size */
     uint32_t event_task_stack_size; /*!< UART Event Task Stack size */
     int event_task_priority;        /*!< UART Event Task Priority */
     int line_buffer_size;           /*!< Line buffer size for command mode */
+    bool rx_zero_copy;              /*!< Read PPP data straight into network stack buffers when available */
+    int ppp_rx_chunk_size;          /*!< Max size of one read from the UART in PPP mode */
+    bool ppp_rx_framing;            /*!< Decode the PPP frames in the DTE and pass validated frames (needs receive_frame) */
+    bool rx_overflow_resync;        /*!< On UART overflow, drop only the damaged data and resync on the next frame/line boundary */
+    uint32_t event_loop_task_stack_size; /*!< Modem event loop task stack size, 0 to dispatch events from the UART event task */
+    int event_loop_task_priority;   /*!< Modem event loop task priority */
+    uint32_t event_ring_slots;      /*!< Events the UART event task can publish ahead of the event loop, power of two */
+    int tx_queue_size;              /*!< Size of the PPP TX frame queue (bytes), 0 to write the frames synchronously */
+    uint32_t tx_task_stack_size;    /*!< Modem TX task stack size */
+    int tx_task_priority;           /*!< Modem TX task priority */
+    esp_modem_dte_placement_t placement; /*!< Memory capabilities of the DTE buffers */
+    esp_modem_arena_t *arena;       /*!< Storage of the DTE, DCE, netif adapter and buffers (static configuration), NULL to use the heap */
+    bool adaptive_timeouts;         /*!< Derive the command timeouts from the measured response times, see esp_modem_get_command_latency() */
 } esp_modem_dte_config_t;
 
 /**
@@ -69,6 +102,96 @@ typedef struct {
  */
 typedef esp_err_t (*esp_modem_on_receive)(void *buffer, size_t len, void *context);
 
+/**
+ * @brief Buffer callbacks used for zero-copy reception
+ *
+ * The DTE gets an rx buffer from the network layer, reads the UART data straight into its payload
+ * and hands the buffer over with receive(): the ownership is transferred and the DTE never touches
+ * the buffer again. Buffers which could not be filled are returned with free().
+ */
+typedef struct {
+    void *(*get)(size_t size, uint8_t **payload, void *context);      /*!< Get an rx buffer with at least size bytes of payload */
+    esp_err_t (*receive)(void *rx_buffer, size_t len, void *context); /*!< Pass a filled rx buffer (takes ownership) */
+    void (*free)(void *rx_buffer, void *context);                     /*!< Release an unused rx buffer */
+    esp_err_t (*receive_frame)(void *rx_buffer, size_t offset, size_t len, void *context); /*!< Pass a decoded PPP frame (protocol and information field at offset, takes ownership), NULL if not supported */
+    void *context;                                                    /*!< Context passed to the callbacks */
+} esp_modem_rx_buffer_ops_t;
+
+/**
+ * @brief ESP Modem DTE statistics
+ *
+ */
+typedef struct {
+    uint64_t rx_bytes;              /*!< Bytes received in PPP mode */
+    uint64_t rx_copied_bytes;       /*!< Bytes copied on their way from the UART ring buffer to the network stack */
+    uint32_t rx_data_events;        /*!< UART data events handled in PPP mode */
+    uint32_t rx_data_events_coalesced; /*!< UART data events skipped because their data were already drained */
+    uint32_t rx_chunks;             /*!< Reads from the UART in PPP mode */
+    uint32_t events_posted;         /*!< Modem events posted to the event loop */
+    uint32_t events_post_failed;    /*!< Modem events which could not be posted */
+    uint32_t events_dispatched;     /*!< Modem events dispatched to the handlers */
+    uint32_t event_latency_last_us; /*!< Delay from post to dispatch of the last event */
+    uint32_t event_latency_max_us;  /*!< Max delay from post to dispatch */
+    uint64_t event_latency_total_us; /*!< Sum of the delays from post to dispatch */
+    uint32_t rx_fifo_overflows;     /*!< UART hardware FIFO overflows (data lost) */
+    uint32_t rx_buffer_full;        /*!< UART ring buffer full events (data held back, not lost) */
+    uint32_t rx_resyncs;            /*!< Resynchronizations on a frame/line boundary after an overflow */
+    uint32_t rx_resync_dropped_bytes; /*!< Bytes dropped while resynchronizing */
+    uint32_t rx_frame_errors;       /*!< UART frame errors (wrong baud rate or noisy line) */
+    uint32_t rx_parity_errors;      /*!< UART parity errors */
+    uint32_t rx_breaks;             /*!< UART break conditions */
+    uint32_t rx_frames;             /*!< PPP frames decoded and delivered (ppp_rx_framing) */
+    uint32_t rx_frame_fcs_errors;   /*!< PPP frames dropped because of a bad FCS (ppp_rx_framing) */
+    uint32_t rx_frames_dropped;     /*!< PPP frames dropped otherwise: aborted, too long or no buffer (ppp_rx_framing) */
+    uint32_t cmux_frames;           /*!< CMUX frames received (multiplexer started) */
+    uint32_t cmux_fcs_errors;       /*!< CMUX frames dropped because of a bad FCS */
+    uint32_t cmux_frames_dropped;   /*!< CMUX frames dropped otherwise: too long or not terminated */
+    uint32_t urc_routed;            /*!< Unsolicited lines passed to the handlers of their prefix */
+    uint32_t urc_posted;            /*!< Unsolicited lines without handler posted as ESP_MODEM_EVENT_UNKNOWN */
+    uint32_t urc_dropped;           /*!< Unsolicited lines lost because the event ring was full, or without handler in the static configuration */
+    uint32_t event_ring_pending;    /*!< Events published by the UART event task, not posted to the event loop yet */
+    uint32_t event_ring_peak;       /*!< Max events waiting in the event ring */
+    uint32_t event_ring_dropped;    /*!< Events dropped because the event ring was full */
+    uint32_t tx_frames;             /*!< PPP frames passed to the TX queue */
+    uint32_t tx_frames_dropped;     /*!< PPP frames rejected because the TX queue was full */
+    uint32_t tx_frames_coalesced;   /*!< PPP frames written together with the previous ones */
+    uint32_t tx_writes;             /*!< UART writes of the TX task */
+    uint64_t tx_bytes;              /*!< Bytes written by the TX task */
+    uint32_t tx_queue_depth;        /*!< Frames currently waiting in the TX queue */
+    uint32_t tx_queue_depth_max;    /*!< Max frames waiting in the TX queue */
+    uint32_t tx_latency_last_us;    /*!< Time the last frame spent in the TX queue */
+    uint32_t tx_latency_max_us;     /*!< Max time a frame spent in the TX queue */
+    uint64_t tx_latency_total_us;   /*!< Sum of the times the frames spent in the TX queue */
+} esp_modem_dte_stats_t;
+
+/**
+ * @brief Memory footprint of one DTE buffer
+ *
+ */
+typedef struct {
+    const char *name;               /*!< Buffer name, NULL if not allocated */
+    size_t size;                    /*!< Size in bytes */
+    uint32_t caps;                  /*!< Requested memory capabilities */
+    bool external;                  /*!< Placed in SPIRAM */
+} esp_modem_buffer_footprint_t;
+
+/**
+ * @brief Memory footprint of the DTE, where each buffer was allocated
+ *
+ */
+typedef struct {
+    esp_modem_buffer_footprint_t dte;        /*!< DTE object */
+    esp_modem_buffer_footprint_t line;       /*!< Line buffer */
+    esp_modem_buffer_footprint_t line_ring;  /*!< Line framer ring */
+    esp_modem_buffer_footprint_t ppp_rx;     /*!< PPP RX chunk buffer */
+    esp_modem_buffer_footprint_t event_ring; /*!< Event ring */
+    esp_modem_buffer_footprint_t tx_staging; /*!< TX staging buffer */
+    esp_modem_buffer_footprint_t cmux_tx;    /*!< CMUX TX buffer (allocated when the multiplexer starts) */
+    esp_modem_buffer_footprint_t cmux_line_ring; /*!< CMUX PPP channel line ring (allocated likewise) */
+    size_t internal_bytes;          /*!< Bytes in internal RAM */
+    size_t external_bytes;          /*!< Bytes in SPIRAM */
+} esp_modem_dte_footprint_t;
+
 /**
  * @brief ESP Modem DTE Default Configuration
  *
@@ -85,18 +208,43 @@ typedef esp_err_t (*esp_modem_on_receive)(void *buffer, size_t len, void *contex
         .rx_io_num =            CONFIG_UART_MODEM_RX_PIN,                 \
         .rts_io_num =           CONFIG_EXAMPLE_UART_MODEM_RTS_PIN,        \
         .cts_io_num =           CONFIG_EXAMPLE_UART_MODEM_CTS_PIN,        \
+        .dtr_io_num =           UART_PIN_NO_CHANGE,                       \
         .rx_buffer_size =       CONFIG_UART_RX_BUFFER_SIZE,               \
         .tx_buffer_size =       CONFIG_UART_TX_BUFFER_SIZE,               \
         .pattern_queue_size =   CONFIG_UART_PATTERN_QUEUE_SIZE,           \
         .event_queue_size =     CONFIG_UART_EVENT_QUEUE_SIZE,             \
         .event_task_stack_size = CONFIG_UART_EVENT_TASK_STACK_SIZE,       \
         .event_task_priority =  CONFIG_UART_EVENT_TASK_PRIORITY,          \
-        .line_buffer_size =     CONFIG_UART_RX_BUFFER_SIZE/2              \
+        .line_buffer_size =     CONFIG_UART_RX_BUFFER_SIZE/2,             \
+        .rx_zero_copy =         true,                                     \
+        .ppp_rx_chunk_size =    1536,                                     \
+        .ppp_rx_framing =       false,                                    \
+        .rx_overflow_resync =   true,                                     \
+        .event_loop_task_stack_size = 3072,                               \
+        .event_loop_task_priority = CONFIG_UART_EVENT_TASK_PRIORITY,      \
+        .event_ring_slots =     16,                                       \
+        .tx_queue_size =        8192,                                     \
+        .tx_task_stack_size =   2048,                                     \
+        .tx_task_priority =     CONFIG_UART_EVENT_TASK_PRIORITY,          \
+        .placement = {                                                    \
+            .dte_caps =         MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT,    \
+            .line_caps =        MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT,    \
+            .rx_caps =          MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT,    \
+            .tx_caps =          MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT,    \
+            .event_caps =       MALLOC_CAP_SPIRAM                         \
+        },                                                                \
+        .arena =                NULL,                                     \
+        .adaptive_timeouts =    true                                      \
     }
 
 /**
  * @brief Create and initialize Modem DTE object
  *
+ * With config->arena set (static configuration), the DTE, its buffers, the DCE, the netif adapter and the
+ * asynchronous command engine are allocated from the arena, and no heap allocation is made after the
+ * initialization: lines without URC handler are not posted (see esp_modem_add_urc_handler()) and the events
+ * are posted without data. The arena must outlive the DTE.
+ *
  * @param config configuration of ESP Modem DTE object
  * @return modem_dte_t*
  *      - Modem DTE object
@@ -127,6 +275,47 @@ esp_err_t esp_modem_set_event_handler(modem_dte_t *dte, esp_event_handler_t hand
  */
 esp_err_t esp_modem_remove_event_handler(modem_dte_t *dte, esp_event_handler_t handler);
 
+/**
+ * @brief Handler of unsolicited result codes, called from the DTE receive task
+ *
+ * The handler must not block: the line is only valid during the call and the reception waits for it.
+ *
+ * @param dte Modem DTE object
+ * @param line classified line
+ * @param context context given to esp_modem_add_urc_handler()
+ */
+typedef void (*esp_modem_urc_cb_t)(modem_dte_t *dte, const esp_modem_line_t *line, void *context);
+
+/**
+ * @brief Register a handler for the unsolicited result codes starting with a prefix
+ *
+ * Lines not taken by the command in progress are passed to every handler of their prefix, straight from the
+ * receive task. Lines without handler are posted as ESP_MODEM_EVENT_UNKNOWN through the event ring, without
+ * waiting for room (lost lines are counted in esp_modem_dte_stats_t.urc_dropped).
+ *
+ * @param dte Modem DTE object
+ * @param prefix prefix without ':', e.g. "+CREG" or "RING", must stay valid while registered
+ * @param handler handler
+ * @param context handler context
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG on invalid arguments
+ *      - ESP_ERR_NO_MEM if ESP_MODEM_URC_HANDLERS_MAX handlers are registered
+ */
+esp_err_t esp_modem_add_urc_handler(modem_dte_t *dte, const char *prefix, esp_modem_urc_cb_t handler, void *context);
+
+/**
+ * @brief Unregister a handler of unsolicited result codes
+ *
+ * @param dte Modem DTE object
+ * @param prefix prefix given to esp_modem_add_urc_handler(), NULL for all the prefixes of the handler
+ * @param handler handler
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_NOT_FOUND if the handler is not registered
+ */
+esp_err_t esp_modem_remove_urc_handler(modem_dte_t *dte, const char *prefix, esp_modem_urc_cb_t handler);
+
 /**
  * @brief Setup PPP Session
  *
@@ -147,6 +336,32 @@ esp_err_t esp_modem_start_ppp(modem_dte_t *dte);
  */
 esp_err_t esp_modem_stop_ppp(modem_dte_t *dte);
 
+/**
+ * @brief Start the 3GPP TS 27.010 multiplexer (basic option) on the UART
+ *
+ * Opens an AT channel and a PPP channel, so that commands can be sent while the PPP session is running:
+ * esp_modem_start_ppp() then dials on the PPP channel and the other commands keep going to the AT channel.
+ * The DCE must be in command mode.
+ *
+ * @param dte Modem DTE Object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_start_cmux(modem_dte_t *dte);
+
+/**
+ * @brief Stop the multiplexer, back to AT commands on the UART
+ *
+ * The PPP session must be stopped first.
+ *
+ * @param dte Modem DTE Object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_stop_cmux(modem_dte_t *dte);
+
 /**
  * @brief Setup on reception callback
  *
@@ -158,6 +373,84 @@ esp_err_t esp_modem_stop_ppp(modem_dte_t *dte);
  */
 esp_err_t esp_modem_set_rx_cb(modem_dte_t *dte, esp_modem_on_receive receive_cb, void *receive_cb_ctx);
 
+/**
+ * @brief Setup buffer callbacks for zero-copy reception
+ *
+ * @note Used only if the DTE was configured with rx_zero_copy, otherwise the reception callback is used
+ *
+ * @param dte ESP Modem DTE object
+ * @param ops buffer callbacks, NULL to disable zero-copy reception
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t esp_modem_set_rx_buffer_ops(modem_dte_t *dte, const esp_modem_rx_buffer_ops_t *ops);
+
+/**
+ * @brief Get DTE statistics
+ *
+ * @note rx_copied_bytes / rx_bytes is the number of copies made of every received PPP byte
+ *
+ * @param dte ESP Modem DTE object
+ * @param[out] stats statistics snapshot
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t esp_modem_get_stats(modem_dte_t *dte, esp_modem_dte_stats_t *stats);
+
+/**
+ * @brief Get the command arbiter statistics
+ *
+ * @note wait_max_us of ESP_MODEM_CMD_PRIORITY_EMERGENCY is the worst time an emergency transaction took to
+ *       preempt the transaction in progress
+ *
+ * @param dte ESP Modem DTE object
+ * @param[out] stats statistics snapshot, by priority class
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t esp_modem_get_arbiter_stats(modem_dte_t *dte, esp_modem_arbiter_stats_t *stats);
+
+/**
+ * @brief Get the response time histograms and the effective timeouts of the commands sent so far
+ *
+ * The timeout given to send_cmd() is the nominal one. With adaptive_timeouts, a command answered often enough
+ * gets a timeout derived from its response times, between MODEM_COMMAND_TIMEOUT_MIN and
+ * MODEM_COMMAND_TIMEOUT_LIMIT (or the nominal timeout if longer, e.g. MODEM_COMMAND_TIMEOUT_OPERATOR),
+ * see esp_modem_latency_table_t.
+ *
+ * @param dte ESP Modem DTE object
+ * @param[out] latency commands, histogram buckets bounded by esp_modem_latency_bounds_ms
+ * @param[in,out] count capacity of latency (ESP_MODEM_LATENCY_COMMANDS_MAX for all), set to the number of commands
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t esp_modem_get_command_latency(modem_dte_t *dte, esp_modem_command_latency_t *latency, size_t *count);
+
+/**
+ * @brief Get the arena of the static configuration
+ *
+ * @param dte ESP Modem DTE object
+ * @return arena given in esp_modem_dte_config_t, NULL if the DTE allocates from the heap
+ */
+esp_modem_arena_t *esp_modem_dte_get_arena(modem_dte_t *dte);
+
+/**
+ * @brief Get the memory footprint of the DTE buffers
+ *
+ * @param dte ESP Modem DTE object
+ * @param[out] footprint footprint snapshot
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t esp_modem_get_footprint(modem_dte_t *dte, esp_modem_dte_footprint_t *footprint);
+
+/**
+ * @brief Log the memory footprint of the DTE buffers
+ *
+ * @param dte ESP Modem DTE object
+ */
+void esp_modem_log_footprint(modem_dte_t *dte);
+
 /**
  * @brief Notify the modem, that ppp netif has closed
  *
@@ -0,0 +1,135 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "esp_modem_dte.h"
+
+/**
+ * @brief Command arbiter statistics of one priority class
+ *
+ */
+typedef struct {
+    uint32_t acquired;              /*!< Transactions granted */
+    uint32_t timeouts;              /*!< Transactions given up while queued */
+    uint32_t preempted;             /*!< Transactions aborted by an emergency transaction */
+    uint32_t wait_last_us;          /*!< Queueing delay of the last transaction */
+    uint32_t wait_max_us;           /*!< Worst queueing delay */
+    uint64_t wait_total_us;         /*!< Sum of the queueing delays */
+} esp_modem_arbiter_class_stats_t;
+
+/**
+ * @brief Command arbiter statistics
+ *
+ */
+typedef struct {
+    esp_modem_arbiter_class_stats_t classes[ESP_MODEM_CMD_PRIORITY_MAX]; /*!< Statistics by priority class */
+} esp_modem_arbiter_stats_t;
+
+/**
+ * @brief Called when an emergency transaction aborts the command in flight, outside of the arbiter lock
+ */
+typedef void (*esp_modem_arbiter_abort_cb_t)(void *context);
+
+typedef struct esp_modem_arbiter_waiter esp_modem_arbiter_waiter_t;
+
+/**
+ * @brief Command arbiter: one transaction at a time, granted by priority class then in arrival order
+ *
+ * Classes are strict: a queued transaction waits as long as transactions of a higher class are queued.
+ * A transaction is held by one task, recursively. An emergency transaction does not wait for the command in
+ * flight: the command is aborted (its sender returns a failure at once) and the following commands of the
+ * preempted transaction fail without being sent, so the emergency transaction only waits for the preempted one
+ * to unwind. Waiters are queued on their own stack, nothing is allocated.
+ */
+typedef struct {
+    portMUX_TYPE lock;                      /*!< Lock of the fields below */
+    TaskHandle_t owner;                     /*!< Task holding the arbiter, NULL if free */
+    uint32_t depth;                         /*!< Nested acquisitions of owner */
+    esp_modem_cmd_priority_t owner_priority; /*!< Class of the transaction in progress */
+    esp_modem_arbiter_waiter_t *waiters;    /*!< Queued transactions, by class then arrival */
+    bool in_flight;                         /*!< A command of the transaction in progress waits for its result */
+    bool aborted;                           /*!< The command in flight was aborted */
+    esp_modem_arbiter_abort_cb_t abort_cb;  /*!< Aborts the command in flight */
+    void *abort_context;                    /*!< Context of abort_cb */
+    esp_modem_arbiter_stats_t stats;        /*!< Statistics */
+} esp_modem_arbiter_t;
+
+/**
+ * @brief Initialize a command arbiter
+ *
+ * @param arbiter command arbiter
+ * @param abort_cb called to abort the command in flight (e.g. release its sender)
+ * @param context context of abort_cb
+ */
+void esp_modem_arbiter_init(esp_modem_arbiter_t *arbiter, esp_modem_arbiter_abort_cb_t abort_cb, void *context);
+
+/**
+ * @brief Take the arbiter for a transaction
+ *
+ * @param arbiter command arbiter
+ * @param priority class of the transaction, ignored if the calling task already holds the arbiter
+ * @param timeout_ms max queueing delay
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_TIMEOUT if not granted in time
+ */
+esp_err_t esp_modem_arbiter_acquire(esp_modem_arbiter_t *arbiter, esp_modem_cmd_priority_t priority,
+                                    uint32_t timeout_ms);
+
+/**
+ * @brief Give the arbiter back, to the first queued transaction of the highest class
+ *
+ * @param arbiter command arbiter
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if the calling task does not hold the arbiter
+ */
+esp_err_t esp_modem_arbiter_release(esp_modem_arbiter_t *arbiter);
+
+/**
+ * @brief Mark a command of the transaction in progress in flight, before sending it
+ *
+ * @param arbiter command arbiter
+ * @return false if the transaction is preempted, the command must not be sent
+ */
+bool esp_modem_arbiter_begin_command(esp_modem_arbiter_t *arbiter);
+
+/**
+ * @brief End the command in flight, once its result came or its wait ended
+ *
+ * @param arbiter command arbiter
+ * @return false if the command was aborted by an emergency transaction
+ */
+bool esp_modem_arbiter_end_command(esp_modem_arbiter_t *arbiter);
+
+/**
+ * @brief Get a snapshot of the statistics
+ *
+ * @param arbiter command arbiter
+ * @param[out] stats statistics snapshot
+ */
+void esp_modem_arbiter_get_stats(esp_modem_arbiter_t *arbiter, esp_modem_arbiter_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,54 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Caller storage of the static configuration
+ *
+ * Objects are carved out of the storage by a bump pointer and never given back one by one: the whole arena is
+ * reused by resetting used to 0 once the objects allocated from it are deinitialized.
+ */
+typedef struct {
+    uint8_t *base;                  /*!< Storage, 8 bytes aligned */
+    size_t size;                    /*!< Size of the storage */
+    size_t used;                    /*!< Bytes already allocated, 0 for an empty arena */
+} esp_modem_arena_t;
+
+/**
+ * @brief Allocate zeroed memory from an arena, or from the heap without arena
+ *
+ * @param arena arena, NULL to allocate from the heap
+ * @param size size in bytes
+ * @return allocated memory, 8 bytes aligned, NULL if the arena (or the heap) is exhausted
+ */
+void *esp_modem_arena_calloc(esp_modem_arena_t *arena, size_t size);
+
+/**
+ * @brief Release memory from esp_modem_arena_calloc(), only heap memory is actually freed
+ *
+ * @param arena arena the memory was allocated from, NULL for the heap
+ * @param ptr memory, may be NULL
+ */
+void esp_modem_arena_free(esp_modem_arena_t *arena, void *ptr);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,143 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_modem_dce.h"
+
+#define ESP_MODEM_ASYNC_MAX_BATCH (8)           /*!< Max commands sent on one command line */
+#define ESP_MODEM_ASYNC_MAX_LINE_LENGTH (128)   /*!< Max length of a batched command line */
+
+/**
+ * @brief Consumer of the response lines of an asynchronous command
+ *
+ * @param dce Modem DCE object
+ * @param line classified response line
+ * @param context context of the command
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+typedef esp_err_t (*esp_modem_async_line_cb_t)(modem_dce_t *dce, const esp_modem_line_t *line, void *context);
+
+/**
+ * @brief Completion callback of an asynchronous command, called from the engine task
+ *
+ * @param dce Modem DCE object
+ * @param result ESP_OK on success, ESP_FAIL on error result code, ESP_ERR_TIMEOUT on timeout,
+ *               ESP_ERR_INVALID_STATE if the DCE was not in command mode (nor in PPP mode with the multiplexer
+ *               started) or the engine was stopped
+ * @param context context of the command
+ */
+typedef void (*esp_modem_async_done_cb_t)(modem_dce_t *dce, esp_err_t result, void *context);
+
+/**
+ * @brief Asynchronous command
+ *
+ * Commands with a response prefix are independent queries: consecutive ones are concatenated on one command line
+ * ("AT+CSQ;+CREG?") and their information lines are routed by prefix. Commands without prefix are sent alone
+ * and get all the information lines.
+ */
+typedef struct {
+    const char *command;                /*!< Command without "AT" and "\r", e.g. "+CSQ", must stay valid until completion */
+    const char *prefix;                 /*!< Prefix of the information lines without ':', e.g. "+CSQ", NULL if the command must be sent alone */
+    uint32_t timeout;                   /*!< Timeout, unit: ms */
+    esp_modem_async_line_cb_t line_cb;  /*!< Consumer of the information lines, NULL to ignore them */
+    esp_modem_async_done_cb_t done_cb;  /*!< Completion callback, NULL if none */
+    void *context;                      /*!< Context passed to the callbacks */
+} esp_modem_async_cmd_t;
+
+/**
+ * @brief Asynchronous command engine configuration
+ *
+ */
+typedef struct {
+    int queue_size;                     /*!< Max pending commands */
+    uint32_t task_stack_size;           /*!< Engine task stack size */
+    int task_priority;                  /*!< Engine task priority */
+    int max_batch;                      /*!< Max commands concatenated on one command line, 1 to disable batching */
+} esp_modem_async_config_t;
+
+/**
+ * @brief Asynchronous command engine statistics
+ *
+ */
+typedef struct {
+    uint32_t commands;                  /*!< Commands completed */
+    uint32_t command_lines;             /*!< Command lines sent (round trips) */
+    uint32_t batched;                   /*!< Commands sent on the line of a previous command */
+    uint32_t fallbacks;                 /*!< Failed batches retried command by command */
+} esp_modem_async_stats_t;
+
+#define ESP_MODEM_ASYNC_DEFAULT_CONFIG()    \
+    {                                       \
+        .queue_size = 16,                   \
+        .task_stack_size = 3072,            \
+        .task_priority = 5,                 \
+        .max_batch = ESP_MODEM_ASYNC_MAX_BATCH \
+    }
+
+/**
+ * @brief Start the asynchronous command engine of a DCE
+ *
+ * The engine task owns the command channel: synchronous commands must not be sent from other tasks meanwhile.
+ * In the static configuration the engine is allocated from the arena of the DTE: start it once.
+ *
+ * @param dce Modem DCE object
+ * @param config engine configuration
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_async_start(modem_dce_t *dce, const esp_modem_async_config_t *config);
+
+/**
+ * @brief Stop the asynchronous command engine, the pending commands complete with ESP_ERR_INVALID_STATE
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_async_stop(modem_dce_t *dce);
+
+/**
+ * @brief Queue a command, returns without waiting for the response
+ *
+ * @param dce Modem DCE object
+ * @param cmd command (copied)
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if the engine is not started
+ *      - ESP_ERR_NO_MEM if the queue is full
+ */
+esp_err_t esp_modem_async_submit(modem_dce_t *dce, const esp_modem_async_cmd_t *cmd);
+
+/**
+ * @brief Get the asynchronous command engine statistics
+ *
+ * @param dce Modem DCE object
+ * @param[out] stats statistics
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if the engine is not started
+ */
+esp_err_t esp_modem_async_get_stats(modem_dce_t *dce, esp_modem_async_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,123 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ESP_MODEM_CMUX_FLAG         (0xF9)      /*!< Frame delimiter (basic option) */
+#define ESP_MODEM_CMUX_EA           (0x01)      /*!< Extension bit: last octet of the field */
+#define ESP_MODEM_CMUX_CR           (0x02)      /*!< Command/response bit */
+#define ESP_MODEM_CMUX_PF           (0x10)      /*!< Poll/final bit of the control field */
+#define ESP_MODEM_CMUX_SABM         (0x2F)      /*!< Set asynchronous balanced mode (open a channel) */
+#define ESP_MODEM_CMUX_UA           (0x63)      /*!< Unnumbered acknowledgement */
+#define ESP_MODEM_CMUX_DM           (0x0F)      /*!< Disconnected mode */
+#define ESP_MODEM_CMUX_DISC         (0x43)      /*!< Disconnect (close a channel) */
+#define ESP_MODEM_CMUX_UIH          (0xEF)      /*!< Unnumbered information with header check */
+#define ESP_MODEM_CMUX_UI           (0x03)      /*!< Unnumbered information */
+#define ESP_MODEM_CMUX_FCS_GOOD     (0xCF)      /*!< CRC-8 over the checked fields including the FCS */
+#define ESP_MODEM_CMUX_N1           (127)       /*!< Max information field length, module default */
+#define ESP_MODEM_CMUX_OVERHEAD     (7)         /*!< Flags, address, control, 2 length octets and FCS */
+#define ESP_MODEM_CMUX_FRAME_SIZE   (ESP_MODEM_CMUX_N1 + ESP_MODEM_CMUX_OVERHEAD) /*!< Max encoded frame size */
+
+/* Control channel (DLCI 0) message types, with EA set and C/R clear */
+#define ESP_MODEM_CMUX_MSG_CLD      (0xC1)      /*!< Multiplexer close down */
+#define ESP_MODEM_CMUX_MSG_MSC      (0xE1)      /*!< Modem status command */
+
+/**
+ * @brief Callback receiving the decoded frames
+ *
+ * @param dlci data link connection identifier
+ * @param control control field, poll/final bit cleared
+ * @param data information field
+ * @param len length of the information field
+ * @param context context given to esp_modem_cmux_decoder_init()
+ */
+typedef void (*esp_modem_cmux_frame_cb_t)(uint8_t dlci, uint8_t control, uint8_t *data, size_t len, void *context);
+
+/**
+ * @brief 3GPP TS 27.010 basic option frame decoder
+ */
+typedef struct {
+    esp_modem_cmux_frame_cb_t frame_cb; /*!< Frame callback */
+    void *context;                      /*!< Frame callback context */
+    uint8_t state;                      /*!< Decoding state */
+    uint8_t header[4];                  /*!< Address, control and length octets of the current frame */
+    uint8_t fcs;                        /*!< FCS of the current frame */
+    size_t header_len;                  /*!< Octets in header */
+    size_t len;                         /*!< Information field length of the current frame */
+    size_t pos;                         /*!< Information octets received */
+    uint8_t info[ESP_MODEM_CMUX_N1];    /*!< Information field of the current frame */
+    uint32_t frames;                    /*!< Valid frames delivered */
+    uint32_t fcs_errors;                /*!< Frames dropped because of a bad FCS */
+    uint32_t dropped;                   /*!< Frames dropped because too long or not terminated by a flag */
+} esp_modem_cmux_decoder_t;
+
+/**
+ * @brief Compute the 27.010 CRC-8 over a buffer
+ *
+ * @param data data
+ * @param len length of data
+ * @return CRC (not complemented)
+ */
+uint8_t esp_modem_cmux_crc8(const uint8_t *data, size_t len);
+
+/**
+ * @brief Initialize a decoder, which starts hunting for a flag
+ *
+ * @param decoder CMUX decoder
+ * @param frame_cb frame callback
+ * @param context frame callback context
+ */
+void esp_modem_cmux_decoder_init(esp_modem_cmux_decoder_t *decoder, esp_modem_cmux_frame_cb_t frame_cb, void *context);
+
+/**
+ * @brief Drop the frame being decoded and hunt for the next flag
+ *
+ * @param decoder CMUX decoder
+ */
+void esp_modem_cmux_decoder_reset(esp_modem_cmux_decoder_t *decoder);
+
+/**
+ * @brief Decode raw data, delivering each complete frame with a valid FCS
+ *
+ * @param decoder CMUX decoder
+ * @param data raw data
+ * @param len length of data
+ */
+void esp_modem_cmux_decode(esp_modem_cmux_decoder_t *decoder, const uint8_t *data, size_t len);
+
+/**
+ * @brief Encode a frame
+ *
+ * @param dlci data link connection identifier
+ * @param control control field, including the poll/final bit if needed
+ * @param command true for a command (C/R set, as sent by the initiator), false for a response
+ * @param data information field, NULL if len is 0
+ * @param len length of the information field, up to ESP_MODEM_CMUX_N1
+ * @param out output buffer
+ * @param out_size size of the output buffer, len + ESP_MODEM_CMUX_OVERHEAD is enough
+ * @return encoded length, 0 if the information field is too long or out is too small
+ */
+size_t esp_modem_cmux_encode(uint8_t dlci, uint8_t control, bool command, const uint8_t *data, size_t len,
+                             uint8_t *out, size_t out_size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -49,6 +49,9 @@ esp_err_t esp_modem_add_event_handler(modem_dte_t *dte, esp_event_handler_t hand
 
 /**
  * @brief Backward compatible version of creating esp-netif(PPP) and attaching to esp_modem_start_ppp()
+ *
+ * In the static configuration (esp_modem_dte_config_t.arena) the esp-netif and its adapter are created by the
+ * first call only, and kept across reconnections by esp_modem_free_netif_adapter().
  */
 esp_err_t esp_modem_setup_ppp(modem_dte_t *dte) __attribute__ ((deprecated));
 
@@ -58,6 +61,9 @@ esp_err_t esp_modem_setup_ppp(modem_dte_t *dte) __attribute__ ((deprecated));
 esp_err_t esp_modem_exit_ppp(modem_dte_t *dte) __attribute__ ((deprecated));
 
 
+/**
+ * @brief Delete the esp-netif and its adapter created by esp_modem_setup_ppp(), kept in the static configuration
+ */
 void esp_modem_free_netif_adapter(void);
 
 #ifdef __cplusplus
@@ -20,9 +20,11 @@ extern "C" {
 #include "esp_types.h"
 #include "esp_err.h"
 #include "esp_modem_dte.h"
+#include "esp_modem_line.h"
 
 typedef struct modem_dce modem_dce_t;
 typedef struct modem_dte modem_dte_t;
+struct esp_modem_async;
 
 /**
  * @brief Result Code from DCE
@@ -49,15 +51,20 @@ typedef struct modem_dte modem_dte_t;
 #define MODEM_IMSI_LENGTH (15)         /*!< IMSI Number Length */
 
 /**
- * @brief Specific Timeout Constraint, Unit: millisecond
+ * @brief Specific Timeout Constraint (nominal, adapted to the measured response times), Unit: millisecond
  *
  */
 #define MODEM_COMMAND_TIMEOUT_DEFAULT (500)      /*!< Default timeout value for most commands */
 #define MODEM_COMMAND_TIMEOUT_OPERATOR (75000)   /*!< Timeout value for getting operator status */
+#define MODEM_COMMAND_TIMEOUT_OPERATOR_SCAN (180000) /*!< Timeout value for scanning available operators */
 #define MODEM_COMMAND_TIMEOUT_MODE_CHANGE (3000) /*!< Timeout value for changing working mode */
 #define MODEM_COMMAND_TIMEOUT_HANG_UP (90000)    /*!< Timeout value for hang up */
 #define MODEM_COMMAND_TIMEOUT_POWEROFF (3000)    /*!< Timeout value for power down */
 #define MODEM_COMMAND_TIMEOUT_FAST_POWEROFF (2000)    /*!< Timeout value for fast power down */
+#define MODEM_COMMAND_TIMEOUT_MIN (100)          /*!< Lower limit of the timeouts derived from the response times */
+#define MODEM_COMMAND_TIMEOUT_LIMIT (5000)       /*!< Upper limit of the derived timeouts, unless the nominal one is longer */
+#define MODEM_ARBITER_TIMEOUT_DEFAULT (MODEM_COMMAND_TIMEOUT_OPERATOR_SCAN) /*!< Max queueing delay of a transaction, behind the longest command */
+#define MODEM_ARBITER_TIMEOUT_EMERGENCY (1500)   /*!< Max delay for an emergency transaction to preempt the one in progress */
 
 
 typedef enum
@@ -85,6 +92,29 @@ typedef enum {
     MODEM_STATE_FAIL        /*!< Process failed */
 } modem_state_t;
 
+/**
+ * @brief Consumer of a streamed response
+ *
+ * @param dce Modem DCE object
+ * @param chunk response chunk (NUL terminated), a whole line or a part of a line longer than the line buffer
+ * @param len length of the chunk
+ * @param line_end true if the chunk ends a line
+ * @param context context passed with the command
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+typedef esp_err_t (*modem_response_cb_t)(modem_dce_t *dce, const char *chunk, size_t len, bool line_end, void *context);
+
+/**
+ * @brief Streamed response in progress
+ *
+ */
+typedef struct {
+    modem_response_cb_t cb; /*!< Consumer of the response chunks */
+    void *context;          /*!< Consumer context */
+} modem_response_stream_t;
+
 /**
  * @brief DCE(Data Communication Equipment)
  *
@@ -100,7 +130,11 @@ struct modem_dce {
     modem_dce_baudrate_status_t baudStatus;                                           /*!< baudrate state */
     modem_mode_t mode;                                                                /*!< Working mode */
     modem_dte_t *dte;                                                                 /*!< DTE which connect to DCE */
-    esp_err_t (*handle_line)(modem_dce_t *dce, const char *line);                     /*!< Handle line strategy */
+    esp_err_t (*handle_line)(modem_dce_t *dce, const esp_modem_line_t *line);         /*!< Handle line strategy, on classified lines */
+    esp_err_t (*handle_segment)(modem_dce_t *dce, const char *segment, size_t len,
+                                bool line_start, bool line_end);                      /*!< Handle line segments, overrides handle_line if set */
+    modem_response_stream_t *stream;                                                  /*!< Streamed response in progress */
+    struct esp_modem_async *async;                                                    /*!< Asynchronous command engine, NULL if not started */
     esp_err_t (*sync)(modem_dce_t *dce);                                              /*!< Synchronization */
     esp_err_t (*echo_mode)(modem_dce_t *dce, bool on);                                /*!< Echo command on or off */
     esp_err_t (*store_profile)(modem_dce_t *dce);                                     /*!< Store user settings */
@@ -54,12 +54,43 @@ static inline void strip_cr_lf_tail(char *str, uint32_t len)
  * Some responses for command are simple, commonly will return OK when succeed of ERROR when failed
  *
  * @param dce Modem DCE object
- * @param line line string
+ * @param line classified line
  * @return esp_err_t
  *      - ESP_OK on success
  *      - ESP_FAIL on error
  */
-esp_err_t esp_modem_dce_handle_response_default(modem_dce_t *dce, const char *line);
+esp_err_t esp_modem_dce_handle_response_default(modem_dce_t *dce, const esp_modem_line_t *line);
+
+/**
+ * @brief Send a command and stream its response to a consumer
+ *
+ * Every response line is passed to the consumer, lines longer than the line buffer in several chunks,
+ * so responses of any length are handled with the fixed size line buffer.
+ * The final result code completes the command and is not passed to the consumer.
+ *
+ * @param dce Modem DCE object
+ * @param command command string
+ * @param timeout timeout value, unit: ms
+ * @param response_cb consumer of the response chunks
+ * @param context consumer context
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_dce_send_cmd_streamed(modem_dce_t *dce, const char *command, uint32_t timeout,
+                                          modem_response_cb_t response_cb, void *context);
+
+/**
+ * @brief Read the current configuration profile (AT&V)
+ *
+ * @param dce Modem DCE object
+ * @param response_cb consumer of the response chunks
+ * @param context consumer context
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_dce_get_profile(modem_dce_t *dce, modem_response_cb_t response_cb, void *context);
 
 /**
  * @brief Syncronization
@@ -124,6 +155,16 @@ esp_err_t esp_modem_dce_set_flow_ctrl(modem_dce_t *dce, modem_flow_ctrl_t flow_c
  */
 esp_err_t esp_modem_dce_set_baud_rate(modem_dce_t *dce, uint32_t baudrate);
 
+/**
+ * @brief Enter the multiplexer mode (3GPP TS 27.010 basic option, default parameters)
+ *
+ * @param dce Modem DCE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+esp_err_t esp_modem_dce_enter_cmux(modem_dce_t *dce);
+
 /**
  * @brief Define PDP context
  *
@@ -46,6 +46,18 @@ typedef enum {
     MODEM_FLOW_CONTROL_HW
 } modem_flow_ctrl_t;
 
+/**
+ * @brief Priority class of a command transaction, see modem_dte_t::acquire
+ *
+ */
+typedef enum {
+    ESP_MODEM_CMD_PRIORITY_EMERGENCY = 0, /*!< Aborts the transaction in progress, e.g. power down on supply failure */
+    ESP_MODEM_CMD_PRIORITY_CONTROL,       /*!< Call and working mode control */
+    ESP_MODEM_CMD_PRIORITY_NORMAL,        /*!< Queries and configuration */
+    ESP_MODEM_CMD_PRIORITY_BACKGROUND,    /*!< Polling, e.g. the asynchronous command engine */
+    ESP_MODEM_CMD_PRIORITY_MAX
+} esp_modem_cmd_priority_t;
+
 /**
  * network possible states
  */
@@ -66,14 +78,23 @@ typedef enum
 struct modem_dte {
     modem_flow_ctrl_t flow_ctrl;                                                    /*!< Flow control of DTE */
     modem_dce_t *dce;                                                               /*!< DCE which connected to the DTE */
-    esp_err_t (*send_cmd)(modem_dte_t *dte, const char *command, uint32_t timeout); /*!< Send command to DCE */
+    esp_err_t (*send_cmd)(modem_dte_t *dte, const char *command, uint32_t timeout); /*!< Send command to DCE, the DCE handlers are detached on return */
     int (*send_data)(modem_dte_t *dte, const char *data, uint32_t length);          /*!< Send data to DCE */
     esp_err_t (*send_wait)(modem_dte_t *dte, const char *data, uint32_t length,
                            const char *prompt, uint32_t timeout);      /*!< Wait for specific prompt */
     esp_err_t (*change_mode)(modem_dte_t *dte, modem_mode_t new_mode); /*!< Changing working mode */
     esp_err_t (*process_cmd_done)(modem_dte_t *dte);                   /*!< Callback when DCE process command done */
     esp_err_t (*change_dte_baudrate)(modem_dte_t *dte, uint32_t baudrate);                   /*!< change dte baudrate */
+    esp_err_t (*send_dtr_escape)(modem_dte_t *dte, uint32_t duration_ms,
+                                 uint32_t timeout);                    /*!< Turn DTR off for duration_ms and wait for the result code
+                                                                            like send_cmd(), ESP_ERR_NOT_SUPPORTED if not wired */
+    esp_err_t (*acquire)(modem_dte_t *dte, esp_modem_cmd_priority_t priority,
+                         uint32_t timeout_ms);                         /*!< Take the command arbiter before a transaction (setting
+                                                                            handle_line, sending, reading the results), recursive */
+    esp_err_t (*release)(modem_dte_t *dte);                            /*!< Give the command arbiter back, ESP_ERR_INVALID_STATE if
+                                                                            not held by the calling task */
     esp_err_t (*deinit)(modem_dte_t *dte);                             /*!< Deinitialize */
+    bool cmux;                                                         /*!< Commands multiplexed with the PPP data (27.010), send_cmd() works in PPP mode too */
 };
 
 #ifdef __cplusplus
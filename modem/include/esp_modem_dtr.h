@@ -0,0 +1,53 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * @brief Drive the DTR pin as an output, on (low)
+ *
+ * @param io_num DTR pin, negative if not wired
+ * @return esp_err_t
+ *      - ESP_OK on success, or if DTR is not wired
+ *      - ESP_FAIL if the pin cannot be configured
+ */
+esp_err_t esp_modem_dtr_init(int io_num);
+
+/**
+ * @brief Turn DTR off then on again, which makes the DCE leave the data mode (AT&D1/AT&D2)
+ *
+ * @param io_num DTR pin, negative if not wired
+ * @param duration_ms time DTR stays off
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_NOT_SUPPORTED if DTR is not wired
+ */
+esp_err_t esp_modem_dtr_pulse(int io_num, uint32_t duration_ms);
+
+/**
+ * @brief Release the DTR pin
+ *
+ * @param io_num DTR pin, negative if not wired
+ */
+void esp_modem_dtr_deinit(int io_num);
+
+#ifdef __cplusplus
+}
+#endif
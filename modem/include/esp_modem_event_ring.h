@@ -0,0 +1,115 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Event held in a ring slot
+ *
+ */
+typedef struct {
+    int32_t event_id;               /*!< Event id */
+    uint32_t size;                  /*!< Size of data */
+    uint8_t data[];                 /*!< Event data, slot_size bytes available */
+} esp_modem_event_slot_t;
+
+/**
+ * @brief Single producer, single consumer ring of fixed-size event slots
+ *
+ * The producer never blocks nor allocates: an event is copied into the next free slot, or dropped and counted
+ * when the ring is full. The consumer reads the oldest event in place and releases its slot when done.
+ * No lock is taken, head is written by the producer only and tail by the consumer only.
+ */
+typedef struct {
+    uint8_t *storage;               /*!< Slots storage, ESP_MODEM_EVENT_RING_STORAGE_SIZE() bytes */
+    uint32_t slot_count;            /*!< Number of slots, power of two */
+    uint32_t slot_stride;           /*!< Size of one slot including its header */
+    uint32_t slot_size;             /*!< Max size of the data of one event */
+    volatile uint32_t head;         /*!< Slots published (free running, producer only) */
+    volatile uint32_t tail;         /*!< Slots released (free running, consumer only) */
+    uint32_t dropped;               /*!< Events dropped because the ring was full (producer only) */
+    uint32_t peak;                  /*!< Max slots in use (producer only) */
+} esp_modem_event_ring_t;
+
+/**
+ * @brief Size of one slot including its header, aligned for the next slot header
+ */
+#define ESP_MODEM_EVENT_SLOT_STRIDE(slot_size) \
+    ((sizeof(esp_modem_event_slot_t) + (slot_size) + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1))
+
+/**
+ * @brief Storage size needed by a ring
+ */
+#define ESP_MODEM_EVENT_RING_STORAGE_SIZE(slot_count, slot_size) \
+    ((slot_count) * ESP_MODEM_EVENT_SLOT_STRIDE(slot_size))
+
+/**
+ * @brief Initialize an event ring
+ *
+ * @param ring event ring
+ * @param storage slots storage, ESP_MODEM_EVENT_RING_STORAGE_SIZE(slot_count, slot_size) bytes, 8 bytes aligned
+ * @param slot_count number of slots, power of two
+ * @param slot_size max size of the data of one event
+ * @return true on success, false if the sizes are not valid
+ */
+bool esp_modem_event_ring_init(esp_modem_event_ring_t *ring, uint8_t *storage, uint32_t slot_count,
+                               uint32_t slot_size);
+
+/**
+ * @brief Publish an event (producer side), never blocks
+ *
+ * @param ring event ring
+ * @param event_id event id
+ * @param data event data, NULL if none
+ * @param size size of data, at most slot_size
+ * @return true on success, false if the ring is full (the event is dropped and counted) or the event too large
+ */
+bool esp_modem_event_ring_push(esp_modem_event_ring_t *ring, int32_t event_id, const void *data, size_t size);
+
+/**
+ * @brief Get the oldest event (consumer side), left in the ring until esp_modem_event_ring_pop()
+ *
+ * @param ring event ring
+ * @return oldest event, NULL if the ring is empty
+ */
+const esp_modem_event_slot_t *esp_modem_event_ring_peek(esp_modem_event_ring_t *ring);
+
+/**
+ * @brief Release the slot of the oldest event (consumer side)
+ *
+ * @param ring event ring
+ */
+void esp_modem_event_ring_pop(esp_modem_event_ring_t *ring);
+
+/**
+ * @brief Number of events waiting in the ring
+ *
+ * @param ring event ring
+ * @return pending events
+ */
+static inline uint32_t esp_modem_event_ring_pending(const esp_modem_event_ring_t *ring)
+{
+    return ring->head - ring->tail;
+}
+
+#ifdef __cplusplus
+}
+#endif
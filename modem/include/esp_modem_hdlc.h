@@ -0,0 +1,97 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ESP_MODEM_HDLC_FLAG         (0x7E)      /*!< Frame delimiter */
+#define ESP_MODEM_HDLC_ESCAPE       (0x7D)      /*!< Control escape */
+#define ESP_MODEM_HDLC_TRANS        (0x20)      /*!< Value XORed to escaped bytes */
+#define ESP_MODEM_HDLC_FCS_INIT     (0xFFFF)    /*!< Initial FCS-16 value */
+#define ESP_MODEM_HDLC_FCS_GOOD     (0xF0B8)    /*!< FCS-16 over a frame including its FCS */
+#define ESP_MODEM_HDLC_OVERHEAD     (7)         /*!< Address, control, protocol, FCS and the protocol expansion byte */
+
+/**
+ * @brief Frame buffer operations of the HDLC decoder
+ *
+ * Decoded frames are written straight into buffers provided by the receiver. A frame is passed as
+ * the 16 bit protocol number (big endian) followed by the information field, at offset within the buffer.
+ */
+typedef struct {
+    void *(*get)(size_t size, uint8_t **payload, void *context);    /*!< Get a frame buffer, NULL if none */
+    void (*deliver)(void *frame, size_t offset, size_t len, void *context); /*!< Hand over a valid frame */
+    void (*drop)(void *frame, void *context);                       /*!< Release a frame buffer not delivered */
+    void *context;                                                  /*!< Context passed to the operations */
+} esp_modem_hdlc_frame_ops_t;
+
+/**
+ * @brief HDLC-like (RFC 1662) PPP frame decoder
+ */
+typedef struct {
+    esp_modem_hdlc_frame_ops_t ops; /*!< Frame buffer operations */
+    size_t frame_size;              /*!< Max size of a frame, as requested from ops.get() */
+    void *frame;                    /*!< Frame being decoded, NULL if none */
+    uint8_t *payload;               /*!< Payload of the frame being decoded */
+    size_t len;                     /*!< Decoded length of the current frame */
+    bool escaped;                   /*!< Last byte was a control escape */
+    bool hunting;                   /*!< Dropping data up to the next flag */
+    uint32_t frames;                /*!< Valid frames delivered */
+    uint32_t fcs_errors;            /*!< Frames dropped because of a bad FCS */
+    uint32_t dropped;               /*!< Frames dropped because too long, too short or no buffer available */
+} esp_modem_hdlc_decoder_t;
+
+/**
+ * @brief Compute the PPP FCS-16 over a buffer, 4 bytes per step
+ *
+ * @param fcs initial value, ESP_MODEM_HDLC_FCS_INIT for a new frame
+ * @param data data
+ * @param len length of data
+ * @return updated FCS (not complemented)
+ */
+uint16_t esp_modem_hdlc_fcs16(uint16_t fcs, const uint8_t *data, size_t len);
+
+/**
+ * @brief Initialize a decoder, which starts hunting for a flag
+ *
+ * @param decoder HDLC decoder
+ * @param ops frame buffer operations
+ * @param mru max receive unit (size of the information field)
+ */
+void esp_modem_hdlc_decoder_init(esp_modem_hdlc_decoder_t *decoder, const esp_modem_hdlc_frame_ops_t *ops, size_t mru);
+
+/**
+ * @brief Drop the frame being decoded and hunt for the next flag
+ *
+ * @param decoder HDLC decoder
+ */
+void esp_modem_hdlc_decoder_reset(esp_modem_hdlc_decoder_t *decoder);
+
+/**
+ * @brief Decode raw data, delivering each complete frame with a valid FCS
+ *
+ * @param decoder HDLC decoder
+ * @param data raw data
+ * @param len length of data
+ */
+void esp_modem_hdlc_decode(esp_modem_hdlc_decoder_t *decoder, const uint8_t *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
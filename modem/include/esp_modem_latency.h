@@ -0,0 +1,116 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+
+#define ESP_MODEM_LATENCY_BUCKETS (15)          /*!< Response time buckets, see esp_modem_latency_bounds_ms */
+#define ESP_MODEM_LATENCY_COMMANDS_MAX (24)     /*!< Commands tracked per DTE, the others keep their nominal timeout */
+#define ESP_MODEM_LATENCY_NAME_MAX (32)         /*!< Max length of a tracked command name, NUL included */
+#define ESP_MODEM_LATENCY_MIN_SAMPLES (16)      /*!< Samples needed before the timeout adapts */
+#define ESP_MODEM_LATENCY_WINDOW (128)          /*!< Samples after which the histogram is halved, to follow the network */
+#define ESP_MODEM_LATENCY_PERCENTILE (99)       /*!< Percentile of the response times the timeout is derived from */
+#define ESP_MODEM_LATENCY_MARGIN (2)            /*!< Timeout as a multiple of the percentile */
+
+/**
+ * @brief Upper bounds of the response time buckets in ms, the last bucket is unbounded
+ */
+extern const uint32_t esp_modem_latency_bounds_ms[ESP_MODEM_LATENCY_BUCKETS];
+
+/**
+ * @brief Response times and timeout of one command
+ *
+ */
+typedef struct {
+    char command[ESP_MODEM_LATENCY_NAME_MAX]; /*!< Command up to its parameter values (e.g. "AT+COPS?", "AT+QCFG=\"band\","), "" if free */
+    uint32_t buckets[ESP_MODEM_LATENCY_BUCKETS]; /*!< Response times by bucket, timeouts counted at the timeout */
+    uint32_t samples;               /*!< Sum of buckets */
+    uint32_t answered;              /*!< Commands answered in time */
+    uint32_t timeouts;              /*!< Commands not answered in time */
+    uint32_t max_ms;                /*!< Slowest answer */
+    uint32_t nominal_ms;            /*!< Timeout given by the caller (specification) */
+    uint32_t timeout_ms;            /*!< Effective timeout */
+} esp_modem_command_latency_t;
+
+/**
+ * @brief Response time histograms of the commands, deriving their timeouts
+ *
+ * Once a command has ESP_MODEM_LATENCY_MIN_SAMPLES samples, its timeout is ESP_MODEM_LATENCY_MARGIN times
+ * the upper bound of the bucket holding the ESP_MODEM_LATENCY_PERCENTILE percentile, clamped to
+ * [floor_ms, max(nominal, ceiling_ms)]. A timeout is counted as a sample at the timeout, so that repeated
+ * timeouts double the timeout up to the limit.
+ */
+typedef struct {
+    portMUX_TYPE lock;                      /*!< Lock of commands, taken by the readers */
+    bool adaptive;                          /*!< Use the derived timeouts, else only measure */
+    uint32_t floor_ms;                      /*!< Lower limit of the derived timeouts */
+    uint32_t ceiling_ms;                    /*!< Upper limit of the derived timeouts, unless the nominal one is longer */
+    uint32_t untracked;                     /*!< Commands sent with their nominal timeout, table full */
+    esp_modem_command_latency_t commands[ESP_MODEM_LATENCY_COMMANDS_MAX]; /*!< Tracked commands */
+} esp_modem_latency_table_t;
+
+/**
+ * @brief Initialize a latency table
+ *
+ * @param table latency table
+ * @param adaptive use the derived timeouts, else only measure
+ * @param floor_ms lower limit of the derived timeouts
+ * @param ceiling_ms upper limit of the derived timeouts, unless the nominal one is longer
+ */
+void esp_modem_latency_init(esp_modem_latency_table_t *table, bool adaptive, uint32_t floor_ms, uint32_t ceiling_ms);
+
+/**
+ * @brief Get the timeout of a command about to be sent
+ *
+ * Commands not starting with "AT" (e.g. "+++") are not tracked.
+ *
+ * @param table latency table
+ * @param command command line
+ * @param nominal_ms timeout given by the caller
+ * @param[out] index entry of the command to give to esp_modem_latency_record(), -1 if not tracked
+ * @return effective timeout in ms
+ */
+uint32_t esp_modem_latency_timeout(esp_modem_latency_table_t *table, const char *command, uint32_t nominal_ms,
+                                   int *index);
+
+/**
+ * @brief Record the response time of a command
+ *
+ * @param table latency table
+ * @param index entry returned by esp_modem_latency_timeout(), ignored if negative
+ * @param elapsed_ms time from sending to the final result code, or to the timeout
+ * @param answered false on timeout
+ */
+void esp_modem_latency_record(esp_modem_latency_table_t *table, int index, uint32_t elapsed_ms, bool answered);
+
+/**
+ * @brief Copy the tracked commands
+ *
+ * @param table latency table
+ * @param[out] latency commands
+ * @param max capacity of latency
+ * @return number of commands copied
+ */
+size_t esp_modem_latency_snapshot(esp_modem_latency_table_t *table, esp_modem_command_latency_t *latency, size_t max);
+
+#ifdef __cplusplus
+}
+#endif
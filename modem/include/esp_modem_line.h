@@ -0,0 +1,191 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * @brief Class of a response line
+ *
+ */
+typedef enum {
+    ESP_MODEM_LINE_INFO,            /*!< Information response, or any line not in the tables */
+    ESP_MODEM_LINE_URC,             /*!< Known unsolicited result code (some also answer a query, e.g. +CREG) */
+    ESP_MODEM_LINE_OK,              /*!< OK */
+    ESP_MODEM_LINE_CONNECT,         /*!< CONNECT [<rate>] */
+    ESP_MODEM_LINE_NO_CARRIER,      /*!< NO CARRIER */
+    ESP_MODEM_LINE_ERROR,           /*!< ERROR */
+    ESP_MODEM_LINE_CME_ERROR,       /*!< +CME ERROR: <err> */
+    ESP_MODEM_LINE_CMS_ERROR,       /*!< +CMS ERROR: <err> */
+    ESP_MODEM_LINE_NO_DIALTONE,     /*!< NO DIALTONE */
+    ESP_MODEM_LINE_BUSY,            /*!< BUSY */
+    ESP_MODEM_LINE_NO_ANSWER,       /*!< NO ANSWER */
+} esp_modem_line_type_t;
+
+/**
+ * @brief Classified response line, pointing into the line buffer
+ *
+ */
+typedef struct {
+    esp_modem_line_type_t type;     /*!< Class of the line */
+    const char *text;               /*!< Line without the leading blanks, NUL terminated, including the "\r\n" tail */
+    size_t len;                     /*!< Length of text without the "\r\n" tail */
+    size_t prefix_len;              /*!< Length of the "+XXX" prefix before ':', 0 if none */
+    const char *payload;            /*!< Parameters after the prefix and ": ", text if no prefix */
+    size_t payload_len;             /*!< Length of payload without the "\r\n" tail */
+    int code;                       /*!< <err> of +CME/+CMS ERROR, <rate> of CONNECT, -1 if none */
+} esp_modem_line_t;
+
+/**
+ * @brief Classify a line, in one pass over its head
+ *
+ * Final result codes must fill the whole line (CONNECT and +CME/+CMS ERROR take parameters),
+ * so an information response containing "OK" or "ERROR" is not taken for a final result code.
+ *
+ * @param text NUL terminated line
+ * @param[out] line classified line
+ */
+void esp_modem_line_classify(const char *text, esp_modem_line_t *line);
+
+/**
+ * @brief Check if a line is a final result code
+ *
+ * @param line classified line
+ * @return true for OK, CONNECT and the error result codes
+ */
+static inline bool esp_modem_line_is_final(const esp_modem_line_t *line)
+{
+    return line->type >= ESP_MODEM_LINE_OK;
+}
+
+/**
+ * @brief Check if a line is a final error result code (ERROR, +CME ERROR, +CMS ERROR)
+ *
+ * @param line classified line
+ */
+static inline bool esp_modem_line_is_error(const esp_modem_line_t *line)
+{
+    return line->type == ESP_MODEM_LINE_ERROR || line->type == ESP_MODEM_LINE_CME_ERROR ||
+           line->type == ESP_MODEM_LINE_CMS_ERROR;
+}
+
+/**
+ * @brief Check the prefix of an information response or unsolicited result code
+ *
+ * @param line classified line
+ * @param prefix prefix without ':', e.g. "+CSQ"
+ * @return true if the line starts with "<prefix>:", or is "<prefix>" for lines without parameters
+ */
+static inline bool esp_modem_line_has_prefix(const esp_modem_line_t *line, const char *prefix)
+{
+    size_t len = strlen(prefix);
+    if (line->prefix_len) {
+        return line->prefix_len == len && !strncmp(line->text, prefix, len);
+    }
+    return !strncmp(line->text, prefix, len);
+}
+
+/**
+ * @brief Check the whole parameters of a line, e.g. "READY" for "+CPIN: READY"
+ *
+ * @param line classified line
+ * @param value expected parameters
+ * @return true if the payload is value
+ */
+static inline bool esp_modem_line_payload_is(const esp_modem_line_t *line, const char *value)
+{
+    size_t len = strlen(value);
+    return line->payload_len == len && !strncmp(line->payload, value, len);
+}
+
+/**
+ * @brief Field tokenizer over the parameters of a line, without copy nor allocation
+ *
+ * Fields are separated by ',' outside of double quotes. Quoted fields are returned without the quotes,
+ * empty fields are returned with a zero length.
+ */
+typedef struct {
+    const char *pos;                /*!< Start of the next field */
+    const char *end;                /*!< End of the parameters */
+} esp_modem_fields_t;
+
+/**
+ * @brief Start tokenizing the parameters (payload) of a line
+ *
+ * @param fields tokenizer
+ * @param line classified line
+ */
+static inline void esp_modem_fields_init(esp_modem_fields_t *fields, const esp_modem_line_t *line)
+{
+    fields->pos = line->payload;
+    fields->end = line->payload + line->payload_len;
+}
+
+/**
+ * @brief Get the next field
+ *
+ * @param fields tokenizer
+ * @param[out] field start of the field, quotes removed
+ * @param[out] len length of the field
+ * @return true on success, false if there are no more fields
+ */
+bool esp_modem_fields_next(esp_modem_fields_t *fields, const char **field, size_t *len);
+
+/**
+ * @brief Skip fields
+ *
+ * @param fields tokenizer
+ * @param count number of fields to skip
+ * @return true on success, false if there are not enough fields
+ */
+bool esp_modem_fields_skip(esp_modem_fields_t *fields, int count);
+
+/**
+ * @brief Get the next field as a decimal integer
+ *
+ * @param fields tokenizer
+ * @param[out] value value, unchanged if the field is empty or not a number
+ * @return true on success, false if there are no more fields or the field is not a decimal number
+ */
+bool esp_modem_fields_int(esp_modem_fields_t *fields, int32_t *value);
+
+/**
+ * @brief Get the next field as a hexadecimal integer (e.g. "1A2B", quoted or not)
+ *
+ * @param fields tokenizer
+ * @param[out] value value, unchanged if the field is empty or not a number
+ * @return true on success, false if there are no more fields or the field is not a hexadecimal number
+ */
+bool esp_modem_fields_hex(esp_modem_fields_t *fields, uint32_t *value);
+
+/**
+ * @brief Copy the next field as a string, quotes removed
+ *
+ * @param fields tokenizer
+ * @param[out] str string, truncated to size - 1 characters
+ * @param size size of str
+ * @return true on success, false if there are no more fields
+ */
+bool esp_modem_fields_str(esp_modem_fields_t *fields, char *str, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
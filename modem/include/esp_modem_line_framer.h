@@ -0,0 +1,134 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Callback receiving framed lines
+ *
+ * A line is terminated by '\n' and passed including its "\r\n" tail, as a NUL terminated string.
+ * Lines longer than the line buffer are passed in several segments, all but the last one with line_end false.
+ *
+ * @param context context given to esp_modem_line_framer_init()
+ * @param segment line (or line segment)
+ * @param len length of the segment
+ * @param line_end true if the segment ends the line
+ */
+typedef void (*esp_modem_line_cb)(void *context, const char *segment, size_t len, bool line_end);
+
+/**
+ * @brief Incremental line framer
+ *
+ * Raw data are written into a ring buffer, either copied with esp_modem_line_framer_feed() or written in place
+ * after esp_modem_line_framer_get_write_ptr(). Complete lines are copied to the line buffer and passed to the
+ * callback, partial lines are kept in the ring buffer until the rest of the line arrives.
+ */
+typedef struct {
+    uint8_t *ring;                  /*!< Ring buffer storage */
+    size_t ring_size;               /*!< Ring buffer size, power of two */
+    size_t head;                    /*!< Write position (free running) */
+    size_t tail;                    /*!< Read position (free running) */
+    size_t scanned;                 /*!< Bytes after tail already known to contain no line end */
+    char *line;                     /*!< Line buffer passed to the callback */
+    size_t line_size;               /*!< Max segment length (line buffer size without the NUL terminator) */
+    esp_modem_line_cb line_cb;      /*!< Line callback */
+    void *context;                  /*!< Line callback context */
+} esp_modem_line_framer_t;
+
+/**
+ * @brief Initialize a line framer
+ *
+ * @param framer line framer
+ * @param ring ring buffer storage
+ * @param ring_size ring buffer size, power of two and at least twice the line buffer size
+ * @param line line buffer
+ * @param line_buffer_size line buffer size (including the NUL terminator)
+ * @param line_cb line callback
+ * @param context line callback context
+ * @return true on success, false if the buffer sizes are not valid
+ */
+bool esp_modem_line_framer_init(esp_modem_line_framer_t *framer, uint8_t *ring, size_t ring_size,
+                                char *line, size_t line_buffer_size, esp_modem_line_cb line_cb, void *context);
+
+/**
+ * @brief Drop all pending data
+ *
+ * @param framer line framer
+ */
+void esp_modem_line_framer_reset(esp_modem_line_framer_t *framer);
+
+/**
+ * @brief Get the contiguous free space of the ring buffer to write data in place
+ *
+ * @param framer line framer
+ * @param[out] ptr write position
+ * @return number of bytes which can be written at ptr
+ */
+size_t esp_modem_line_framer_get_write_ptr(esp_modem_line_framer_t *framer, uint8_t **ptr);
+
+/**
+ * @brief Commit data written in place and pass the completed lines to the callback
+ *
+ * @param framer line framer
+ * @param len number of bytes written at the write position
+ */
+void esp_modem_line_framer_commit(esp_modem_line_framer_t *framer, size_t len);
+
+/**
+ * @brief Copy data into the framer and pass the completed lines to the callback
+ *
+ * @param framer line framer
+ * @param data data
+ * @param len length of data
+ */
+void esp_modem_line_framer_feed(esp_modem_line_framer_t *framer, const uint8_t *data, size_t len);
+
+/**
+ * @brief Number of pending bytes (not yet passed to the callback)
+ *
+ * @param framer line framer
+ * @return pending bytes
+ */
+size_t esp_modem_line_framer_pending(const esp_modem_line_framer_t *framer);
+
+/**
+ * @brief Take pending bytes out of the framer without line processing
+ *
+ * @param framer line framer
+ * @param dst destination buffer
+ * @param max size of the destination buffer
+ * @return number of bytes copied to dst
+ */
+size_t esp_modem_line_framer_take(esp_modem_line_framer_t *framer, uint8_t *dst, size_t max);
+
+/**
+ * @brief Consume a prompt (text not terminated by a line end) at the beginning of the pending data
+ *
+ * @param framer line framer
+ * @param prompt prompt string
+ * @param len length of the prompt
+ * @return true if the pending data started with the prompt and it has been consumed
+ */
+bool esp_modem_line_framer_consume_prompt(esp_modem_line_framer_t *framer, const char *prompt, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -20,6 +20,9 @@ extern "C" {
 /**
  * @brief Creates handle to esp_modem used as an esp-netif driver
  *
+ * In the static configuration the handle is allocated from the arena of the DTE and not given back by
+ * esp_modem_netif_teardown(): create it once and keep it across reconnections.
+ *
  * @param dte ESP Modem DTE object
  *
  * @return opaque pointer to esp-modem IO driver used to attach to esp-netif
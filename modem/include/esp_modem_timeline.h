@@ -0,0 +1,135 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#define ESP_MODEM_TIMELINE_SIZE (64)    /*!< Number of milestones kept, the oldest ones are overwritten */
+
+/**
+ * @brief Connection lifecycle milestones
+ *
+ */
+typedef enum {
+    ESP_MODEM_MILESTONE_DTE_INIT_START,     /*!< esp_modem_dte_init() called */
+    ESP_MODEM_MILESTONE_DTE_INIT_DONE,      /*!< DTE ready */
+    ESP_MODEM_MILESTONE_DCE_INIT,           /*!< DCE object created */
+    ESP_MODEM_MILESTONE_RDY,                /*!< Module reported RDY */
+    ESP_MODEM_MILESTONE_SIM_READY,          /*!< SIM ready (+CPIN: READY) */
+    ESP_MODEM_MILESTONE_CONFIGURE_START,    /*!< Module configuration started */
+    ESP_MODEM_MILESTONE_SYNC,               /*!< Module answers AT */
+    ESP_MODEM_MILESTONE_FACTORY_RESET,      /*!< Factory settings restored */
+    ESP_MODEM_MILESTONE_ECHO_OFF,           /*!< Echo disabled */
+    ESP_MODEM_MILESTONE_BAUDRATE,           /*!< Working baud rate set */
+    ESP_MODEM_MILESTONE_SIM_STATUS,         /*!< SIM status read */
+    ESP_MODEM_MILESTONE_DTR_MODE,           /*!< DTR behaviour set */
+    ESP_MODEM_MILESTONE_FAST_SHUTDOWN,      /*!< Fast shutdown enabled (or given up) */
+    ESP_MODEM_MILESTONE_CONFIGURE_DONE,     /*!< Module configuration done */
+    ESP_MODEM_MILESTONE_MODULE_INFO,        /*!< Module name, IMEI, IMSI and operator read */
+    ESP_MODEM_MILESTONE_REGISTERED,         /*!< Registered on the network (home or roaming) */
+    ESP_MODEM_MILESTONE_PPP_START,          /*!< PPP mode requested */
+    ESP_MODEM_MILESTONE_CONNECT,            /*!< CONNECT received, data mode */
+    ESP_MODEM_MILESTONE_LCP_UP,             /*!< PPP link established (LCP opened) */
+    ESP_MODEM_MILESTONE_IP_ACQUIRED,        /*!< IP address acquired */
+    ESP_MODEM_MILESTONE_PPP_STOP,           /*!< PPP mode stopped */
+    ESP_MODEM_MILESTONE_MAX
+} esp_modem_milestone_t;
+
+/**
+ * @brief Timeline entry
+ *
+ */
+typedef struct {
+    esp_modem_milestone_t milestone;    /*!< Milestone */
+    int64_t time_us;                    /*!< Time since boot (esp_timer_get_time()) */
+} esp_modem_timeline_entry_t;
+
+/**
+ * @brief Durations of the lifecycle phases (unit: us), -1 if a bounding milestone has not been reached yet
+ *
+ * Computed from the latest occurrence of each milestone.
+ */
+typedef struct {
+    int64_t dte_init_us;        /*!< DTE_INIT_START -> DTE_INIT_DONE */
+    int64_t module_boot_us;     /*!< DTE_INIT_DONE -> RDY */
+    int64_t configure_us;       /*!< CONFIGURE_START -> CONFIGURE_DONE */
+    int64_t module_info_us;     /*!< CONFIGURE_DONE -> MODULE_INFO */
+    int64_t registration_us;    /*!< CONFIGURE_DONE -> REGISTERED */
+    int64_t dial_us;            /*!< PPP_START -> CONNECT */
+    int64_t lcp_us;             /*!< CONNECT -> LCP_UP */
+    int64_t ip_us;              /*!< LCP_UP -> IP_ACQUIRED */
+    int64_t total_us;           /*!< DTE_INIT_START -> IP_ACQUIRED */
+} esp_modem_timeline_phases_t;
+
+/**
+ * @brief Record a milestone now, can be called from any task
+ *
+ * @param milestone milestone
+ */
+void esp_modem_timeline_mark(esp_modem_milestone_t milestone);
+
+/**
+ * @brief Clear the timeline
+ */
+void esp_modem_timeline_reset(void);
+
+/**
+ * @brief Copy the timeline, oldest entry first
+ *
+ * @param[out] entries destination
+ * @param max number of entries of the destination
+ * @return number of entries copied
+ */
+size_t esp_modem_timeline_get(esp_modem_timeline_entry_t *entries, size_t max);
+
+/**
+ * @brief Get the time of the latest occurrence of a milestone
+ *
+ * @param milestone milestone
+ * @return time since boot (us), -1 if not reached
+ */
+int64_t esp_modem_timeline_get_time(esp_modem_milestone_t milestone);
+
+/**
+ * @brief Get the durations of the lifecycle phases
+ *
+ * @param[out] phases phase durations
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG if phases is NULL
+ */
+esp_err_t esp_modem_timeline_get_phases(esp_modem_timeline_phases_t *phases);
+
+/**
+ * @brief Get the name of a milestone
+ *
+ * @param milestone milestone
+ * @return name
+ */
+const char *esp_modem_milestone_name(esp_modem_milestone_t milestone);
+
+/**
+ * @brief Log the timeline and the phase durations
+ */
+void esp_modem_timeline_log(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -13,18 +13,25 @@
 // limitations under the License.
 #include <stdlib.h>
 #include <string.h>
+#include <sys/param.h>
 #include "esp_log.h"
 #include "ec21.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "esp_timer.h"
+#include "esp_modem_timeline.h"
 #include "DrvNvs.h"
+#include "nvs.h"
 
 #define MODEM_RESULT_CODE_POWERDOWN "POWERED DOWN"
 
 /* if 1 enable th emodule automatic answer: used for laboratory tests*/
 #define AUTO_ANSWER_CMC_TEST         0
 
-/* set the baudrate to configure the LTE modem after the first boot*/
+/* highest baudrate tried once the module has been found, the link settles on the highest stable one */
 #define EC21_WORKING_BAUDRATE       921600
+/* module factory default, probed first when the stored rate does not answer */
+#define EC21_DEFAULT_BAUDRATE       115200
 
 #define BAND1_LTE_MASK                  0x1
 #define BAND3_LTE_MASK                  0x4
@@ -34,6 +41,31 @@
 
 #define ENABLE_FAST_SHUTDOWN_MAX_RETRY          10
 
+/* Readiness reported by the module, see ec21_update_readiness() */
+#define EC21_READY_RDY                  (1 << 0)  /*!< RDY: module booted */
+#define EC21_READY_SIM                  (1 << 1)  /*!< +CPIN: READY */
+#define EC21_READY_SMS                  (1 << 2)  /*!< +QIND: SMS DONE */
+#define EC21_READY_PB                   (1 << 3)  /*!< +QIND: PB DONE */
+
+/* Bounds of the readiness waits and probes (unit: ms) */
+#define EC21_SYNC_RETRY_WAIT_MS         500     /*!< Wait for RDY before retrying the sync */
+#define EC21_PROBE_TIMEOUT_MS           1000    /*!< Max time for the module to answer AT again */
+#define EC21_PROBE_RETRY_WAIT_MS        50      /*!< Wait between two AT probes */
+#define EC21_SIM_READY_WAIT_MS          300     /*!< Wait for +CPIN: READY before querying the SIM */
+#define EC21_INIT_DONE_WAIT_MS          1000    /*!< Wait for SMS/PB DONE before enabling fast shutdown */
+#define EC21_FAST_SHUTDOWN_RETRY_WAIT_MS 200    /*!< Wait between two fast shutdown attempts */
+#define EC21_FAST_SHUTDOWN_TIMEOUT_MS   (ENABLE_FAST_SHUTDOWN_MAX_RETRY * 1000)
+#define EC21_AUTOBAUD_PROBE_TIMEOUT_MS  300     /*!< Time to answer AT at a candidate baud rate */
+#define EC21_BAUDRATE_CHECK_ROUNDS      8       /*!< ATI round trips checked before keeping a higher baud rate */
+#define EC21_DTR_PULSE_MS               20      /*!< Time DTR stays off to leave the data mode */
+#define EC21_DTR_ESCAPE_TIMEOUT_MS      500     /*!< Max wait for the result code after the DTR pulse */
+
+#define EC21_ICCID_LENGTH               20      /*!< Max ICCID length */
+#define EC21_NVS_NAMESPACE              "ec21"      /*!< NVS namespace of the module runtime data */
+#define EC21_NVS_IDENTITY_KEY           "identity"  /*!< NVS key of the cached module identity */
+
+/* Baud rates supported by AT+IPR, highest first */
+static const uint32_t s_ec21_baudrates[] = { 921600, 460800, 230400, 115200, 57600, 38400, 19200, 9600 };
 /**
  * @brief Macro defined for error checking
  *
@@ -49,12 +81,87 @@ static const char *DCE_TAG = "ec21";
         }                                                                             \
     } while (0)
 
+/**
+ * @brief Network status reported by the module, time 0 if never reported
+ *
+ */
+typedef struct {
+    ec21_registration_t creg;   /*!< CS registration (+CREG) */
+    int64_t creg_time_us;       /*!< Time of the last +CREG */
+    ec21_registration_t cereg;  /*!< EPS registration (+CEREG) */
+    int64_t cereg_time_us;      /*!< Time of the last +CEREG */
+    uint32_t rssi;              /*!< Received signal strength indication */
+    uint32_t ber;               /*!< Bit error ratio */
+    int64_t csq_time_us;        /*!< Time of the last signal quality */
+} ec21_status_cache_t;
+
+/**
+ * @brief Module identity persisted in NVS, valid while the same SIM (ICCID) is inserted
+ *
+ */
+typedef struct {
+    char iccid[EC21_ICCID_LENGTH + 1];      /*!< ICCID of the SIM, key of the cache */
+    char name[MODEM_MAX_NAME_LENGTH];       /*!< Module name */
+    char imei[MODEM_IMEI_LENGTH + 1];       /*!< IMEI number */
+    char imsi[MODEM_IMSI_LENGTH + 1];       /*!< IMSI number */
+    char oper[MODEM_MAX_OPERATOR_LENGTH];   /*!< Last operator name */
+} ec21_identity_t;
+
+/**
+ * @brief Background refresh of the cached identity
+ *
+ */
+typedef struct {
+    ec21_identity_t identity;   /*!< Identity being read */
+    esp_err_t result;           /*!< First error of the queries, under identity_lock */
+    int pending;                /*!< Queries still in flight, under identity_lock */
+} ec21_identity_refresh_t;
+
+/**
+ * @brief Values parsed from the response of a request
+ *
+ */
+typedef union {
+    struct {
+        int32_t rssi;                       /*!< Received signal strength indication */
+        int32_t ber;                        /*!< Bit error ratio */
+    } csq;                                  /*!< AT+CSQ */
+    struct {
+        int32_t bcs;                        /*!< Battery charge status */
+        int32_t bcl;                        /*!< Battery connection level */
+        int32_t voltage;                    /*!< Battery voltage */
+    } cbc;                                  /*!< AT+CBC */
+    bool garbled;                           /*!< ATI: a line had bytes out of the printable range */
+    bool band7;                             /*!< AT+QCFG="band": LTE band 7 enabled */
+    modem_network_status_t creg;            /*!< AT+CREG? */
+    char iccid[EC21_ICCID_LENGTH + 1];      /*!< AT+QCCID */
+} ec21_result_t;
+
+/**
+ * @brief Result slot of the request in progress
+ *
+ * Owned by the DCE rather than by the caller stack: a response arriving after its request timed out finds the
+ * slot closed (or the generation of another request) and is dropped instead of writing through a stale pointer.
+ */
+typedef struct {
+    uint32_t generation;                    /*!< Request the slot belongs to */
+    bool open;                              /*!< The request waits for its response */
+    bool valid;                             /*!< value was set by the response */
+    ec21_result_t value;                    /*!< Parsed values */
+} ec21_result_slot_t;
+
 /**
  * @brief EC21 Modem
  *
  */
 typedef struct {
-    void *priv_resource; /*!< Private resource */
+    ec21_result_slot_t result; /*!< Result of the request in progress */
+    portMUX_TYPE result_lock; /*!< Lock of the result slot */
+    EventGroupHandle_t readiness; /*!< Readiness reported by the module (EC21_READY_xxx) */
+    ec21_status_cache_t cache; /*!< Network status reported by the module */
+    portMUX_TYPE cache_lock; /*!< Lock of the network status cache */
+    portMUX_TYPE identity_lock; /*!< Lock of the identity fields of the DCE, the identity cache and its refresh */
+    esp_modem_arena_t *arena; /*!< Arena the object was allocated from, NULL for the heap */
     modem_dce_t parent;  /*!< DCE parent class */
 } ec21_modem_dce_t;
 
@@ -63,24 +170,285 @@ static ec21_modem_dce_t *ec21_dce = (void*)0;
 
 static DrvNvs_element_t *gpDrvNvs_baudrate = (void*)0;
 
+static ec21_identity_t gIdentityCache;
+
+static bool gIdentityCacheValid = false;
+
+static ec21_identity_refresh_t gIdentityRefresh;
+
+static ec21_startup_report_t gStartupReport;
+
+
+/**
+ * @brief Record the readiness reported by the module in an unsolicited line
+ */
+static void ec21_update_readiness(ec21_modem_dce_t *ec21_dce, const esp_modem_line_t *line)
+{
+   EventBits_t bits = 0;
+   if (line->type != ESP_MODEM_LINE_URC)
+   {
+      return;
+   }
+   if (esp_modem_line_has_prefix(line, "RDY"))
+   {
+      bits = EC21_READY_RDY;
+   }
+   else if (esp_modem_line_has_prefix(line, "+CPIN"))
+   {
+      bits = esp_modem_line_payload_is(line, "READY") ? EC21_READY_SIM : 0;
+   }
+   else if (esp_modem_line_has_prefix(line, "+QIND"))
+   {
+      if (esp_modem_line_payload_is(line, "SMS DONE"))
+      {
+         bits = EC21_READY_SMS;
+      }
+      else if (esp_modem_line_payload_is(line, "PB DONE"))
+      {
+         bits = EC21_READY_PB;
+      }
+   }
+   if (bits & EC21_READY_RDY)
+   {
+      esp_modem_timeline_mark(ESP_MODEM_MILESTONE_RDY);
+   }
+   else if (bits & EC21_READY_SIM)
+   {
+      esp_modem_timeline_mark(ESP_MODEM_MILESTONE_SIM_READY);
+   }
+   if (bits && ec21_dce->readiness)
+   {
+      xEventGroupSetBits(ec21_dce->readiness, bits);
+   }
+}
+
+/**
+ * @brief Record the registration on the timeline, home network or roaming
+ */
+static void ec21_mark_registration(modem_network_status_t status)
+{
+   if (status == MODEM_NET_STA_REGISTERED_H_N || status == MODEM_NET_STA_REGISTERED_ROAMING)
+   {
+      esp_modem_timeline_mark(ESP_MODEM_MILESTONE_REGISTERED);
+   }
+}
+
+/**
+ * @brief Store a registration in the network status cache
+ *
+ * @param eps true for +CEREG, false for +CREG
+ */
+static void ec21_cache_registration(ec21_modem_dce_t *ec21_dce, bool eps, const ec21_registration_t *registration)
+{
+   int64_t now = esp_timer_get_time();
+   portENTER_CRITICAL(&ec21_dce->cache_lock);
+   if (eps)
+   {
+      ec21_dce->cache.cereg = *registration;
+      ec21_dce->cache.cereg_time_us = now;
+   }
+   else
+   {
+      ec21_dce->cache.creg = *registration;
+      ec21_dce->cache.creg_time_us = now;
+   }
+   portEXIT_CRITICAL(&ec21_dce->cache_lock);
+   ec21_mark_registration(registration->status);
+}
+
+/**
+ * @brief Store the signal quality in the network status cache
+ */
+static void ec21_cache_signal_quality(ec21_modem_dce_t *ec21_dce, uint32_t rssi, uint32_t ber)
+{
+   int64_t now = esp_timer_get_time();
+   portENTER_CRITICAL(&ec21_dce->cache_lock);
+   ec21_dce->cache.rssi = rssi;
+   ec21_dce->cache.ber = ber;
+   ec21_dce->cache.csq_time_us = now;
+   portEXIT_CRITICAL(&ec21_dce->cache_lock);
+}
+
+/**
+ * @brief Parse the registration fields following <n> or <stat>: <stat>[,"<lac>","<ci>"[,<AcT>]]
+ *
+ * @return true if at least the status has been read
+ */
+static bool ec21_parse_registration(esp_modem_fields_t *fields, ec21_registration_t *registration)
+{
+   int32_t stat = 0;
+   uint32_t lac = 0, ci = 0;
+   int32_t act = -1;
+   if (!esp_modem_fields_int(fields, &stat))
+   {
+      return false;
+   }
+   esp_modem_fields_hex(fields, &lac);
+   esp_modem_fields_hex(fields, &ci);
+   esp_modem_fields_int(fields, &act);
+   registration->status = stat;
+   registration->lac = lac;
+   registration->cell_id = ci;
+   registration->act = act;
+   return true;
+}
+
+/**
+ * @brief Record the network status reported in an unsolicited line
+ *
+ * +CREG: <stat>[,"<lac>","<ci>",<AcT>]
+ * +CEREG: <stat>[,"<tac>","<ci>",<AcT>]
+ * +QIND: "csq",<rssi>,<ber>
+ */
+static void ec21_update_status_cache(ec21_modem_dce_t *ec21_dce, const esp_modem_line_t *line)
+{
+   ec21_registration_t registration;
+   esp_modem_fields_t fields;
+   const char *indication;
+   size_t len;
+   int32_t rssi = 0, ber = 0;
+   esp_modem_fields_init(&fields, line);
+   if (esp_modem_line_has_prefix(line, "+CREG"))
+   {
+      if (ec21_parse_registration(&fields, &registration))
+      {
+         ec21_cache_registration(ec21_dce, false, &registration);
+      }
+   }
+   else if (esp_modem_line_has_prefix(line, "+CEREG"))
+   {
+      if (ec21_parse_registration(&fields, &registration))
+      {
+         ec21_cache_registration(ec21_dce, true, &registration);
+      }
+   }
+   else if (esp_modem_line_has_prefix(line, "+QIND") && esp_modem_fields_next(&fields, &indication, &len) &&
+            len == strlen("csq") && !strncmp(indication, "csq", len))
+   {
+      if (esp_modem_fields_int(&fields, &rssi) && esp_modem_fields_int(&fields, &ber))
+      {
+         ec21_cache_signal_quality(ec21_dce, rssi, ber);
+      }
+   }
+}
+
+/**
+ * @brief Unsolicited lines updating the readiness and the network status cache
+ */
+static const char *const ec21_urc_prefixes[] = { "RDY", "+CPIN", "+QIND", "+CREG", "+CEREG" };
+
+/**
+ * @brief Catch the readiness and network status lines received while a command was in progress,
+ * routed from the DTE receive task
+ */
+static void ec21_on_urc(modem_dte_t *dte, const esp_modem_line_t *line, void *context)
+{
+   ec21_update_readiness(context, line);
+   ec21_update_status_cache(context, line);
+}
+
+/**
+ * @brief Wait (bounded) for readiness bits, the time waited is accounted in the startup report
+ *
+ * @return true if all the bits are set
+ */
+static bool ec21_wait_ready(ec21_modem_dce_t *ec21_dce, EventBits_t bits, uint32_t timeout_ms)
+{
+   int64_t start = esp_timer_get_time();
+   EventBits_t set = xEventGroupWaitBits(ec21_dce->readiness, bits, pdFALSE, pdTRUE, pdMS_TO_TICKS(timeout_ms));
+   gStartupReport.waited_ms += (esp_timer_get_time() - start) / 1000;
+   return (set & bits) == bits;
+}
+
+/**
+ * @brief Probe with AT until the module answers, bounded by timeout_ms
+ */
+static esp_err_t ec21_probe(ec21_modem_dce_t *ec21_dce, uint32_t timeout_ms)
+{
+   int64_t start = esp_timer_get_time();
+   while (esp_modem_dce_sync(&ec21_dce->parent) != ESP_OK)
+   {
+      DCE_CHECK((esp_timer_get_time() - start) / 1000 < timeout_ms, "module not answering", err);
+      vTaskDelay(pdMS_TO_TICKS(EC21_PROBE_RETRY_WAIT_MS));
+      gStartupReport.waited_ms += EC21_PROBE_RETRY_WAIT_MS;
+   }
+   return ESP_OK;
+err:
+   return ESP_FAIL;
+}
+
+
+/**
+ * @brief Open the result slot for a new request
+ *
+ * @return generation of the request, to give to ec21_end_request()
+ */
+static uint32_t ec21_begin_request(ec21_modem_dce_t *ec21_dce)
+{
+    portENTER_CRITICAL(&ec21_dce->result_lock);
+    uint32_t generation = ++ec21_dce->result.generation;
+    ec21_dce->result.open = true;
+    ec21_dce->result.valid = false;
+    memset(&ec21_dce->result.value, 0, sizeof(ec21_result_t));
+    portEXIT_CRITICAL(&ec21_dce->result_lock);
+    return generation;
+}
+
+/**
+ * @brief Store the values parsed by a response handler, dropped if no request waits for them
+ */
+static void ec21_set_result(ec21_modem_dce_t *ec21_dce, const ec21_result_t *value)
+{
+    portENTER_CRITICAL(&ec21_dce->result_lock);
+    if (ec21_dce->result.open) {
+        ec21_dce->result.value = *value;
+        ec21_dce->result.valid = true;
+    }
+    portEXIT_CRITICAL(&ec21_dce->result_lock);
+}
+
+/**
+ * @brief Close the result slot of a request, whatever the outcome of the command
+ *
+ * @param ec21_dce ec21 object
+ * @param generation generation returned by ec21_begin_request()
+ * @param[out] value parsed values, set if the response carried them
+ * @return true if value was set
+ */
+static bool ec21_end_request(ec21_modem_dce_t *ec21_dce, uint32_t generation, ec21_result_t *value)
+{
+    portENTER_CRITICAL(&ec21_dce->result_lock);
+    bool valid = ec21_dce->result.generation == generation && ec21_dce->result.valid;
+    if (valid) {
+        *value = ec21_dce->result.value;
+    }
+    ec21_dce->result.open = false;
+    portEXIT_CRITICAL(&ec21_dce->result_lock);
+    return valid;
+}
 
 /**
  * @brief Handle response from AT+CSQ
  */
-static esp_err_t ec21_handle_csq(modem_dce_t *dce, const char *line)
+static esp_err_t ec21_handle_csq(modem_dce_t *dce, const esp_modem_line_t *line)
 {
     esp_err_t err = ESP_FAIL;
     ec21_modem_dce_t *ec21_dce = __containerof(dce, ec21_modem_dce_t, parent);
-    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+    if (line->type == ESP_MODEM_LINE_OK) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
-    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+    } else if (esp_modem_line_is_error(line)) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
-    } else if (!strncmp(line, "+CSQ", strlen("+CSQ"))) {
+    } else if (esp_modem_line_has_prefix(line, "+CSQ")) {
         /* store value of rssi and ber */
-        uint32_t **csq = ec21_dce->priv_resource;
+        ec21_result_t result;
+        esp_modem_fields_t fields;
         /* +CSQ: <rssi>,<ber> */
-        sscanf(line, "%*s%d,%d", csq[0], csq[1]);
-        err = ESP_OK;
+        esp_modem_fields_init(&fields, line);
+        if (esp_modem_fields_int(&fields, &result.csq.rssi) && esp_modem_fields_int(&fields, &result.csq.ber)) {
+            ec21_set_result(ec21_dce, &result);
+            ec21_cache_signal_quality(ec21_dce, result.csq.rssi, result.csq.ber);
+            err = ESP_OK;
+        }
     }
     return err;
 }
@@ -88,20 +456,25 @@ static esp_err_t ec21_handle_csq(modem_dce_t *dce, const char *line)
 /**
  * @brief Handle response from AT+CBC
  */
-static esp_err_t ec21_handle_cbc(modem_dce_t *dce, const char *line)
+static esp_err_t ec21_handle_cbc(modem_dce_t *dce, const esp_modem_line_t *line)
 {
     esp_err_t err = ESP_FAIL;
     ec21_modem_dce_t *ec21_dce = __containerof(dce, ec21_modem_dce_t, parent);
-    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+    if (line->type == ESP_MODEM_LINE_OK) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
-    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+    } else if (esp_modem_line_is_error(line)) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
-    } else if (!strncmp(line, "+CBC", strlen("+CBC"))) {
+    } else if (esp_modem_line_has_prefix(line, "+CBC")) {
         /* store value of bcs, bcl, voltage */
-        uint32_t **cbc = ec21_dce->priv_resource;
+        ec21_result_t result;
+        esp_modem_fields_t fields;
         /* +CBC: <bcs>,<bcl>,<voltage> */
-        sscanf(line, "%*s%d,%d,%d", cbc[0], cbc[1], cbc[2]);
-        err = ESP_OK;
+        esp_modem_fields_init(&fields, line);
+        if (esp_modem_fields_int(&fields, &result.cbc.bcs) && esp_modem_fields_int(&fields, &result.cbc.bcl) &&
+            esp_modem_fields_int(&fields, &result.cbc.voltage)) {
+            ec21_set_result(ec21_dce, &result);
+            err = ESP_OK;
+        }
     }
     return err;
 }
@@ -109,14 +482,14 @@ static esp_err_t ec21_handle_cbc(modem_dce_t *dce, const char *line)
 /**
  * @brief Handle response from +++
  */
-static esp_err_t ec21_handle_exit_data_mode(modem_dce_t *dce, const char *line)
+static esp_err_t ec21_handle_exit_data_mode(modem_dce_t *dce, const esp_modem_line_t *line)
 {
     esp_err_t err = ESP_FAIL;
-    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+    if (line->type == ESP_MODEM_LINE_OK) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
-    } else if (strstr(line, MODEM_RESULT_CODE_NO_CARRIER)) {
+    } else if (line->type == ESP_MODEM_LINE_NO_CARRIER) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
-    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+    } else if (esp_modem_line_is_error(line)) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
     }
     return err;
@@ -125,18 +498,19 @@ static esp_err_t ec21_handle_exit_data_mode(modem_dce_t *dce, const char *line)
 /**
  * @brief Handle response from ATD*99#
  */
-static esp_err_t ec21_handle_atd_ppp( modem_dce_t * dce, const char * line )
+static esp_err_t ec21_handle_atd_ppp( modem_dce_t *dce, const esp_modem_line_t *line )
 {
    esp_err_t err = ESP_FAIL;
-   if ( strstr( line, MODEM_RESULT_CODE_CONNECT ) )
+   if ( line->type == ESP_MODEM_LINE_CONNECT )
    {
+      esp_modem_timeline_mark( ESP_MODEM_MILESTONE_CONNECT );
       err = esp_modem_process_command_done( dce, MODEM_STATE_SUCCESS );
    }
-   else if ( strstr( line, MODEM_RESULT_CODE_ERROR ) )
+   else if ( esp_modem_line_is_error(line) )
    {
       err = esp_modem_process_command_done( dce, MODEM_STATE_FAIL );
    }
-   else if ( strstr( line, MODEM_RESULT_CODE_NO_CARRIER ) )
+   else if ( line->type == ESP_MODEM_LINE_NO_CARRIER )
    {
       err = esp_modem_process_command_done( dce, MODEM_STATE_FAIL );
    }
@@ -146,20 +520,40 @@ static esp_err_t ec21_handle_atd_ppp( modem_dce_t * dce, const char * line )
 /**
  * @brief Handle response from AT+CGMM
  */
-static esp_err_t ec21_handle_cgmm(modem_dce_t *dce, const char *line)
+static esp_err_t ec21_handle_cgmm(modem_dce_t *dce, const esp_modem_line_t *line)
+{
+    esp_err_t err = ESP_FAIL;
+    if (line->type == ESP_MODEM_LINE_OK) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    } else if (esp_modem_line_is_error(line)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    } else if (line->type == ESP_MODEM_LINE_INFO && line->len) {
+        snprintf(dce->name, MODEM_MAX_NAME_LENGTH, "%.*s", (int)line->len, line->text);
+        err = ESP_OK;
+    }
+    return err;
+}
+
+/**
+ * @brief Handle response from ATI, flag the information lines with bytes out of the printable range
+ */
+static esp_err_t ec21_handle_ati(modem_dce_t *dce, const esp_modem_line_t *line)
 {
     esp_err_t err = ESP_FAIL;
-    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+    ec21_modem_dce_t *ec21_dce = __containerof(dce, ec21_modem_dce_t, parent);
+    if (line->type == ESP_MODEM_LINE_OK) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
-    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+    } else if (esp_modem_line_is_error(line)) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
     } else {
-        int len = snprintf(dce->name, MODEM_MAX_NAME_LENGTH, "%s", line);
-        if (len > 2) {
-            /* Strip "\r\n" */
-            strip_cr_lf_tail(dce->name, len);
-            err = ESP_OK;
+        for (size_t i = 0; i < line->len; i++) {
+            if (line->text[i] < ' ' || line->text[i] > '~') {
+                const ec21_result_t result = { .garbled = true };
+                ec21_set_result(ec21_dce, &result);
+                break;
+            }
         }
+        err = ESP_OK;
     }
     return err;
 }
@@ -167,20 +561,16 @@ static esp_err_t ec21_handle_cgmm(modem_dce_t *dce, const char *line)
 /**
  * @brief Handle response from AT+CGSN
  */
-static esp_err_t ec21_handle_cgsn(modem_dce_t *dce, const char *line)
+static esp_err_t ec21_handle_cgsn(modem_dce_t *dce, const esp_modem_line_t *line)
 {
    esp_err_t err = ESP_FAIL;
-   if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+   if (line->type == ESP_MODEM_LINE_OK) {
       err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
-   } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+   } else if (esp_modem_line_is_error(line)) {
       err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
-   } else {
-      int len = snprintf(dce->imei, MODEM_IMEI_LENGTH + 1, "%s", line);
-      if (len > 2) {
-         /* Strip "\r\n" */
-         strip_cr_lf_tail(dce->imei, len);
-         err = ESP_OK;
-      }
+   } else if (line->type == ESP_MODEM_LINE_INFO && line->len) {
+      snprintf(dce->imei, MODEM_IMEI_LENGTH + 1, "%.*s", (int)line->len, line->text);
+      err = ESP_OK;
    }
    return err;
 }
@@ -188,121 +578,149 @@ static esp_err_t ec21_handle_cgsn(modem_dce_t *dce, const char *line)
 /**
  * @brief Handle response from AT+CIMI
  */
-static esp_err_t ec21_handle_cimi(modem_dce_t *dce, const char *line)
+static esp_err_t ec21_handle_cimi(modem_dce_t *dce, const esp_modem_line_t *line)
 {
     esp_err_t err = ESP_FAIL;
 
-    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+    if (line->type == ESP_MODEM_LINE_OK) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
-    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+    } else if (esp_modem_line_is_error(line)) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
-    } else {
-        int len = snprintf(dce->imsi, MODEM_IMSI_LENGTH + 1, "%s", line);
-        if (len > 2) {
-            /* Strip "\r\n" */
-            strip_cr_lf_tail(dce->imsi, len);
+    } else if (line->type == ESP_MODEM_LINE_INFO && line->len) {
+        snprintf(dce->imsi, MODEM_IMSI_LENGTH + 1, "%.*s", (int)line->len, line->text);
+        err = ESP_OK;
+    }
+    return err;
+}
+
+/**
+ * @brief Handle response from AT+QCCID
+ */
+static esp_err_t ec21_handle_qccid(modem_dce_t *dce, const esp_modem_line_t *line)
+{
+    esp_err_t err = ESP_FAIL;
+    ec21_modem_dce_t *ec21_dce = __containerof(dce, ec21_modem_dce_t, parent);
+    if (line->type == ESP_MODEM_LINE_OK) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    } else if (esp_modem_line_is_error(line)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    } else if (esp_modem_line_has_prefix(line, "+QCCID")) {
+        /* +QCCID: <iccid> */
+        ec21_result_t result;
+        if (line->payload_len > 0 && line->payload_len <= EC21_ICCID_LENGTH) {
+            memcpy(result.iccid, line->payload, line->payload_len);
+            result.iccid[line->payload_len] = '\0';
+            ec21_set_result(ec21_dce, &result);
             err = ESP_OK;
         }
     }
     return err;
 }
 
-
-static esp_err_t ec21_handle_default(modem_dce_t *dce, const char *line)
+static esp_err_t ec21_handle_default(modem_dce_t *dce, const esp_modem_line_t *line)
 {
     esp_err_t err = ESP_FAIL;
 
-    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+    if (line->type == ESP_MODEM_LINE_OK) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
         /* set the baudrate ok*/
         dce->baudStatus = MODEM_BRS_OK;
-    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+    } else if (esp_modem_line_is_error(line)) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
-    } else {
-        int len = snprintf(dce->imsi, MODEM_IMSI_LENGTH + 1, "%s", line);
-        if (len > 2) {
-            /* Strip "\r\n" */
-            strip_cr_lf_tail(dce->imsi, len);
-            err = ESP_OK;
-        }
+    } else if (line->type == ESP_MODEM_LINE_INFO && line->len) {
+        snprintf(dce->imsi, MODEM_IMSI_LENGTH + 1, "%.*s", (int)line->len, line->text);
+        err = ESP_OK;
     }
     return err;
 }
 
-static esp_err_t ec21_handle_QCFG(modem_dce_t *dce, const char *line)
+static esp_err_t ec21_handle_QCFG(modem_dce_t *dce, const esp_modem_line_t *line)
 {
     esp_err_t err = ESP_FAIL;
+    ec21_modem_dce_t *ec21_dce = __containerof(dce, ec21_modem_dce_t, parent);
     uint32_t bandval = 0;
     uint32_t ltebandval = 0;
     uint32_t tdsbandval = 0;
 
-    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+    if (line->type == ESP_MODEM_LINE_OK) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
-    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+    } else if (esp_modem_line_is_error(line)) {
        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
-    } else if (!strncmp(line, "+QCFG", strlen("+QCFG"))) {
-       /* +QCFG: �band�,<bandval>,<ltebandval>,<tdsbandval> */
-       if (strstr(line, "band"))
+    } else if (esp_modem_line_has_prefix(line, "+QCFG")) {
+       /* +QCFG: "band",<bandval>,<ltebandval>,<tdsbandval> */
+       esp_modem_fields_t fields;
+       const char *setting;
+       size_t len;
+       esp_modem_fields_init(&fields, line);
+       if (esp_modem_fields_next(&fields, &setting, &len) && len == strlen("band") && !strncmp(setting, "band", len) &&
+           esp_modem_fields_hex(&fields, &bandval) && esp_modem_fields_hex(&fields, &ltebandval))
        {
-
-          char *ptr;
-          ptr = strchr( line, ',' );
-          ptr++;
-
-          sscanf(ptr, "%x,%x,%x", &bandval, &ltebandval, &tdsbandval);
+          esp_modem_fields_hex(&fields, &tdsbandval);
 
           ESP_LOGD(DCE_TAG,"bandval = %x,    ltebandval = %x, tdsbandval = %x\n" , bandval , ltebandval, tdsbandval);
 
-          if ( (ltebandval & BAND7_LTE_MASK) != 0 )
+          const ec21_result_t result = { .band7 = (ltebandval & BAND7_LTE_MASK) != 0 };
+          ec21_set_result(ec21_dce, &result);
+          if ( result.band7 )
           {
-             *(bool*)ec21_dce->priv_resource = true;
              printf("B7 IS ON\n");
           }
           else
           {
-             *(bool*)ec21_dce->priv_resource = false;
              printf("B7 IS OFF\n");
           }
 
           err = ESP_OK;
        }
-       ESP_LOGD(DCE_TAG,"%s",line);
+       ESP_LOGD(DCE_TAG,"%s",line->text);
 
     }
     return err;
 }
 
-static esp_err_t ec21_handle_QNWINFO(modem_dce_t *dce, const char *line)
+static esp_err_t ec21_handle_QNWINFO(modem_dce_t *dce, const esp_modem_line_t *line)
 {
     esp_err_t err = ESP_FAIL;
 
-    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+    if (line->type == ESP_MODEM_LINE_OK) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
-    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+    } else if (esp_modem_line_is_error(line)) {
        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
-    } else if (!strncmp(line, "+QNWINFO", strlen("+QNWINFO"))) {
-       ESP_LOGI(DCE_TAG,"%s",line);
+    } else if (esp_modem_line_has_prefix(line, "+QNWINFO")) {
+       ESP_LOGI(DCE_TAG,"%s",line->text);
        err = ESP_OK;
     }
     return err;
 }
 
-static esp_err_t ec21_handle_CREG(modem_dce_t *dce, const char *line )
+static esp_err_t ec21_handle_CREG(modem_dce_t *dce, const esp_modem_line_t *line )
 {
    esp_err_t err = ESP_FAIL;
    ec21_modem_dce_t *ec21_dce = __containerof(dce, ec21_modem_dce_t, parent);
-   if (strstr(line, MODEM_RESULT_CODE_SUCCESS))
+   if (line->type == ESP_MODEM_LINE_OK)
    {
       err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
    }
-   else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
+   else if (esp_modem_line_is_error(line)) {
       err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
    }
-   else if (!strncmp(line, "+CREG", strlen("+CREG")))
+   else if (esp_modem_line_has_prefix(line, "+CREG"))
    {
-      int32_t n = 0;
-      modem_network_status_t * pStat = (modem_network_status_t *)ec21_dce->priv_resource;
-      sscanf(line, "%*s%d,%d", &n, (uint32_t*)pStat);
+      ec21_registration_t registration;
+      /* +CREG: <n>,<stat>[,"<lac>","<ci>",<AcT>], or the unsolicited +CREG: <stat>[,"<lac>",...] */
+      esp_modem_fields_t fields;
+      const char *params = memchr(line->payload, ',', line->payload_len);
+      esp_modem_fields_init(&fields, line);
+      if (params == NULL || params[1] == '"')
+      {
+         ec21_update_status_cache(ec21_dce, line);
+      }
+      else if (esp_modem_fields_skip(&fields, 1) && ec21_parse_registration(&fields, &registration))
+      {
+         const ec21_result_t result = { .creg = registration.status };
+         ec21_set_result(ec21_dce, &result);
+         ec21_cache_registration(ec21_dce, false, &registration);
+      }
       //printf("CREG resp: %d,%d\n", n, *pStat);
       err = ESP_OK;
    }
@@ -311,23 +729,17 @@ static esp_err_t ec21_handle_CREG(modem_dce_t *dce, const char *line )
 }
 
 
-static esp_err_t ec21_handle_CPIN(modem_dce_t *dce, const char *line )
+static esp_err_t ec21_handle_CPIN(modem_dce_t *dce, const esp_modem_line_t *line )
 {
    esp_err_t err = ESP_FAIL;
 
-   if (strstr(line, MODEM_RESULT_CODE_SUCCESS))
+   if (line->type == ESP_MODEM_LINE_OK)
    {
       err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
    }
-   else if ( !strncmp( line, "+CME ERROR", strlen("+CME ERROR") ) )
+   else if ( line->type == ESP_MODEM_LINE_CME_ERROR )
    {
-      char *ptr;
-      char * pEnd;
-      uint8_t zErrorCode = 0;
-
-      ptr = strchr( line, ':' );
-      ptr++;
-      zErrorCode = strtol(ptr,&pEnd,10);
+      int zErrorCode = line->code;
       ESP_LOGI(__func__, "CME ERROR = %d", zErrorCode);
 
       if ( 10 == zErrorCode )
@@ -341,28 +753,26 @@ static esp_err_t ec21_handle_CPIN(modem_dce_t *dce, const char *line )
 
       err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
    }
-   else if (strstr(line, MODEM_RESULT_CODE_ERROR))
+   else if (esp_modem_line_is_error(line))
    {
       err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
    }
-   else if ( !strncmp( line, "+CPIN", strlen("+CPIN") ) )
+   else if ( esp_modem_line_has_prefix( line, "+CPIN" ) )
    {
-      char *ptr;
-      ptr = strchr( line, ':' );
-      ptr++;
-      if (strstr(ptr, "READY"))
+      if (esp_modem_line_payload_is(line, "READY"))
       {
          dce->simStatus = MODEM_SIM_READY;
+         ec21_update_readiness(__containerof(dce, ec21_modem_dce_t, parent), line);
       }
-      else if (strstr(ptr, "SIM PIN"))
+      else if (esp_modem_line_payload_is(line, "SIM PIN"))
       {
          dce->simStatus = MODEM_SIM_PIN;
       }
-      else if (strstr(ptr, "SIM PUK"))
+      else if (esp_modem_line_payload_is(line, "SIM PUK"))
       {
          dce->simStatus = MODEM_SIM_PUK;
       }
-      else if (strstr(ptr, "NOT INSERTED"))
+      else if (esp_modem_line_payload_is(line, "NOT INSERTED"))
       {
          dce->simStatus = MODEM_SIM_NOT_INSERTED;
       }
@@ -379,46 +789,52 @@ static esp_err_t ec21_handle_CPIN(modem_dce_t *dce, const char *line )
 
 
 /**
- * @brief Handle response from AT+COPS?
+ * @brief Parse the operator name of a +COPS: line
+ *
+ * @param line classified line
+ * @param[out] oper operator name, unchanged while no operator is selected
+ * @param size size of oper
+ * @return ESP_OK if the line is a +COPS: answer
  */
-static esp_err_t ec21_handle_cops(modem_dce_t *dce, const char *line)
+static esp_err_t ec21_parse_cops(const esp_modem_line_t *line, char *oper, size_t size)
 {
     esp_err_t err = ESP_FAIL;
 
-    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
-        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
-    } else if (strstr(line, MODEM_RESULT_CODE_ERROR)) {
-        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
-    } else if (!strncmp(line, "+COPS", strlen("+COPS"))) {
-        /* there might be some random spaces in operator's name, we can not use sscanf to parse the result */
-        /* strtok will break the string, we need to create a copy */
-        size_t len = strlen(line);
-        char *line_copy = malloc(len + 1);
-        strcpy(line_copy, line);
-        /* +COPS: <mode>[, <format>[, <oper>]] */
-        char *str_ptr = NULL;
-        char *p[3];
-        uint8_t i = 0;
-        /* strtok will broke string by replacing delimiter with '\0' */
-        p[i] = strtok_r(line_copy, ",", &str_ptr);
-        while (p[i]) {
-            p[++i] = strtok_r(NULL, ",", &str_ptr);
-        }
-        if (i >= 3)
+    if (esp_modem_line_has_prefix(line, "+COPS")) {
+        /* +COPS: <mode>[,<format>,"<oper>"[,<AcT>]], the operator name may contain spaces and commas */
+        esp_modem_fields_t fields;
+        int32_t mode = 0;
+        esp_modem_fields_init(&fields, line);
+        if (esp_modem_fields_int(&fields, &mode))
         {
-            int len = snprintf(dce->oper, MODEM_MAX_OPERATOR_LENGTH, "%s", p[2]);
-            if (len > 2) {
-                /* Strip "\r\n" */
-                strip_cr_lf_tail(dce->oper, len);
+            if (!esp_modem_fields_skip(&fields, 1))
+            {
+               /*COPS:0 operator still not selected; handle is ok but check the operator len in order to know if the operator is selected*/
+               err = ESP_OK;
+            }
+            else if (esp_modem_fields_str(&fields, oper, size) && oper[0])
+            {
                 err = ESP_OK;
             }
         }
-        else if (i == 1)
-        {
-           /*COPS:0 operator still not selected; handle is ok but check the operator len in order to know if the operator is selected*/
-           err = ESP_OK;
-        }
-        free(line_copy);
+    }
+
+    return err;
+}
+
+/**
+ * @brief Handle response from AT+COPS?
+ */
+static esp_err_t ec21_handle_cops(modem_dce_t *dce, const esp_modem_line_t *line)
+{
+    esp_err_t err = ESP_FAIL;
+
+    if (line->type == ESP_MODEM_LINE_OK) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    } else if (esp_modem_line_is_error(line)) {
+        err = esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    } else {
+        err = ec21_parse_cops(line, dce->oper, MODEM_MAX_OPERATOR_LENGTH);
     }
 
     return err;
@@ -427,58 +843,56 @@ static esp_err_t ec21_handle_cops(modem_dce_t *dce, const char *line)
 /**
  * @brief Handler of the starting unrequested strings
  */
-static esp_err_t ec21_starting_up_handler(modem_dce_t *dce, const char *line)
+static esp_err_t ec21_starting_up_handler(modem_dce_t *dce, const esp_modem_line_t *line)
 {
    esp_err_t err = ESP_FAIL;
 
-   if (strstr(line, "RDY"))
+   ec21_update_readiness(__containerof(dce, ec21_modem_dce_t, parent), line);
+
+   if (esp_modem_line_has_prefix(line, "RDY"))
    {
       err = ESP_OK;
       ESP_LOGI(__func__, "module is ready");
       dce->baudStatus = MODEM_BRS_OK;
    }
-   else if (strstr(line, "+CPIN"))
+   else if (esp_modem_line_has_prefix(line, "+CPIN"))
    {
       err = ec21_handle_CPIN(dce, line );
       dce->baudStatus = MODEM_BRS_OK;
    }
-   else if (!strncmp(line, "+QUSIM", strlen("+QUSIM")))
+   else if (esp_modem_line_has_prefix(line, "+QUSIM"))
    {
       /* QUSIM: 1 == Use USIM card, 0 == use SIM card*/
       /* +QUSIM: <type> */
       err = ESP_OK;
-      char *ptr;
-      char * pEnd;
-      uint8_t zNumber = 0;
-      ptr = strchr( line, ':' );
-      ptr++;
-      zNumber = strtol(ptr,&pEnd,10);
+      esp_modem_fields_t fields;
+      int32_t zNumber = 0;
+      esp_modem_fields_init(&fields, line);
+      esp_modem_fields_int(&fields, &zNumber);
       ESP_LOGI(__func__, "QUSIM type = %d (0 == SIM, 1 == USIM)"  , zNumber);
       dce->baudStatus = MODEM_BRS_OK;
    }
-   else if (!strncmp(line, "+CFUN", strlen("+CFUN")))
+   else if (esp_modem_line_has_prefix(line, "+CFUN"))
    {
       /* CFUN: 0 == min funct, 1 == full funct*/
       /* +CFUN: <fun> */
       err = ESP_OK;
-      char *ptr;
-      char * pEnd;
-      uint8_t zNumber = 0;
-      ptr = strchr( line, ':' );
-      ptr++;
-      zNumber = strtol(ptr,&pEnd,10);
+      esp_modem_fields_t fields;
+      int32_t zNumber = 0;
+      esp_modem_fields_init(&fields, line);
+      esp_modem_fields_int(&fields, &zNumber);
       ESP_LOGI(__func__, "CFUN = %d (0 == min funct, 1 == full funct)"  , zNumber);
       dce->baudStatus = MODEM_BRS_OK;
    }
-   /* used strstr because sometime spaces or new lines arrives before +QIND */
-   else if (strstr(line, "+QIND"))
+   /* the classifier skips the spaces or new lines arriving sometimes before +QIND */
+   else if (esp_modem_line_has_prefix(line, "+QIND"))
    {
       err = ESP_OK;  //SMS DONE   or PB DONE
       dce->baudStatus = MODEM_BRS_OK;
    }
    else
    {
-      ESP_LOGI(__func__, "%s", line);
+      ESP_LOGI(__func__, "%s", line->text);
    }
 
    return err;
@@ -487,14 +901,14 @@ static esp_err_t ec21_starting_up_handler(modem_dce_t *dce, const char *line)
 /**
  * @brief Handle response from AT+QPOWD=X
  */
-static esp_err_t ec21_handle_power_down(modem_dce_t *dce, const char *line)
+static esp_err_t ec21_handle_power_down(modem_dce_t *dce, const esp_modem_line_t *line)
 {
     esp_err_t err = ESP_FAIL;
 
-    printf (line);
-    if (strstr(line, MODEM_RESULT_CODE_SUCCESS)) {
+    printf("%s", line->text);
+    if (line->type == ESP_MODEM_LINE_OK) {
         err = ESP_OK;
-    } else if (strstr(line, MODEM_RESULT_CODE_POWERDOWN)) {
+    } else if (esp_modem_line_has_prefix(line, MODEM_RESULT_CODE_POWERDOWN)) {
         err = esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
     }
     return err;
@@ -514,14 +928,24 @@ static esp_err_t ec21_get_signal_quality(modem_dce_t *dce, uint32_t *rssi, uint3
 {
     modem_dte_t *dte = dce->dte;
     ec21_modem_dce_t *ec21_dce = __containerof(dce, ec21_modem_dce_t, parent);
-    uint32_t *resource[2] = {rssi, ber};
-    ec21_dce->priv_resource = resource;
+    ec21_result_t result;
+    DCE_CHECK(dte->acquire(dte, ESP_MODEM_CMD_PRIORITY_NORMAL, MODEM_ARBITER_TIMEOUT_DEFAULT) == ESP_OK,
+              "command arbiter busy", err_acquire);
+    uint32_t request = ec21_begin_request(ec21_dce);
     dce->handle_line = ec21_handle_csq;
-    DCE_CHECK(dte->send_cmd(dte, "AT+CSQ\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
+    esp_err_t sent = dte->send_cmd(dte, "AT+CSQ\r", MODEM_COMMAND_TIMEOUT_DEFAULT);
+    bool valid = ec21_end_request(ec21_dce, request, &result);
+    DCE_CHECK(sent == ESP_OK, "send command failed", err);
     DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "inquire signal quality failed", err);
+    DCE_CHECK(valid, "no signal quality in the response", err);
+    *rssi = result.csq.rssi;
+    *ber = result.csq.ber;
     ESP_LOGD(DCE_TAG, "inquire signal quality ok");
+    dte->release(dte);
     return ESP_OK;
 err:
+    dte->release(dte);
+err_acquire:
     return ESP_FAIL;
 }
 
@@ -540,14 +964,25 @@ static esp_err_t ec21_get_battery_status(modem_dce_t *dce, uint32_t *bcs, uint32
 {
     modem_dte_t *dte = dce->dte;
     ec21_modem_dce_t *ec21_dce = __containerof(dce, ec21_modem_dce_t, parent);
-    uint32_t *resource[3] = {bcs, bcl, voltage};
-    ec21_dce->priv_resource = resource;
+    ec21_result_t result;
+    DCE_CHECK(dte->acquire(dte, ESP_MODEM_CMD_PRIORITY_NORMAL, MODEM_ARBITER_TIMEOUT_DEFAULT) == ESP_OK,
+              "command arbiter busy", err_acquire);
+    uint32_t request = ec21_begin_request(ec21_dce);
     dce->handle_line = ec21_handle_cbc;
-    DCE_CHECK(dte->send_cmd(dte, "AT+CBC\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
+    esp_err_t sent = dte->send_cmd(dte, "AT+CBC\r", MODEM_COMMAND_TIMEOUT_DEFAULT);
+    bool valid = ec21_end_request(ec21_dce, request, &result);
+    DCE_CHECK(sent == ESP_OK, "send command failed", err);
     DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "inquire battery status failed", err);
+    DCE_CHECK(valid, "no battery status in the response", err);
+    *bcs = result.cbc.bcs;
+    *bcl = result.cbc.bcl;
+    *voltage = result.cbc.voltage;
     ESP_LOGD(DCE_TAG, "inquire battery status ok");
+    dte->release(dte);
     return ESP_OK;
 err:
+    dte->release(dte);
+err_acquire:
     return ESP_FAIL;
 }
 
@@ -565,12 +1000,17 @@ err:
 static esp_err_t ec21_get_sim_status(modem_dce_t *dce)
 {
     modem_dte_t *dte = dce->dte;
+    DCE_CHECK(dte->acquire(dte, ESP_MODEM_CMD_PRIORITY_NORMAL, MODEM_ARBITER_TIMEOUT_DEFAULT) == ESP_OK,
+              "command arbiter busy", err_acquire);
     dce->handle_line = ec21_handle_CPIN;
     DCE_CHECK(dte->send_cmd(dte, "AT+CPIN?\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
     DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "inquire SIM status failed", err);
     ESP_LOGD(DCE_TAG, "inquire SIM status ok");
+    dte->release(dte);
     return ESP_OK;
 err:
+    dte->release(dte);
+err_acquire:
     return ESP_FAIL;
 }
 
@@ -586,8 +1026,24 @@ err:
 static esp_err_t ec21_set_working_mode(modem_dce_t *dce, modem_mode_t mode)
 {
     modem_dte_t *dte = dce->dte;
+    DCE_CHECK(dte->acquire(dte, ESP_MODEM_CMD_PRIORITY_CONTROL, MODEM_ARBITER_TIMEOUT_DEFAULT) == ESP_OK,
+              "command arbiter busy", err_acquire);
     switch (mode) {
     case MODEM_COMMAND_MODE:
+        /* DTR ON->OFF leaves the data mode at once (AT&D set by ec21_configure), no guard time */
+        if (dte->send_dtr_escape) {
+            /* set before the pulse, the result code comes right after it */
+            dce->handle_line = ec21_handle_exit_data_mode;
+            esp_err_t err = dte->send_dtr_escape(dte, EC21_DTR_PULSE_MS, EC21_DTR_ESCAPE_TIMEOUT_MS);
+            if (err == ESP_OK && dce->state == MODEM_STATE_SUCCESS) {
+                ESP_LOGI(DCE_TAG, "enter command mode ok (DTR)");
+                dce->mode = MODEM_COMMAND_MODE;
+                break;
+            }
+            if (err != ESP_ERR_NOT_SUPPORTED) {
+                ESP_LOGW(DCE_TAG, "no answer to DTR, fall back to \"+++\"");
+            }
+        }
         dce->handle_line = ec21_handle_exit_data_mode;
         vTaskDelay(pdMS_TO_TICKS(1000));
         if (dte->send_cmd(dte, "+++", MODEM_COMMAND_TIMEOUT_MODE_CHANGE) != ESP_OK) {
@@ -623,9 +1079,12 @@ static esp_err_t ec21_set_working_mode(modem_dce_t *dce, modem_mode_t mode)
         break;
 
     }
+    dte->release(dte);
     return ESP_OK;
 err:
     //dte->send_data_lock = false;
+    dte->release(dte);
+err_acquire:
     return ESP_FAIL;
 }
 
@@ -640,13 +1099,19 @@ err:
 static esp_err_t ec21_set_urc_port( ec21_modem_dce_t *ec21_dce )
 {
    modem_dte_t *dte = ec21_dce->parent.dte;
+   DCE_CHECK(dte->acquire(dte, ESP_MODEM_CMD_PRIORITY_NORMAL, MODEM_ARBITER_TIMEOUT_DEFAULT) == ESP_OK,
+             "command arbiter busy", err_acquire);
    ec21_dce->parent.handle_line = ec21_handle_default;
 
    DCE_CHECK( dte->send_cmd(dte, "AT+QURCCFG=\"urcport\",\"uart1\"\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err );
    ESP_LOGD( DCE_TAG, "Set urc port ok" );
 
+   dte->release(dte);
    return ESP_OK;
-   err: return ESP_FAIL;
+   err:
+   dte->release(dte);
+   err_acquire:
+   return ESP_FAIL;
 }
 
 
@@ -661,14 +1126,52 @@ static esp_err_t ec21_set_dtr_mode( ec21_modem_dce_t *ec21_dce, ec21_dtrMode_t d
 {
    modem_dte_t *dte = ec21_dce->parent.dte;
    char command[16];
+   DCE_CHECK(dte->acquire(dte, ESP_MODEM_CMD_PRIORITY_NORMAL, MODEM_ARBITER_TIMEOUT_DEFAULT) == ESP_OK,
+             "command arbiter busy", err_acquire);
    int len = snprintf(command, sizeof(command), "AT&D%d\r", dtrMode);
    DCE_CHECK(len < sizeof(command), "command too long: %s", err, command);
    ec21_dce->parent.handle_line = ec21_handle_default;
    DCE_CHECK( dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_DEFAULT ) == ESP_OK, "send command failed", err );
    ESP_LOGD( DCE_TAG, "Set DTR mode ok" );
 
+   dte->release(dte);
+   return ESP_OK;
+   err:
+   dte->release(dte);
+   err_acquire:
+   return ESP_FAIL;
+}
+
+/**
+ * @brief Enable the unsolicited network status reports feeding the status cache
+ *
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t ec21_enable_status_reports( ec21_modem_dce_t *ec21_dce )
+{
+   modem_dte_t *dte = ec21_dce->parent.dte;
+   static const char *const commands[] = {
+      "AT+CREG=2\r",               /* +CREG: <stat>,"<lac>","<ci>",<AcT> */
+      "AT+CEREG=2\r",              /* +CEREG: <stat>,"<tac>","<ci>",<AcT> */
+      "AT+QINDCFG=\"csq\",1\r",    /* +QIND: "csq",<rssi>,<ber> */
+   };
+   DCE_CHECK(dte->acquire(dte, ESP_MODEM_CMD_PRIORITY_NORMAL, MODEM_ARBITER_TIMEOUT_DEFAULT) == ESP_OK,
+             "command arbiter busy", err_acquire);
+   for (int i = 0; i < sizeof(commands) / sizeof(commands[0]); i++)
+   {
+      ec21_dce->parent.handle_line = ec21_handle_default;
+      DCE_CHECK(dte->send_cmd(dte, commands[i], MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
+      DCE_CHECK(ec21_dce->parent.state == MODEM_STATE_SUCCESS, "%s failed", err, commands[i]);
+   }
+   ESP_LOGD(DCE_TAG, "Enable status reports ok");
+   dte->release(dte);
    return ESP_OK;
-   err: return ESP_FAIL;
+err:
+   dte->release(dte);
+err_acquire:
+   return ESP_FAIL;
 }
 
 /**
@@ -683,28 +1186,38 @@ static esp_err_t ec21_set_dtr_mode( ec21_modem_dce_t *ec21_dce, ec21_dtrMode_t d
 static esp_err_t ec21_enable_fast_shutdown( ec21_modem_dce_t *ec21_dce )
 {
     modem_dte_t *dte = ec21_dce->parent.dte;
+    DCE_CHECK(dte->acquire(dte, ESP_MODEM_CMD_PRIORITY_NORMAL, MODEM_ARBITER_TIMEOUT_DEFAULT) == ESP_OK,
+              "command arbiter busy", err_acquire);
     ec21_dce->parent.handle_line = ec21_handle_default;
 
     DCE_CHECK(dte->send_cmd(dte, "AT+QCFG=\"fast/poweroff\",1\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
     DCE_CHECK(ec21_dce->parent.state == MODEM_STATE_SUCCESS, "enable_fast_shutdown failed", err);
     ESP_LOGI(DCE_TAG, "Set fast poweroff ok");
 
+    dte->release(dte);
     return ESP_OK;
 err:
+    dte->release(dte);
+err_acquire:
     return ESP_FAIL;
 }
 
 static esp_err_t ec21_get_fast_shutdown_state( ec21_modem_dce_t *ec21_dce )
 {
     modem_dte_t *dte = ec21_dce->parent.dte;
+    DCE_CHECK(dte->acquire(dte, ESP_MODEM_CMD_PRIORITY_NORMAL, MODEM_ARBITER_TIMEOUT_DEFAULT) == ESP_OK,
+              "command arbiter busy", err_acquire);
     ec21_dce->parent.handle_line = ec21_handle_default;
 
     DCE_CHECK(dte->send_cmd(dte, "AT+QCFG=\"fast/poweroff\"\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
     DCE_CHECK(ec21_dce->parent.state == MODEM_STATE_SUCCESS, "ec21_get_fast_shutdown_state failed", err);
     ESP_LOGD(DCE_TAG, "Set fast poweroff ok");
 
+    dte->release(dte);
     return ESP_OK;
 err:
+    dte->release(dte);
+err_acquire:
     return ESP_FAIL;
 }
 
@@ -719,18 +1232,27 @@ err:
 static esp_err_t ec21_power_down(modem_dce_t *dce)
 {
     modem_dte_t *dte = dce->dte;
+    DCE_CHECK(dte->acquire(dte, ESP_MODEM_CMD_PRIORITY_CONTROL, MODEM_ARBITER_TIMEOUT_DEFAULT) == ESP_OK,
+              "command arbiter busy", err_acquire);
     dce->handle_line = ec21_handle_power_down;
     DCE_CHECK(dte->send_cmd(dte, "AT+QPOWD=1\r", MODEM_COMMAND_TIMEOUT_POWEROFF) == ESP_OK, "send command failed", err);
     DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "power down failed", err);
     ESP_LOGD(DCE_TAG, "power down ok");
+    dte->release(dte);
     return ESP_OK;
 err:
+    dte->release(dte);
+err_acquire:
     return ESP_FAIL;
 }
 
 /**
  * @brief Power down fast for emergency (supply fail)
  *
+ * Preempts the transaction in progress, e.g. an AT+COPS? waiting for up to MODEM_COMMAND_TIMEOUT_OPERATOR:
+ * AT+QPOWD=0 is sent within MODEM_ARBITER_TIMEOUT_EMERGENCY. A late result code of the aborted command
+ * may still come before the answer to AT+QPOWD=0.
+ *
  * @param ec21_dce ec21 object
  * @return esp_err_t
  *      - ESP_OK on success
@@ -739,12 +1261,17 @@ err:
 static esp_err_t ec21_power_down_fast(modem_dce_t *dce)
 {
     modem_dte_t *dte = dce->dte;
+    DCE_CHECK(dte->acquire(dte, ESP_MODEM_CMD_PRIORITY_EMERGENCY, MODEM_ARBITER_TIMEOUT_EMERGENCY) == ESP_OK,
+              "command arbiter busy", err_acquire);
     dce->handle_line = ec21_handle_power_down;
     DCE_CHECK(dte->send_cmd(dte, "AT+QPOWD=0\r", MODEM_COMMAND_TIMEOUT_FAST_POWEROFF) == ESP_OK, "send command failed", err);
     DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "fast power down failed", err);
     ESP_LOGD(DCE_TAG, "power down ok");
+    dte->release(dte);
     return ESP_OK;
 err:
+    dte->release(dte);
+err_acquire:
     return ESP_FAIL;
 }
 
@@ -760,12 +1287,17 @@ err:
 static esp_err_t ec21_get_module_name(ec21_modem_dce_t *ec21_dce)
 {
     modem_dte_t *dte = ec21_dce->parent.dte;
+    DCE_CHECK(dte->acquire(dte, ESP_MODEM_CMD_PRIORITY_NORMAL, MODEM_ARBITER_TIMEOUT_DEFAULT) == ESP_OK,
+              "command arbiter busy", err_acquire);
     ec21_dce->parent.handle_line = ec21_handle_cgmm;
     DCE_CHECK(dte->send_cmd(dte, "AT+CGMM\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
     DCE_CHECK(ec21_dce->parent.state == MODEM_STATE_SUCCESS, "get module name failed", err);
     ESP_LOGD(DCE_TAG, "get module name ok");
+    dte->release(dte);
     return ESP_OK;
 err:
+    dte->release(dte);
+err_acquire:
     return ESP_FAIL;
 }
 
@@ -773,39 +1305,59 @@ err:
 static esp_err_t enable_roaming(ec21_modem_dce_t *ec21_dce)
 {
     modem_dte_t *dte = ec21_dce->parent.dte;
+    DCE_CHECK(dte->acquire(dte, ESP_MODEM_CMD_PRIORITY_NORMAL, MODEM_ARBITER_TIMEOUT_DEFAULT) == ESP_OK,
+              "command arbiter busy", err_acquire);
     ec21_dce->parent.handle_line = ec21_handle_default;
     /* using AUTo configuration for enabled setting: seems work better with some operators*/
     DCE_CHECK(dte->send_cmd(dte, "AT+QCFG=\"roamservice\",255,1\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
     DCE_CHECK(ec21_dce->parent.state == MODEM_STATE_SUCCESS, "roaming enable failed", err);
     ESP_LOGI(DCE_TAG, "roaming enabled");
+    dte->release(dte);
     return ESP_OK;
 err:
+    dte->release(dte);
+err_acquire:
     return ESP_FAIL;
 }
 
 static esp_err_t disable_roaming(ec21_modem_dce_t *ec21_dce)
 {
     modem_dte_t *dte = ec21_dce->parent.dte;
+    DCE_CHECK(dte->acquire(dte, ESP_MODEM_CMD_PRIORITY_NORMAL, MODEM_ARBITER_TIMEOUT_DEFAULT) == ESP_OK,
+              "command arbiter busy", err_acquire);
     ec21_dce->parent.handle_line = ec21_handle_default;
     DCE_CHECK(dte->send_cmd(dte, "AT+QCFG=\"roamservice\",1,1\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
     DCE_CHECK(ec21_dce->parent.state == MODEM_STATE_SUCCESS, "roaming disable failed", err);
     ESP_LOGI(DCE_TAG, "roaming disabled");
+    dte->release(dte);
     return ESP_OK;
 err:
+    dte->release(dte);
+err_acquire:
     return ESP_FAIL;
 }
 
 static esp_err_t get_band7_configuration(ec21_modem_dce_t *ec21_dce, bool *isEnabled)
 {
    modem_dte_t *dte = ec21_dce->parent.dte;
+   ec21_result_t result;
+   DCE_CHECK(dte->acquire(dte, ESP_MODEM_CMD_PRIORITY_NORMAL, MODEM_ARBITER_TIMEOUT_DEFAULT) == ESP_OK,
+             "command arbiter busy", err_acquire);
+   uint32_t request = ec21_begin_request(ec21_dce);
    ec21_dce->parent.handle_line = ec21_handle_QCFG;
-   ec21_dce->priv_resource = isEnabled;
 
-   DCE_CHECK(dte->send_cmd(dte, "AT+QCFG=\"band\"\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
+   esp_err_t sent = dte->send_cmd(dte, "AT+QCFG=\"band\"\r", MODEM_COMMAND_TIMEOUT_DEFAULT);
+   bool valid = ec21_end_request(ec21_dce, request, &result);
+   DCE_CHECK(sent == ESP_OK, "send command failed", err);
    DCE_CHECK(ec21_dce->parent.state == MODEM_STATE_SUCCESS, "get band state failed", err);
+   DCE_CHECK(valid, "no band configuration in the response", err);
+   *isEnabled = result.band7;
 
+   dte->release(dte);
    return ESP_OK;
 err:
+   dte->release(dte);
+err_acquire:
    return ESP_FAIL;
 }
 
@@ -813,12 +1365,23 @@ static esp_err_t get_network_status(modem_dce_t *dce, modem_network_status_t *st
 {
     modem_dte_t *dte = dce->dte;
     ec21_modem_dce_t *ec21_dce = __containerof(dce, ec21_modem_dce_t, parent);
-    ec21_dce->priv_resource = status;
+    ec21_result_t result;
+    DCE_CHECK(dte->acquire(dte, ESP_MODEM_CMD_PRIORITY_NORMAL, MODEM_ARBITER_TIMEOUT_DEFAULT) == ESP_OK,
+              "command arbiter busy", err_acquire);
+    uint32_t request = ec21_begin_request(ec21_dce);
     ec21_dce->parent.handle_line = ec21_handle_CREG;
-    DCE_CHECK(dte->send_cmd(dte, "AT+CREG?\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
+    esp_err_t sent = dte->send_cmd(dte, "AT+CREG?\r", MODEM_COMMAND_TIMEOUT_DEFAULT);
+    bool valid = ec21_end_request(ec21_dce, request, &result);
+    DCE_CHECK(sent == ESP_OK, "send command failed", err);
     DCE_CHECK(ec21_dce->parent.state == MODEM_STATE_SUCCESS, "read network state failed", err);
+    if (valid) {
+        *status = result.creg;
+    }
+    dte->release(dte);
     return ESP_OK;
 err:
+    dte->release(dte);
+err_acquire:
     return ESP_FAIL;
 }
 
@@ -841,12 +1404,17 @@ err:
 static esp_err_t ec21_get_imei_number(ec21_modem_dce_t *ec21_dce)
 {
     modem_dte_t *dte = ec21_dce->parent.dte;
+    DCE_CHECK(dte->acquire(dte, ESP_MODEM_CMD_PRIORITY_NORMAL, MODEM_ARBITER_TIMEOUT_DEFAULT) == ESP_OK,
+              "command arbiter busy", err_acquire);
     ec21_dce->parent.handle_line = ec21_handle_cgsn;
     DCE_CHECK(dte->send_cmd(dte, "AT+CGSN\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
     DCE_CHECK(ec21_dce->parent.state == MODEM_STATE_SUCCESS, "get imei number failed", err);
     ESP_LOGD(DCE_TAG, "get imei number ok");
+    dte->release(dte);
     return ESP_OK;
 err:
+    dte->release(dte);
+err_acquire:
     return ESP_FAIL;
 }
 
@@ -861,12 +1429,49 @@ err:
 static esp_err_t ec21_get_imsi_number(ec21_modem_dce_t *ec21_dce)
 {
     modem_dte_t *dte = ec21_dce->parent.dte;
+    DCE_CHECK(dte->acquire(dte, ESP_MODEM_CMD_PRIORITY_NORMAL, MODEM_ARBITER_TIMEOUT_DEFAULT) == ESP_OK,
+              "command arbiter busy", err_acquire);
     ec21_dce->parent.handle_line = ec21_handle_cimi;
     DCE_CHECK(dte->send_cmd(dte, "AT+CIMI\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
     DCE_CHECK(ec21_dce->parent.state == MODEM_STATE_SUCCESS, "get imsi number failed", err);
     ESP_LOGD(DCE_TAG, "get imsi number ok");
+    dte->release(dte);
+    return ESP_OK;
+err:
+    dte->release(dte);
+err_acquire:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Get the ICCID of the SIM
+ *
+ * @param ec21_dce ec21 object
+ * @param[out] iccid ICCID, EC21_ICCID_LENGTH + 1 bytes
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t ec21_get_iccid(ec21_modem_dce_t *ec21_dce, char *iccid)
+{
+    modem_dte_t *dte = ec21_dce->parent.dte;
+    ec21_result_t result;
+    DCE_CHECK(dte->acquire(dte, ESP_MODEM_CMD_PRIORITY_NORMAL, MODEM_ARBITER_TIMEOUT_DEFAULT) == ESP_OK,
+              "command arbiter busy", err_acquire);
+    uint32_t request = ec21_begin_request(ec21_dce);
+    ec21_dce->parent.handle_line = ec21_handle_qccid;
+    esp_err_t sent = dte->send_cmd(dte, "AT+QCCID\r", MODEM_COMMAND_TIMEOUT_DEFAULT);
+    bool valid = ec21_end_request(ec21_dce, request, &result);
+    DCE_CHECK(sent == ESP_OK, "send command failed", err);
+    DCE_CHECK(ec21_dce->parent.state == MODEM_STATE_SUCCESS, "get iccid failed", err);
+    DCE_CHECK(valid, "no iccid in the response", err);
+    memcpy(iccid, result.iccid, sizeof(result.iccid));
+    ESP_LOGD(DCE_TAG, "get iccid ok");
+    dte->release(dte);
     return ESP_OK;
 err:
+    dte->release(dte);
+err_acquire:
     return ESP_FAIL;
 }
 
@@ -881,28 +1486,20 @@ err:
 static esp_err_t ec21_get_operator_name(ec21_modem_dce_t *ec21_dce)
 {
     modem_dte_t *dte = ec21_dce->parent.dte;
+    DCE_CHECK(dte->acquire(dte, ESP_MODEM_CMD_PRIORITY_NORMAL, MODEM_ARBITER_TIMEOUT_DEFAULT) == ESP_OK,
+              "command arbiter busy", err_acquire);
     ec21_dce->parent.handle_line = ec21_handle_cops;
     ec21_dce->parent.state = MODEM_STATE_FAIL;
     DCE_CHECK(dte->send_cmd(dte, "AT+COPS?\r", MODEM_COMMAND_TIMEOUT_OPERATOR) == ESP_OK, "send command failed", err);
     DCE_CHECK(ec21_dce->parent.state == MODEM_STATE_SUCCESS, "get network operator failed", err);
+    dte->release(dte);
     return ESP_OK;
 err:
+    dte->release(dte);
+err_acquire:
     return ESP_FAIL;
 }
 
-/* command not managed because the response is longer than the uart HW FIFO buffer*/
-//static esp_err_t ec21_get_op_list(ec21_modem_dce_t *ec21_dce)
-//{
-//    modem_dte_t *dte = ec21_dce->parent.dte;
-//    ec21_dce->parent.handle_line = ec21_handle_cops;
-//    DCE_CHECK(dte->send_cmd(dte, "AT+COPS=?\r", MODEM_COMMAND_TIMEOUT_OPERATOR) == ESP_OK, "send command failed", err);
-//    DCE_CHECK(ec21_dce->parent.state == MODEM_STATE_SUCCESS, "Get list of operator failed", err);
-//    ESP_LOGI(DCE_TAG, "get op list operator ok");
-//    return ESP_OK;
-//err:
-//    return ESP_FAIL;
-//}
-
 /**
  * @brief Deinitialize EC21 object
  *
@@ -915,18 +1512,151 @@ static esp_err_t ec21_deinit(modem_dce_t *dce)
 {
     ec21_modem_dce_t *ec21_dce = __containerof(dce, ec21_modem_dce_t, parent);
     if (dce->dte) {
+        esp_modem_remove_urc_handler(dce->dte, NULL, ec21_on_urc);
         dce->dte->dce = NULL;
     }
-    free(ec21_dce);
+    vEventGroupDelete(ec21_dce->readiness);
+    esp_modem_arena_free(ec21_dce->arena, ec21_dce);
     return ESP_OK;
 }
 
-modem_dce_t *ec21_init(modem_dte_t *dte)
-{
+/**
+ * @brief Find the baud rate the module is at, the factory default first then every supported rate
+ *
+ * @param ec21_dce ec21 object
+ * @param[out] baudrate rate the module answered at, the DTE is left at this rate
+ */
+static esp_err_t ec21_find_baudrate(ec21_modem_dce_t *ec21_dce, uint32_t *baudrate)
+{
+   modem_dte_t *dte = ec21_dce->parent.dte;
+   for (int i = -1; i < (int)(sizeof(s_ec21_baudrates) / sizeof(s_ec21_baudrates[0])); i++)
+   {
+      uint32_t rate = i < 0 ? EC21_DEFAULT_BAUDRATE : s_ec21_baudrates[i];
+      if (i >= 0 && rate == EC21_DEFAULT_BAUDRATE)
+      {
+         continue;
+      }
+      DCE_CHECK(dte->change_dte_baudrate(dte, rate) == ESP_OK, "set DTE baud rate failed", err);
+      if (ec21_probe(ec21_dce, EC21_AUTOBAUD_PROBE_TIMEOUT_MS) == ESP_OK)
+      {
+         ESP_LOGI(DCE_TAG, "module found at %u baud", rate);
+         *baudrate = rate;
+         return ESP_OK;
+      }
+   }
+err:
+   return ESP_FAIL;
+}
+
+/**
+ * @brief Check the link at the current baud rate: ATI round trips without garbled byte nor UART error
+ */
+static bool ec21_check_baudrate(ec21_modem_dce_t *ec21_dce)
+{
+   modem_dte_t *dte = ec21_dce->parent.dte;
+   esp_modem_dte_stats_t before, after;
+   bool garbled = false;
+   if (dte->acquire(dte, ESP_MODEM_CMD_PRIORITY_NORMAL, MODEM_ARBITER_TIMEOUT_DEFAULT) != ESP_OK)
+   {
+      return false;
+   }
+   esp_modem_get_stats(dte, &before);
+   for (int i = 0; i < EC21_BAUDRATE_CHECK_ROUNDS && !garbled; i++)
+   {
+      ec21_result_t result;
+      uint32_t request = ec21_begin_request(ec21_dce);
+      ec21_dce->parent.handle_line = ec21_handle_ati;
+      esp_err_t sent = dte->send_cmd(dte, "ATI\r", MODEM_COMMAND_TIMEOUT_DEFAULT);
+      if (ec21_end_request(ec21_dce, request, &result) || sent != ESP_OK ||
+          ec21_dce->parent.state != MODEM_STATE_SUCCESS)
+      {
+         /* the only value set by the ATI handler is garbled */
+         garbled = true;
+      }
+   }
+   esp_modem_get_stats(dte, &after);
+   dte->release(dte);
+   return !garbled && after.rx_frame_errors == before.rx_frame_errors &&
+          after.rx_parity_errors == before.rx_parity_errors && after.rx_fifo_overflows == before.rx_fifo_overflows;
+}
+
+/**
+ * @brief Load the module identity cached in NVS, if any
+ */
+static void ec21_load_identity(void)
+{
+   nvs_handle_t handle;
+   size_t len = sizeof(ec21_identity_t);
+
+   gIdentityCacheValid = false;
+   if ( nvs_open( EC21_NVS_NAMESPACE, NVS_READONLY, &handle ) != ESP_OK )
+   {
+      /* nothing stored yet */
+      return;
+   }
+   gIdentityCacheValid = ( nvs_get_blob( handle, EC21_NVS_IDENTITY_KEY, &gIdentityCache, &len ) == ESP_OK ) &&
+                         ( len == sizeof(ec21_identity_t) );
+   nvs_close( handle );
+}
+
+/**
+ * @brief Step up to the highest supported baud rate up to EC21_WORKING_BAUDRATE which passes ec21_check_baudrate()
+ *
+ * A rate failing the check is left for the next lower one; the module is asked back to the last good rate,
+ * or searched again if it does not answer anymore.
+ *
+ * @param ec21_dce ec21 object
+ * @param[in,out] baudrate current rate of the module and the DTE, updated to the negotiated one
+ */
+static esp_err_t ec21_negotiate_baudrate(ec21_modem_dce_t *ec21_dce, uint32_t *baudrate)
+{
+   modem_dce_t *dce = &ec21_dce->parent;
+   for (int i = 0; i < sizeof(s_ec21_baudrates) / sizeof(s_ec21_baudrates[0]) && s_ec21_baudrates[i] > *baudrate; i++)
+   {
+      uint32_t rate = s_ec21_baudrates[i];
+      if (rate > EC21_WORKING_BAUDRATE || esp_modem_dce_set_baud_rate(dce, rate) != ESP_OK)
+      {
+         continue;
+      }
+      /* the module switches right after OK: probe at the new rate */
+      gStartupReport.legacy_sleep_ms += 600;
+      DCE_CHECK(dce->dte->change_dte_baudrate(dce->dte, rate) == ESP_OK, "set DTE baud rate failed", err);
+      if (ec21_probe(ec21_dce, EC21_PROBE_TIMEOUT_MS) == ESP_OK && ec21_check_baudrate(ec21_dce))
+      {
+         *baudrate = rate;
+         return ESP_OK;
+      }
+      ESP_LOGW(DCE_TAG, "%u baud not stable, stepping down", rate);
+      /* may get through on a marginal link */
+      esp_modem_dce_set_baud_rate(dce, *baudrate);
+      DCE_CHECK(dce->dte->change_dte_baudrate(dce->dte, *baudrate) == ESP_OK, "set DTE baud rate failed", err);
+      if (ec21_probe(ec21_dce, EC21_PROBE_TIMEOUT_MS) != ESP_OK)
+      {
+         DCE_CHECK(ec21_find_baudrate(ec21_dce, baudrate) == ESP_OK, "module lost", err);
+      }
+   }
+   return ESP_OK;
+err:
+   return ESP_FAIL;
+}
+
+modem_dce_t *ec21_init(modem_dte_t *dte)
+{
     DCE_CHECK(dte, "DCE should bind with a DTE", err);
-    /* malloc memory for ec21_dce object */
-    ec21_dce = calloc(1, sizeof(ec21_modem_dce_t));
+    /* malloc memory for ec21_dce object, from the arena of the DTE in the static configuration */
+    esp_modem_arena_t *arena = esp_modem_dte_get_arena(dte);
+    ec21_dce = esp_modem_arena_calloc(arena, sizeof(ec21_modem_dce_t));
     DCE_CHECK(ec21_dce, "calloc ec21_dce failed", err);
+    ec21_dce->arena = arena;
+    portMUX_INITIALIZE(&ec21_dce->cache_lock);
+    portMUX_INITIALIZE(&ec21_dce->identity_lock);
+    portMUX_INITIALIZE(&ec21_dce->result_lock);
+    ec21_dce->readiness = xEventGroupCreate();
+    DCE_CHECK(ec21_dce->readiness, "create readiness event group failed", err_readiness);
+    for (int i = 0; i < sizeof(ec21_urc_prefixes) / sizeof(ec21_urc_prefixes[0]); i++) {
+        DCE_CHECK(esp_modem_add_urc_handler(dte, ec21_urc_prefixes[i], ec21_on_urc, ec21_dce) == ESP_OK,
+                  "register urc handler failed", err_handler);
+    }
     /* Bind DTE with DCE */
     ec21_dce->parent.dte = dte;
     dte->dce = &(ec21_dce->parent);
@@ -949,8 +1679,17 @@ modem_dce_t *ec21_init(modem_dte_t *dte)
     ec21_dce->parent.baudStatus = MODEM_BRS_UNKNOWN;
 
     gpDrvNvs_baudrate = DrvNvs_GetElement( DRVNVS_FACTORY_PARAMS_ID, DRVNVS_F_LTE_BAUDRATE_ID );
+    ec21_load_identity();
 
+    esp_modem_timeline_mark(ESP_MODEM_MILESTONE_DCE_INIT);
     return &(ec21_dce->parent);
+err_handler:
+    esp_modem_remove_urc_handler(dte, NULL, ec21_on_urc);
+    vEventGroupDelete(ec21_dce->readiness);
+err_readiness:
+    dte->dce = NULL;
+    esp_modem_arena_free(arena, ec21_dce);
+    ec21_dce = NULL;
 err:
     return NULL;
 }
@@ -959,88 +1698,117 @@ err:
 
 esp_err_t ec21_configure( modem_dce_t * dce )
 {
-   uint32_t enableFastShutdownretry = 0;
+   ec21_startup_report_t *report = &gStartupReport;
+   int64_t start = esp_timer_get_time();
+   int64_t fastShutdownStart;
+   bool synced = false;
 
-   /* Sync between DTE and DCE */
-   for (uint32_t sincretry = 0; sincretry < 3; sincretry++)
+   DCE_CHECK( ec21_dce, "ec21_dce not intialized", err_io );
+   memset( report, 0, sizeof( *report ) );
+   esp_modem_timeline_mark( ESP_MODEM_MILESTONE_CONFIGURE_START );
+
+   /* Sync between DTE and DCE at the stored baud rate */
+   report->baudrate = *(uint32_t*)gpDrvNvs_baudrate->handler;
+   for (uint32_t sincretry = 0; sincretry < 3 && !synced; sincretry++)
    {
       ESP_LOGI( DCE_TAG, "esp_modem_dce_sync" );
-      if ( esp_modem_dce_sync(dce) == ESP_OK )
+      synced = ( esp_modem_dce_sync(dce) == ESP_OK );
+      if ( !synced )
       {
-         break;
+         /* the module answers once it has booted */
+         report->legacy_sleep_ms += 500;
+         ec21_wait_ready( ec21_dce, EC21_READY_RDY, EC21_SYNC_RETRY_WAIT_MS );
       }
-      vTaskDelay( pdMS_TO_TICKS( 500 ) );
    }
-   vTaskDelay( pdMS_TO_TICKS( 300 ) );
+   /* no answer or no stored rate: NVS and module disagree, find the module */
+   if ( !synced || report->baudrate == 0 )
+   {
+      DCE_CHECK( ec21_find_baudrate( ec21_dce, &report->baudrate ) == ESP_OK, "module not answering at any baud rate", err_io );
+   }
+   esp_modem_timeline_mark( ESP_MODEM_MILESTONE_SYNC );
+   report->legacy_sleep_ms += 300;
    ESP_LOGI( DCE_TAG, "esp_modem_dce_factory_reset" );
    DCE_CHECK( esp_modem_dce_factory_reset(dce) == ESP_OK, "factory reset failed", err_io );
 
-   vTaskDelay( pdMS_TO_TICKS( 300 ) );
+   /* the module answered OK to AT&F: go on as soon as it answers again */
+   report->legacy_sleep_ms += 300;
+   DCE_CHECK( ec21_probe( ec21_dce, EC21_PROBE_TIMEOUT_MS ) == ESP_OK, "no answer after factory reset", err_io );
+   esp_modem_timeline_mark( ESP_MODEM_MILESTONE_FACTORY_RESET );
 
    /* Close echo */
    ESP_LOGI( DCE_TAG, "esp_modem_dce_echo" );
    DCE_CHECK( esp_modem_dce_echo(dce, false) == ESP_OK, "close echo mode failed", err_io );
+   esp_modem_timeline_mark( ESP_MODEM_MILESTONE_ECHO_OFF );
 
 
-   static const uint32_t baudrate = EC21_WORKING_BAUDRATE;
+   /* step up to the highest stable baud rate */
+   DCE_CHECK( ec21_negotiate_baudrate( ec21_dce, &report->baudrate ) == ESP_OK, "baud rate negotiation failed", err_io );
 
-   /* the LTE module is still the default 115200, change it! */
-   if ( baudrate != *(uint32_t*)gpDrvNvs_baudrate->handler )
+   /* keep it for the next boot, in the module profile and in NVS */
+   if ( report->baudrate != *(uint32_t*)gpDrvNvs_baudrate->handler )
    {
-      ESP_LOGI( DCE_TAG, "SETBAUDRATE: %d, in NVS found: %d", baudrate, *(uint32_t*)gpDrvNvs_baudrate->handler );
-      DCE_CHECK( esp_modem_dce_set_baud_rate(dce, baudrate) == ESP_OK, "set DCE baud rate failed", err_io );
-
-      vTaskDelay( pdMS_TO_TICKS( 300 ) );
-
-      DCE_CHECK( dce->dte->change_dte_baudrate( dce->dte, baudrate )== ESP_OK, "set DTE baud rate failed", err_io );
-
-      vTaskDelay( pdMS_TO_TICKS( 300 ) );
-
+      ESP_LOGI( DCE_TAG, "SETBAUDRATE: %d, in NVS found: %d", report->baudrate, *(uint32_t*)gpDrvNvs_baudrate->handler );
       DCE_CHECK( esp_modem_dce_store_profile(dce) == ESP_OK, "store profile failed", err_io );
 
-      DrvNvs_SetElement( DRVNVS_FACTORY_PARAMS_ID, DRVNVS_F_LTE_BAUDRATE_ID, &baudrate );
+      DrvNvs_SetElement( DRVNVS_FACTORY_PARAMS_ID, DRVNVS_F_LTE_BAUDRATE_ID, &report->baudrate );
    }
+   esp_modem_timeline_mark( ESP_MODEM_MILESTONE_BAUDRATE );
 
-   DCE_CHECK( ec21_dce, "ec21_dce not intialized", err_io );
-
-   /*get sim status */
-   vTaskDelay( pdMS_TO_TICKS( 300 ) );
+   /*get sim status: +CPIN: READY is usually reported by now, otherwise the query tells the SIM state */
+   report->legacy_sleep_ms += 300;
+   ec21_wait_ready( ec21_dce, EC21_READY_SIM, EC21_SIM_READY_WAIT_MS );
    ESP_LOGI( DCE_TAG, "ec21_get_sim_status" );
    DCE_CHECK( ec21_get_sim_status(dce) == ESP_OK, "get SIM status failed", err_io );
+   esp_modem_timeline_mark( ESP_MODEM_MILESTONE_SIM_STATUS );
 
    /* set urc port */
-  // vTaskDelay( pdMS_TO_TICKS( 300 ) );
   // ESP_LOGI( DCE_TAG, "ec21_set_urc_port" );
   // DCE_CHECK( ec21_set_urc_port(ec21_dce) == ESP_OK, "set URC port failed", err_io );
 
 #if AUTO_ANSWER_CMC_TEST == 1
-   vTaskDelay( pdMS_TO_TICKS( 300 ) );
    ESP_LOGI( DCE_TAG, "ec21_setup_auto_answer after 1 ring" );
    DCE_CHECK( esp_modem_dce_set_auto_answer(dce, 1) == ESP_OK, "set up auto answer failed", err_io );
 #endif
 
    /* set DTR mode */
-   vTaskDelay( pdMS_TO_TICKS( 300 ) );
+   report->legacy_sleep_ms += 300;
    ESP_LOGI( DCE_TAG, "ec21_set_dtr_mode" );
    DCE_CHECK( ec21_set_dtr_mode(ec21_dce, EC21_DTR_CMD_MODE_AND_DISCONNECT) == ESP_OK, "set DTR behavior failed", err_io );
+   esp_modem_timeline_mark( ESP_MODEM_MILESTONE_DTR_MODE );
 
-   /* Enable fast shutdown */
-   vTaskDelay( pdMS_TO_TICKS( 1000 ) );
-
-   ESP_LOGI( DCE_TAG, "ec21_enable_fast_shutdown" );
-   /* perform some retries because if this command is sent to early after a modem reboot fails with ERROR*/
-   while ( ( ec21_enable_fast_shutdown(ec21_dce) != ESP_OK ) &&
-           ( enableFastShutdownretry <= ENABLE_FAST_SHUTDOWN_MAX_RETRY ) )
+   /* keep the network status cache up to date, see ec21_get_cached_registration() */
+   ESP_LOGI( DCE_TAG, "ec21_enable_status_reports" );
+   if ( ec21_enable_status_reports(ec21_dce) != ESP_OK )
    {
-      enableFastShutdownretry++;
-      ESP_LOGW(DCE_TAG, "retry n: %d of 10", enableFastShutdownretry);
-      vTaskDelay( pdMS_TO_TICKS( 1000 ) );
+      ESP_LOGW( DCE_TAG, "status reports not enabled, the cache is only fed by the queries" );
    }
 
-   if ( enableFastShutdownretry >= ENABLE_FAST_SHUTDOWN_MAX_RETRY )
+   /* Enable fast shutdown: fails with ERROR until the module has completed its initialization (SMS DONE, PB DONE) */
+   report->legacy_sleep_ms += 1000;
+   ec21_wait_ready( ec21_dce, EC21_READY_SMS | EC21_READY_PB, EC21_INIT_DONE_WAIT_MS );
+
+   ESP_LOGI( DCE_TAG, "ec21_enable_fast_shutdown" );
+   fastShutdownStart = esp_timer_get_time();
+   while ( ec21_enable_fast_shutdown(ec21_dce) != ESP_OK )
    {
-      ESP_LOGW(DCE_TAG, "Failed to enable fast shutdown");
+      report->fast_shutdown_retries++;
+      if ( ( esp_timer_get_time() - fastShutdownStart ) / 1000 >= EC21_FAST_SHUTDOWN_TIMEOUT_MS )
+      {
+         ESP_LOGW(DCE_TAG, "Failed to enable fast shutdown");
+         break;
+      }
+      ESP_LOGW(DCE_TAG, "retry n: %d", report->fast_shutdown_retries);
+      ec21_wait_ready( ec21_dce, EC21_READY_SMS | EC21_READY_PB, EC21_FAST_SHUTDOWN_RETRY_WAIT_MS );
    }
+   /* the legacy sequence slept 1 s per retry, up to ENABLE_FAST_SHUTDOWN_MAX_RETRY */
+   report->legacy_sleep_ms += 1000 * MIN( report->fast_shutdown_retries, ENABLE_FAST_SHUTDOWN_MAX_RETRY + 1 );
+   esp_modem_timeline_mark( ESP_MODEM_MILESTONE_FAST_SHUTDOWN );
+   esp_modem_timeline_mark( ESP_MODEM_MILESTONE_CONFIGURE_DONE );
+
+   report->total_ms = ( esp_timer_get_time() - start ) / 1000;
+   report->saved_ms = (int32_t)report->legacy_sleep_ms - (int32_t)report->waited_ms;
+   ESP_LOGI( DCE_TAG, "configured in %u ms, waited %u ms instead of %u ms of fixed sleeps (saved %d ms)",
+             report->total_ms, report->waited_ms, report->legacy_sleep_ms, report->saved_ms );
 
    return ESP_OK;
 err_io:
@@ -1049,10 +1817,251 @@ err_io:
 }
 
 
+esp_err_t ec21_get_startup_report( ec21_startup_report_t *report )
+{
+   DCE_CHECK( report, "report is NULL", err );
+   *report = gStartupReport;
+   return ESP_OK;
+err:
+   return ESP_FAIL;
+}
+
+
+/**
+ * @brief Persist the identity if it differs from the cached one
+ */
+static void ec21_store_identity(ec21_modem_dce_t *ec21_dce, const ec21_identity_t *identity)
+{
+   nvs_handle_t handle;
+   bool stored;
+
+   portENTER_CRITICAL( &ec21_dce->identity_lock );
+   stored = gIdentityCacheValid && !memcmp( &gIdentityCache, identity, sizeof(ec21_identity_t) );
+   portEXIT_CRITICAL( &ec21_dce->identity_lock );
+   if ( stored )
+   {
+      return;
+   }
+   DCE_CHECK( nvs_open( EC21_NVS_NAMESPACE, NVS_READWRITE, &handle ) == ESP_OK, "open nvs failed", err );
+   if ( ( nvs_set_blob( handle, EC21_NVS_IDENTITY_KEY, identity, sizeof(ec21_identity_t) ) == ESP_OK ) &&
+        ( nvs_commit( handle ) == ESP_OK ) )
+   {
+      /* a failed write leaves the cache as it was, the next identity read retries it */
+      portENTER_CRITICAL( &ec21_dce->identity_lock );
+      gIdentityCache = *identity;
+      gIdentityCacheValid = true;
+      portEXIT_CRITICAL( &ec21_dce->identity_lock );
+      ESP_LOGI( DCE_TAG, "module identity stored for ICCID %s", identity->iccid );
+   }
+   else
+   {
+      ESP_LOGE( DCE_TAG, "store module identity failed" );
+   }
+   nvs_close( handle );
+err:
+   return;
+}
+
+/**
+ * @brief Copy the identity known by the DCE, keyed on the ICCID
+ */
+static void ec21_fill_identity(ec21_modem_dce_t *ec21_dce, ec21_identity_t *identity, const char *iccid)
+{
+   const modem_dce_t *dce = &ec21_dce->parent;
+   memset( identity, 0, sizeof(ec21_identity_t) );
+   snprintf( identity->iccid, sizeof(identity->iccid), "%s", iccid );
+   portENTER_CRITICAL( &ec21_dce->identity_lock );
+   memcpy( identity->name, dce->name, sizeof(identity->name) );
+   memcpy( identity->imei, dce->imei, sizeof(identity->imei) );
+   memcpy( identity->imsi, dce->imsi, sizeof(identity->imsi) );
+   memcpy( identity->oper, dce->oper, sizeof(identity->oper) );
+   portEXIT_CRITICAL( &ec21_dce->identity_lock );
+}
+
+/**
+ * @brief Publish an identity into the DCE fields, ec21_get_identity() reads them under the same lock
+ */
+static void ec21_publish_identity(ec21_modem_dce_t *ec21_dce, const ec21_identity_t *identity)
+{
+   modem_dce_t *dce = &ec21_dce->parent;
+   portENTER_CRITICAL( &ec21_dce->identity_lock );
+   memcpy( dce->name, identity->name, sizeof(dce->name) );
+   memcpy( dce->imei, identity->imei, sizeof(dce->imei) );
+   memcpy( dce->imsi, identity->imsi, sizeof(dce->imsi) );
+   memcpy( dce->oper, identity->oper, sizeof(dce->oper) );
+   portEXIT_CRITICAL( &ec21_dce->identity_lock );
+}
+
+/**
+ * @brief Copy a number (IMEI, IMSI) line, other lines are unsolicited ones
+ */
+static esp_err_t ec21_copy_number(char *number, size_t size, const char *line)
+{
+   size_t len = strspn( line, "0123456789" );
+   if ( ( len == 0 ) || ( len >= size ) )
+   {
+      return ESP_FAIL;
+   }
+   memcpy( number, line, len );
+   number[len] = '\0';
+   return ESP_OK;
+}
+
+/**
+ * @brief Parse the IMEI answered to AT+CGSN
+ */
+static esp_err_t ec21_async_cgsn_line(modem_dce_t *dce, const esp_modem_line_t *line, void *context)
+{
+   ec21_identity_refresh_t *refresh = context;
+   return ec21_copy_number( refresh->identity.imei, sizeof(refresh->identity.imei), line->text );
+}
+
+/**
+ * @brief Parse the IMSI answered to AT+CIMI
+ */
+static esp_err_t ec21_async_cimi_line(modem_dce_t *dce, const esp_modem_line_t *line, void *context)
+{
+   ec21_identity_refresh_t *refresh = context;
+   return ec21_copy_number( refresh->identity.imsi, sizeof(refresh->identity.imsi), line->text );
+}
+
+/**
+ * @brief Parse +COPS: <mode>[,<format>[,<oper>]]
+ */
+static esp_err_t ec21_async_cops_line(modem_dce_t *dce, const esp_modem_line_t *line, void *context)
+{
+   ec21_identity_refresh_t *refresh = context;
+   /* the DCE is updated once the whole refresh succeeded */
+   return ec21_parse_cops( line, refresh->identity.oper, sizeof(refresh->identity.oper) );
+}
+
+/**
+ * @brief Account for finished identity queries
+ *
+ * Called by the engine task for each completion and by the submitting task for the queries it could not queue.
+ *
+ * @return true for the caller which finished the last query
+ */
+static bool ec21_identity_refresh_finish(ec21_modem_dce_t *ec21_dce, ec21_identity_refresh_t *refresh, int queries,
+                                         esp_err_t result)
+{
+   bool last;
+   portENTER_CRITICAL( &ec21_dce->identity_lock );
+   if ( ( result != ESP_OK ) && ( refresh->result == ESP_OK ) )
+   {
+      refresh->result = result;
+   }
+   refresh->pending -= queries;
+   last = ( refresh->pending == 0 );
+   portEXIT_CRITICAL( &ec21_dce->identity_lock );
+   return last;
+}
+
+/**
+ * @brief Completion of one identity query, the last one updates the DCE and the cache
+ */
+static void ec21_async_identity_done(modem_dce_t *dce, esp_err_t result, void *context)
+{
+   ec21_modem_dce_t *ec21_dce = __containerof(dce, ec21_modem_dce_t, parent);
+   ec21_identity_refresh_t *refresh = context;
+   if ( !ec21_identity_refresh_finish( ec21_dce, refresh, 1, result ) )
+   {
+      return;
+   }
+   /* no query is left in flight, the refresh belongs to this task until the next one is started */
+   if ( refresh->result != ESP_OK )
+   {
+      ESP_LOGW( DCE_TAG, "module identity refresh failed, keeping the cached one" );
+      return;
+   }
+   ec21_publish_identity( ec21_dce, &refresh->identity );
+   ec21_store_identity( ec21_dce, &refresh->identity );
+}
+
+/**
+ * @brief Check the cached identity and read the operator with the asynchronous command engine
+ *
+ * @return esp_err_t
+ *      - ESP_OK if the refresh is in progress
+ *      - ESP_FAIL if the queries could not be queued
+ */
+static esp_err_t ec21_refresh_identity_async(ec21_modem_dce_t *ec21_dce, const ec21_identity_t *cached)
+{
+   const esp_modem_async_cmd_t queries[] = {
+      { .command = "+COPS?", .prefix = "+COPS", .timeout = MODEM_COMMAND_TIMEOUT_OPERATOR, .line_cb = ec21_async_cops_line },
+      { .command = "+CGSN", .prefix = NULL, .timeout = MODEM_COMMAND_TIMEOUT_DEFAULT, .line_cb = ec21_async_cgsn_line },
+      { .command = "+CIMI", .prefix = NULL, .timeout = MODEM_COMMAND_TIMEOUT_DEFAULT, .line_cb = ec21_async_cimi_line },
+   };
+   const int count = sizeof(queries) / sizeof(queries[0]);
+   ec21_identity_refresh_t *refresh = &gIdentityRefresh;
+   bool busy;
+
+   DCE_CHECK( ec21_dce->parent.async, "asynchronous command engine not started", err );
+   portENTER_CRITICAL( &ec21_dce->identity_lock );
+   busy = ( refresh->pending != 0 );
+   if ( !busy )
+   {
+      refresh->identity = *cached;
+      refresh->result = ESP_OK;
+      refresh->pending = count;
+   }
+   portEXIT_CRITICAL( &ec21_dce->identity_lock );
+   DCE_CHECK( !busy, "identity refresh already in progress", err );
+   for (int i = 0; i < count; i++)
+   {
+      esp_modem_async_cmd_t query = queries[i];
+      query.done_cb = ec21_async_identity_done;
+      query.context = refresh;
+      if ( esp_modem_async_submit( &ec21_dce->parent, &query ) != ESP_OK )
+      {
+         /* the queries already queued complete the refresh, this one and the next ones are failed at once */
+         ESP_LOGE( DCE_TAG, "queue identity query %s failed", query.command );
+         return ec21_identity_refresh_finish( ec21_dce, refresh, count - i, ESP_FAIL ) ? ESP_FAIL : ESP_OK;
+      }
+   }
+   return ESP_OK;
+err:
+   return ESP_FAIL;
+}
+
 esp_err_t ec21_get_module_info( modem_dce_t * dce )
 {
+   char iccid[EC21_ICCID_LENGTH + 1] = "";
+   ec21_identity_t identity;
+   bool cached = false;
+
    DCE_CHECK( ec21_dce, "ec21_dce not intialized", err_io );
 
+   /* the identity only changes with the SIM: served from NVS when the ICCID matches */
+   if ( ec21_get_iccid(ec21_dce, iccid) != ESP_OK )
+   {
+      ESP_LOGW( DCE_TAG, "ICCID not read, module identity cache bypassed" );
+   }
+   else
+   {
+      portENTER_CRITICAL( &ec21_dce->identity_lock );
+      if ( gIdentityCacheValid && !strcmp( gIdentityCache.iccid, iccid ) )
+      {
+         identity = gIdentityCache;
+         cached = true;
+      }
+      portEXIT_CRITICAL( &ec21_dce->identity_lock );
+   }
+   if ( cached )
+   {
+      ec21_publish_identity( ec21_dce, &identity );
+      ESP_LOGI( DCE_TAG, "module identity from cache, ICCID %s", iccid );
+      /* refreshed in the background, or the operator is read now without the engine */
+      if ( ec21_refresh_identity_async(ec21_dce, &identity) != ESP_OK )
+      {
+         DCE_CHECK( ec21_get_operator_name(ec21_dce) == ESP_OK, "get operator name failed", err_io );
+         ec21_fill_identity( ec21_dce, &identity, iccid );
+         ec21_store_identity( ec21_dce, &identity );
+      }
+      esp_modem_timeline_mark( ESP_MODEM_MILESTONE_MODULE_INFO );
+      return ESP_OK;
+   }
+
    /* Get Module name */
    ESP_LOGD( DCE_TAG, "ec21_get_module_name" );
    DCE_CHECK( ec21_get_module_name(ec21_dce) == ESP_OK, "get module name failed", err_io );
@@ -1065,6 +2074,12 @@ esp_err_t ec21_get_module_info( modem_dce_t * dce )
    /* Get operator name */
    ESP_LOGD( DCE_TAG, "ec21_get_operator_name" );
    DCE_CHECK( ec21_get_operator_name(ec21_dce) == ESP_OK, "get operator name failed", err_io );
+   if ( iccid[0] )
+   {
+      ec21_fill_identity( ec21_dce, &identity, iccid );
+      ec21_store_identity( ec21_dce, &identity );
+   }
+   esp_modem_timeline_mark( ESP_MODEM_MILESTONE_MODULE_INFO );
 
    return ESP_OK;
 err_io:
@@ -1107,6 +2122,8 @@ esp_err_t ec21_get_band7_state( modem_dce_t * dce, bool *isEnabled )
 esp_err_t ec21_set_band7_state(modem_dce_t *dce, bool enable )
 {
    modem_dte_t *dte = ec21_dce->parent.dte;
+   DCE_CHECK(dte->acquire(dte, ESP_MODEM_CMD_PRIORITY_NORMAL, MODEM_ARBITER_TIMEOUT_DEFAULT) == ESP_OK,
+             "command arbiter busy", err_acquire);
    ec21_dce->parent.handle_line = ec21_handle_QCFG;
 
    if ( true == enable)
@@ -1121,21 +2138,224 @@ esp_err_t ec21_set_band7_state(modem_dce_t *dce, bool enable )
       DCE_CHECK(ec21_dce->parent.state == MODEM_STATE_SUCCESS, "disable band 7 failed", err);
    }
 
+   dte->release(dte);
    return ESP_OK;
 err:
+   dte->release(dte);
+err_acquire:
    return ESP_FAIL;
 }
 
 
+esp_err_t ec21_get_operator_list( modem_dce_t * dce, modem_response_cb_t response_cb, void *context )
+{
+   DCE_CHECK( esp_modem_dce_send_cmd_streamed( dce, "AT+COPS=?\r", MODEM_COMMAND_TIMEOUT_OPERATOR_SCAN,
+                                               response_cb, context ) == ESP_OK, "get list of operators failed", err );
+   ESP_LOGI( DCE_TAG, "get op list operator ok" );
+   return ESP_OK;
+err:
+   return ESP_FAIL;
+}
+
+esp_err_t ec21_get_neighbour_cells( modem_dce_t * dce, modem_response_cb_t response_cb, void *context )
+{
+   DCE_CHECK( esp_modem_dce_send_cmd_streamed( dce, "AT+QENG=\"neighbourcell\"\r", MODEM_COMMAND_TIMEOUT_DEFAULT,
+                                               response_cb, context ) == ESP_OK, "get neighbour cells failed", err );
+   return ESP_OK;
+err:
+   return ESP_FAIL;
+}
+
 esp_err_t ec21_get_network_extended_info(modem_dce_t *dce )
 {
    modem_dte_t *dte = ec21_dce->parent.dte;
+   DCE_CHECK(dte->acquire(dte, ESP_MODEM_CMD_PRIORITY_NORMAL, MODEM_ARBITER_TIMEOUT_DEFAULT) == ESP_OK,
+             "command arbiter busy", err_acquire);
    ec21_dce->parent.handle_line = ec21_handle_QNWINFO;
 
       DCE_CHECK(dte->send_cmd(dte, "AT+QNWINFO\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
       DCE_CHECK(ec21_dce->parent.state == MODEM_STATE_SUCCESS, "get QNWINFO failed", err);
 
+   dte->release(dte);
    return ESP_OK;
 err:
+   dte->release(dte);
+err_acquire:
    return ESP_FAIL;
 }
+
+/**
+ * @brief Parse +CSQ: <rssi>,<ber>
+ */
+static esp_err_t ec21_async_csq_line(modem_dce_t *dce, const esp_modem_line_t *line, void *context)
+{
+   ec21_status_t *status = context;
+   esp_modem_fields_t fields;
+   int32_t rssi = 0, ber = 0;
+   esp_modem_fields_init(&fields, line);
+   if (esp_modem_fields_int(&fields, &rssi) && esp_modem_fields_int(&fields, &ber))
+   {
+      status->rssi = rssi;
+      status->ber = ber;
+      ec21_cache_signal_quality(__containerof(dce, ec21_modem_dce_t, parent), rssi, ber);
+   }
+   return ESP_OK;
+}
+
+/**
+ * @brief Parse +CREG: <n>,<stat>
+ */
+static esp_err_t ec21_async_creg_line(modem_dce_t *dce, const esp_modem_line_t *line, void *context)
+{
+   ec21_status_t *status = context;
+   ec21_registration_t registration;
+   esp_modem_fields_t fields;
+   esp_modem_fields_init(&fields, line);
+   if (esp_modem_fields_skip(&fields, 1) && ec21_parse_registration(&fields, &registration))
+   {
+      status->network_status = registration.status;
+      ec21_cache_registration(__containerof(dce, ec21_modem_dce_t, parent), false, &registration);
+   }
+   return ESP_OK;
+}
+
+/**
+ * @brief Parse +CBC: <bcs>,<bcl>,<voltage>
+ */
+static esp_err_t ec21_async_cbc_line(modem_dce_t *dce, const esp_modem_line_t *line, void *context)
+{
+   ec21_status_t *status = context;
+   esp_modem_fields_t fields;
+   int32_t bcs = 0, bcl = 0, voltage = 0;
+   esp_modem_fields_init(&fields, line);
+   if (esp_modem_fields_int(&fields, &bcs) && esp_modem_fields_int(&fields, &bcl) &&
+       esp_modem_fields_int(&fields, &voltage))
+   {
+      status->bcs = bcs;
+      status->bcl = bcl;
+      status->voltage = voltage;
+   }
+   return ESP_OK;
+}
+
+/**
+ * @brief Completion of one status query, the last one completes the poll
+ */
+static void ec21_async_status_done(modem_dce_t *dce, esp_err_t result, void *context)
+{
+   ec21_status_t *status = context;
+   if ( ( result != ESP_OK ) && ( status->result == ESP_OK ) )
+   {
+      status->result = result;
+   }
+   if ( ( --status->pending == 0 ) && status->done_cb )
+   {
+      status->done_cb( dce, status->result, status->context );
+   }
+}
+
+esp_err_t ec21_poll_status_async( modem_dce_t * dce, ec21_status_t * status, esp_modem_async_done_cb_t done_cb, void *context )
+{
+   const esp_modem_async_cmd_t queries[] = {
+      { .command = "+CSQ", .prefix = "+CSQ", .timeout = MODEM_COMMAND_TIMEOUT_DEFAULT, .line_cb = ec21_async_csq_line },
+      { .command = "+CREG?", .prefix = "+CREG", .timeout = MODEM_COMMAND_TIMEOUT_DEFAULT, .line_cb = ec21_async_creg_line },
+      { .command = "+CBC", .prefix = "+CBC", .timeout = MODEM_COMMAND_TIMEOUT_DEFAULT, .line_cb = ec21_async_cbc_line },
+   };
+   const int count = sizeof(queries) / sizeof(queries[0]);
+
+   DCE_CHECK( status, "status is NULL", err );
+   status->result = ESP_OK;
+   status->pending = count;
+   status->done_cb = done_cb;
+   status->context = context;
+   for (int i = 0; i < count; i++)
+   {
+      esp_modem_async_cmd_t query = queries[i];
+      query.done_cb = ec21_async_status_done;
+      query.context = status;
+      if ( esp_modem_async_submit( dce, &query ) != ESP_OK )
+      {
+         /* the queries already queued complete the poll, count this one and the next ones as failed */
+         ESP_LOGE( DCE_TAG, "queue status query %s failed", query.command );
+         for ( ; i < count; i++ )
+         {
+            ec21_async_status_done( dce, ESP_FAIL, status );
+         }
+         return ( status->pending == 0 ) ? ESP_FAIL : ESP_OK;
+      }
+   }
+   return ESP_OK;
+err:
+   return ESP_FAIL;
+}
+
+esp_err_t ec21_get_cached_registration( modem_dce_t * dce, ec21_registration_t * registration, uint32_t * age_ms )
+{
+   DCE_CHECK( dce && registration, "invalid arguments", err_arg );
+   ec21_modem_dce_t *ec21_dce = __containerof(dce, ec21_modem_dce_t, parent);
+   ec21_status_cache_t *cache = &ec21_dce->cache;
+   int64_t time_us = 0;
+   portENTER_CRITICAL(&ec21_dce->cache_lock);
+   bool eps_registered = cache->cereg_time_us &&
+                         (cache->cereg.status == MODEM_NET_STA_REGISTERED_H_N ||
+                          cache->cereg.status == MODEM_NET_STA_REGISTERED_ROAMING);
+   if (eps_registered || (cache->cereg_time_us && !cache->creg_time_us))
+   {
+      *registration = cache->cereg;
+      time_us = cache->cereg_time_us;
+   }
+   else if (cache->creg_time_us)
+   {
+      *registration = cache->creg;
+      time_us = cache->creg_time_us;
+   }
+   portEXIT_CRITICAL(&ec21_dce->cache_lock);
+   if (time_us == 0)
+   {
+      return ESP_ERR_NOT_FOUND;
+   }
+   if (age_ms)
+   {
+      *age_ms = (esp_timer_get_time() - time_us) / 1000;
+   }
+   return ESP_OK;
+err_arg:
+   return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t ec21_get_cached_signal_quality( modem_dce_t * dce, uint32_t * rssi, uint32_t * ber, uint32_t * age_ms )
+{
+   DCE_CHECK( dce && rssi && ber, "invalid arguments", err_arg );
+   ec21_modem_dce_t *ec21_dce = __containerof(dce, ec21_modem_dce_t, parent);
+   portENTER_CRITICAL(&ec21_dce->cache_lock);
+   int64_t time_us = ec21_dce->cache.csq_time_us;
+   *rssi = ec21_dce->cache.rssi;
+   *ber = ec21_dce->cache.ber;
+   portEXIT_CRITICAL(&ec21_dce->cache_lock);
+   if (time_us == 0)
+   {
+      return ESP_ERR_NOT_FOUND;
+   }
+   if (age_ms)
+   {
+      *age_ms = (esp_timer_get_time() - time_us) / 1000;
+   }
+   return ESP_OK;
+err_arg:
+   return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t ec21_get_identity( modem_dce_t * dce, ec21_module_identity_t * identity )
+{
+   DCE_CHECK( dce && identity, "invalid arguments", err_arg );
+   ec21_modem_dce_t *ec21_dce = __containerof(dce, ec21_modem_dce_t, parent);
+   portENTER_CRITICAL(&ec21_dce->identity_lock);
+   memcpy(identity->name, dce->name, sizeof(identity->name));
+   memcpy(identity->imei, dce->imei, sizeof(identity->imei));
+   memcpy(identity->imsi, dce->imsi, sizeof(identity->imsi));
+   memcpy(identity->oper, dce->oper, sizeof(identity->oper));
+   portEXIT_CRITICAL(&ec21_dce->identity_lock);
+   return ESP_OK;
+err_arg:
+   return ESP_ERR_INVALID_ARG;
+}
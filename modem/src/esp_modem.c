@@ -17,16 +17,44 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
+#include "freertos/message_buffer.h"
+#include "freertos/event_groups.h"
+#include "esp_timer.h"
+#include "soc/soc_memory_layout.h"
 #include "esp_modem.h"
+#include "esp_modem_dce_service.h"
+#include "esp_modem_line_framer.h"
+#include "esp_modem_event_ring.h"
+#include "esp_modem_arena.h"
+#include "esp_modem_arbiter.h"
+#include "esp_modem_latency.h"
+#include "esp_modem_hdlc.h"
+#include "esp_modem_cmux.h"
+#include "esp_modem_dtr.h"
+#include "esp_modem_timeline.h"
 #include "esp_log.h"
 #include "sdkconfig.h"
 #include "DrvNvs.h"
 
 #define ESP_MODEM_EVENT_QUEUE_SIZE (16)
+#define ESP_MODEM_EVENT_STAMP_SIZE (sizeof(int64_t))  /*!< Post time kept after the data of the event ring slots */
+#define ESP_MODEM_EVENT_ID_MAX     (ESP_MODEM_EVENT_UNKNOWN + 1) /*!< Event ids with post times */
+#define ESP_MODEM_EVENT_STAMP_DEPTH (32)    /*!< Post times per event id, power of two above ESP_MODEM_EVENT_QUEUE_SIZE */
+#define ESP_MODEM_PPP_RX_MAX_CHUNKS (8)     /*!< Max reads per UART data event in PPP mode before yielding to other events */
+#define ESP_MODEM_PPP_FLAG          (ESP_MODEM_HDLC_FLAG)
+#define ESP_MODEM_PPP_MRU           (1500)  /*!< Max receive unit of decoded PPP frames */
+#define ESP_MODEM_TX_COALESCE_SIZE  (2048)  /*!< Max size of one UART write of the TX task, and of one queued frame */
+#define ESP_MODEM_TX_QUEUE_FRAMES   (64)    /*!< Max frames in the TX queue */
+#define ESP_MODEM_TX_DRAIN_TIMEOUT_MS (500) /*!< Max wait for the TX queue to drain when leaving PPP mode */
+#define ESP_MODEM_CMUX_DLCI_CONTROL (0)     /*!< Multiplexer control channel */
+#define ESP_MODEM_CMUX_DLCI_AT      (1)     /*!< Virtual channel of the AT commands */
+#define ESP_MODEM_CMUX_DLCI_PPP     (2)     /*!< Virtual channel of the PPP session (AT commands until CONNECT) */
+#define ESP_MODEM_CMUX_TIMEOUT_MS   (1000)  /*!< Max wait for the module to answer a multiplexer request */
+#define ESP_MODEM_CMUX_TX_SIZE      ((ESP_MODEM_TX_COALESCE_SIZE / ESP_MODEM_CMUX_N1 + 1) * ESP_MODEM_CMUX_FRAME_SIZE)
+#define ESP_MODEM_CMUX_EVENT_UA(dlci)   (1 << (dlci))       /*!< Channel open request acknowledged */
+#define ESP_MODEM_CMUX_EVENT_DM(dlci)   (1 << ((dlci) + 8)) /*!< Channel open request refused */
+#define ESP_MODEM_CMUX_EVENT_CLD        (1 << 16)           /*!< Multiplexer close down acknowledged */
 
-#define MIN_PATTERN_INTERVAL (9)
-#define MIN_POST_IDLE (1)
-#define MIN_PRE_IDLE (1)
 #define MAX_APN_LEN             64
 
 /**
@@ -49,6 +77,29 @@ ESP_EVENT_DEFINE_BASE(ESP_MODEM_EVENT);
 /* flag avoiding reset in case of uart data at startup */
 static bool gEnableHandlingUartData = false;
 
+/**
+ * @brief Handler of the unsolicited result codes starting with a prefix
+ *
+ */
+typedef struct {
+    const char *prefix;                     /*!< Prefix, NULL if the entry is free */
+    size_t prefix_len;                      /*!< Length of prefix */
+    esp_modem_urc_cb_t cb;                  /*!< Handler */
+    void *context;                          /*!< Handler context */
+} esp_modem_urc_handler_t;
+
+/**
+ * @brief Post times of the events of one id waiting for dispatch
+ *
+ * Events of one id are dispatched in the order they were posted, so the dispatcher takes the oldest post time.
+ * Written by the task posting the events of this id (one at a time) and read by the event loop.
+ */
+typedef struct {
+    int64_t posted[ESP_MODEM_EVENT_STAMP_DEPTH]; /*!< Post times */
+    volatile uint32_t head;                 /*!< Post times written (free running, poster only) */
+    volatile uint32_t tail;                 /*!< Post times read (free running, dispatcher only) */
+} esp_modem_event_stamps_t;
+
 /**
  * @brief ESP32 Modem DTE
  *
@@ -56,19 +107,203 @@ static bool gEnableHandlingUartData = false;
 typedef struct {
     uart_port_t uart_port;                  /*!< UART port */
     uint8_t *buffer;                        /*!< Internal buffer to store response lines/data from DCE */
+    uint8_t *rx_buffer;                     /*!< Internal buffer to store PPP data from DCE */
     QueueHandle_t event_queue;              /*!< UART event queue handle */
     esp_event_loop_handle_t event_loop_hdl; /*!< Event loop handle */
     TaskHandle_t uart_event_task_hdl;       /*!< UART event task handle */
+    TaskHandle_t event_loop_task_hdl;       /*!< Event loop task handle, NULL if the UART event task runs the loop */
     SemaphoreHandle_t process_sem;          /*!< Semaphore used for indicating processing status */
     SemaphoreHandle_t   exit_sem;           /*!< Semaphore used for indicating PPP mode has stopped */
+    SemaphoreHandle_t handler_lock;         /*!< Held by the UART event task while it runs the DCE handlers */
     modem_dte_t parent;                     /*!< DTE interface that should extend */
     esp_modem_on_receive receive_cb;        /*!< ptr to data reception */
     void *receive_cb_ctx;                   /*!< ptr to rx fn context data */
     int line_buffer_size;                   /*!< line buffer size in commnad mode */
-    int pattern_queue_size;                 /*!< UART pattern queue size */
+    int ppp_rx_chunk_size;                  /*!< rx buffer size in PPP mode */
+    uint8_t *line_ring;                     /*!< Ring buffer of the line framer */
+    esp_modem_line_framer_t framer;         /*!< Line framer used in command mode */
+    bool line_continued;                    /*!< The last framed segment did not end its line */
+    const char *volatile prompt;            /*!< Prompt expected by send_wait(), NULL if none */
+    bool rx_zero_copy;                      /*!< read PPP data straight into rx buffers of the network layer */
+    esp_modem_rx_buffer_ops_t rx_buffer_ops; /*!< rx buffer callbacks used for zero-copy reception */
+    esp_modem_dte_stats_t stats;            /*!< DTE statistics */
+    bool rx_overflow_resync;                /*!< Recover from overflows without flushing everything */
+    bool rx_resync;                         /*!< Dropping data until the next frame/line boundary */
+    uint32_t rx_announced;                  /*!< Bytes announced by the UART events so far */
+    uint32_t rx_read;                       /*!< Bytes read (or flushed) from the UART so far */
+    bool ppp_rx_framing;                    /*!< Decode PPP frames in the DTE */
+    esp_modem_hdlc_decoder_t hdlc;          /*!< PPP frame decoder */
+    MessageBufferHandle_t tx_queue;         /*!< PPP TX frame queue, NULL if frames are written synchronously */
+    QueueHandle_t tx_stamps;                /*!< Enqueue times of the frames in tx_queue */
+    uint8_t *tx_staging;                    /*!< Buffer gathering the frames of one UART write */
+    TaskHandle_t tx_task_hdl;               /*!< TX task handle */
+    volatile uint32_t tx_enqueued;          /*!< Frames enqueued (written by the sender only) */
+    volatile uint32_t tx_done;              /*!< Frames written to the UART (written by the TX task only) */
+    esp_modem_cmux_decoder_t cmux_rx;       /*!< CMUX frame decoder, used while parent.cmux is set */
+    uint8_t *cmux_line_ring;                /*!< Ring buffer of the PPP channel line framer */
+    esp_modem_line_framer_t cmux_ppp_framer; /*!< Line framer of the PPP channel until CONNECT, apart from the AT one */
+    bool cmux_ppp_line_continued;           /*!< The last segment of the PPP channel did not end its line */
+    uint8_t cmux_cmd_dlci;                  /*!< Channel the commands are sent on while multiplexing */
+    EventGroupHandle_t cmux_events;         /*!< Answers to the multiplexer requests */
+    uint8_t *cmux_tx;                       /*!< Frames written by the TX task while multiplexing */
+    int dtr_io_num;                         /*!< DTR pin (active low), negative if not wired */
+    esp_modem_urc_handler_t urc_handlers[ESP_MODEM_URC_HANDLERS_MAX]; /*!< Handlers of unsolicited result codes */
+    portMUX_TYPE urc_lock;                  /*!< Lock of urc_handlers */
+    esp_modem_event_ring_t event_ring;      /*!< Events published by the UART event task, drained by the event loop side */
+    uint8_t *event_ring_storage;            /*!< Slots of event_ring */
+    esp_modem_event_stamps_t event_stamps[ESP_MODEM_EVENT_ID_MAX]; /*!< Post times of the events, by event id */
+    esp_modem_dte_placement_t placement;    /*!< Memory capabilities of the buffers */
+    esp_modem_dte_footprint_t footprint;    /*!< Where the buffers were allocated */
+    esp_modem_arena_t *arena;               /*!< Caller storage of the static configuration, NULL for the heap */
+    esp_modem_arbiter_t arbiter;            /*!< Command arbiter, one transaction at a time */
+    esp_modem_latency_table_t latency;      /*!< Response times and timeouts of the commands */
 } esp_modem_dte_t;
 
 static char esp_modem_apn[64];
+
+/**
+ * @brief Post an event to the modem event loop
+ *
+ * The post time is kept in the post times of the event id, outside of the event data, and taken back in
+ * esp_modem_on_event_dispatch() to measure the delay from post to dispatch.
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param event_id event id
+ * @param data event data, NULL if none
+ * @param size size of event data
+ * @param posted post time
+ * @param timeout post timeout
+ * @return esp_err_t result of esp_event_post_to()
+ */
+static esp_err_t esp_modem_post_event_at(esp_modem_dte_t *esp_dte, int32_t event_id, const void *data, size_t size,
+                                         int64_t posted, TickType_t timeout)
+{
+    esp_modem_event_stamps_t *stamps = NULL;
+    uint32_t head = 0;
+    if (event_id >= 0 && event_id < ESP_MODEM_EVENT_ID_MAX) {
+        stamps = &esp_dte->event_stamps[event_id];
+        head = stamps->head;
+        if (head - __atomic_load_n(&stamps->tail, __ATOMIC_ACQUIRE) < ESP_MODEM_EVENT_STAMP_DEPTH) {
+            /* stored before the post: the event may be dispatched before esp_event_post_to() returns */
+            stamps->posted[head & (ESP_MODEM_EVENT_STAMP_DEPTH - 1)] = posted;
+            __atomic_store_n(&stamps->head, head + 1, __ATOMIC_RELEASE);
+        } else {
+            stamps = NULL;
+        }
+    }
+    esp_err_t err = esp_event_post_to(esp_dte->event_loop_hdl, ESP_MODEM_EVENT, event_id, (void *)data, size,
+                                      timeout);
+    if (err != ESP_OK) {
+        if (stamps) {
+            /* not queued, so its post time has not been taken */
+            __atomic_store_n(&stamps->head, head, __ATOMIC_RELEASE);
+        }
+        return err;
+    }
+    esp_dte->stats.events_posted++;
+    return ESP_OK;
+}
+
+/**
+ * @brief Post an event to the modem event loop, stamped with the current time
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param event_id event id
+ * @param data event data, NULL if none
+ * @param size size of event data
+ * @param timeout post timeout
+ * @return esp_err_t result of esp_event_post_to()
+ */
+static esp_err_t esp_modem_post_event(esp_modem_dte_t *esp_dte, int32_t event_id, void *data, size_t size,
+                                      TickType_t timeout)
+{
+    esp_err_t err = esp_modem_post_event_at(esp_dte, event_id, data, size, esp_timer_get_time(), timeout);
+    if (err != ESP_OK) {
+        esp_dte->stats.events_post_failed++;
+        return err;
+    }
+    if (esp_dte->event_loop_task_hdl) {
+        xTaskNotifyGive(esp_dte->event_loop_task_hdl);
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Publish an event from the UART event task, without blocking
+ *
+ * The event is copied to the event ring with its post time, and posted to the event loop later by
+ * esp_modem_drain_events(), so that neither a full event queue nor slow handlers delay the UART reception.
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param event_id event id
+ * @param data event data (with ESP_MODEM_EVENT_STAMP_SIZE spare bytes after size, to build the ring slot)
+ * @param size size of event data
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_NO_MEM if the event ring is full (the event is dropped)
+ */
+static esp_err_t esp_modem_publish_event(esp_modem_dte_t *esp_dte, int32_t event_id, uint8_t *data, size_t size)
+{
+    int64_t now = esp_timer_get_time();
+    memcpy(data + size, &now, sizeof(now));
+    if (!esp_modem_event_ring_push(&esp_dte->event_ring, event_id, data, size + ESP_MODEM_EVENT_STAMP_SIZE)) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (esp_dte->event_loop_task_hdl) {
+        xTaskNotifyGive(esp_dte->event_loop_task_hdl);
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Post the events of the event ring to the event loop, as long as the event queue has room
+ *
+ * Called by the consumer of the event ring only: the event loop task, or the UART event task without it.
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @return true if the event ring is empty
+ */
+static bool esp_modem_drain_events(esp_modem_dte_t *esp_dte)
+{
+    const esp_modem_event_slot_t *slot;
+    while ((slot = esp_modem_event_ring_peek(&esp_dte->event_ring)) != NULL) {
+        /* the post time follows the event data in the slot, left in the ring until the event queue has room */
+        size_t size = slot->size - ESP_MODEM_EVENT_STAMP_SIZE;
+        int64_t posted;
+        memcpy(&posted, slot->data + size, sizeof(posted));
+        if (esp_modem_post_event_at(esp_dte, slot->event_id, slot->data, size, posted, 0) != ESP_OK) {
+            return false;
+        }
+        esp_modem_event_ring_pop(&esp_dte->event_ring);
+    }
+    return true;
+}
+
+/**
+ * @brief Internal handler of all modem events, registered first to run before the user handlers
+ */
+static void esp_modem_on_event_dispatch(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    esp_modem_dte_t *esp_dte = arg;
+    esp_dte->stats.events_dispatched++;
+    if (event_id < 0 || event_id >= ESP_MODEM_EVENT_ID_MAX) {
+        return;
+    }
+    esp_modem_event_stamps_t *stamps = &esp_dte->event_stamps[event_id];
+    uint32_t tail = stamps->tail;
+    if (__atomic_load_n(&stamps->head, __ATOMIC_ACQUIRE) == tail) {
+        /* posted while the post times were full */
+        return;
+    }
+    int64_t posted = stamps->posted[tail & (ESP_MODEM_EVENT_STAMP_DEPTH - 1)];
+    __atomic_store_n(&stamps->tail, tail + 1, __ATOMIC_RELEASE);
+    uint32_t latency = (uint32_t)(esp_timer_get_time() - posted);
+    esp_dte->stats.event_latency_last_us = latency;
+    esp_dte->stats.event_latency_total_us += latency;
+    if (latency > esp_dte->stats.event_latency_max_us) {
+        esp_dte->stats.event_latency_max_us = latency;
+    }
+}
 /**
  * @brief Returns true if the supplied string contains only CR or LF
  *
@@ -93,153 +328,932 @@ esp_err_t esp_modem_set_rx_cb(modem_dte_t *dte, esp_modem_on_receive receive_cb,
     return ESP_OK;
 }
 
+esp_err_t esp_modem_set_rx_buffer_ops(modem_dte_t *dte, const esp_modem_rx_buffer_ops_t *ops)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    /* the frame being decoded belongs to the previous callbacks */
+    esp_modem_hdlc_decoder_reset(&esp_dte->hdlc);
+    if (ops) {
+        esp_dte->rx_buffer_ops = *ops;
+    } else {
+        memset(&esp_dte->rx_buffer_ops, 0, sizeof(esp_dte->rx_buffer_ops));
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Allocate memory with the requested capabilities, or anywhere if none is left
+ *
+ * @param arena caller storage of the static configuration, NULL to allocate from the heap
+ * @param size size in bytes
+ * @param caps memory capabilities
+ * @param name buffer name, for the logs
+ * @return allocated memory, NULL if out of memory
+ */
+static void *esp_modem_alloc(esp_modem_arena_t *arena, size_t size, uint32_t caps, const char *name)
+{
+    if (arena) {
+        /* placed by the caller along with the arena */
+        void *ptr = esp_modem_arena_calloc(arena, size);
+        if (ptr == NULL) {
+            ESP_LOGE(MODEM_TAG, "no room left in the arena for %s (%u bytes)", name, size);
+        }
+        return ptr;
+    }
+    void *ptr = heap_caps_malloc(size, caps);
+    if (ptr == NULL && caps != MALLOC_CAP_8BIT) {
+        ESP_LOGW(MODEM_TAG, "no memory with caps 0x%x left for %s (%u bytes), placed anywhere", caps, name, size);
+        ptr = heap_caps_malloc(size, MALLOC_CAP_8BIT);
+    }
+    return ptr;
+}
+
+/**
+ * @brief Record where a buffer was allocated in the footprint of the DTE
+ */
+static void esp_dte_record_buffer(esp_modem_dte_t *esp_dte, esp_modem_buffer_footprint_t *record, const char *name,
+                                  const void *ptr, size_t size, uint32_t caps)
+{
+    record->name = name;
+    record->size = size;
+    record->caps = caps;
+    record->external = esp_ptr_external_ram(ptr);
+    if (record->external) {
+        esp_dte->footprint.external_bytes += size;
+    } else {
+        esp_dte->footprint.internal_bytes += size;
+    }
+}
+
+/**
+ * @brief Size of a line framer ring, the power of two holding at least two lines
+ */
+static size_t esp_dte_line_ring_size(size_t line_buffer_size)
+{
+    size_t ring_size = 1;
+    while (ring_size < 2 * line_buffer_size) {
+        ring_size <<= 1;
+    }
+    return ring_size;
+}
+
+/**
+ * @brief Allocate a DTE buffer according to its placement and record it in the footprint
+ */
+static void *esp_dte_alloc(esp_modem_dte_t *esp_dte, esp_modem_buffer_footprint_t *record, const char *name,
+                           size_t size, uint32_t caps)
+{
+    void *ptr = esp_modem_alloc(esp_dte->arena, size, caps, name);
+    if (ptr) {
+        esp_dte_record_buffer(esp_dte, record, name, ptr, size, caps);
+    }
+    return ptr;
+}
+
+esp_modem_arena_t *esp_modem_dte_get_arena(modem_dte_t *dte)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    return esp_dte->arena;
+}
+
+esp_err_t esp_modem_get_footprint(modem_dte_t *dte, esp_modem_dte_footprint_t *footprint)
+{
+    MODEM_CHECK(footprint, "footprint is NULL", err);
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    *footprint = esp_dte->footprint;
+    return ESP_OK;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
+
+void esp_modem_log_footprint(modem_dte_t *dte)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    const esp_modem_buffer_footprint_t *buffers[] = {
+        &esp_dte->footprint.dte, &esp_dte->footprint.line, &esp_dte->footprint.line_ring,
+        &esp_dte->footprint.ppp_rx, &esp_dte->footprint.event_ring, &esp_dte->footprint.tx_staging,
+        &esp_dte->footprint.cmux_tx, &esp_dte->footprint.cmux_line_ring
+    };
+    for (int i = 0; i < sizeof(buffers) / sizeof(buffers[0]); i++) {
+        if (buffers[i]->name) {
+            ESP_LOGI(MODEM_TAG, "%-10s %6u bytes %s (caps 0x%x)", buffers[i]->name, buffers[i]->size,
+                     buffers[i]->external ? "SPIRAM" : "internal", buffers[i]->caps);
+        }
+    }
+    ESP_LOGI(MODEM_TAG, "memory: %u bytes internal, %u bytes SPIRAM",
+             esp_dte->footprint.internal_bytes, esp_dte->footprint.external_bytes);
+}
+
+esp_err_t esp_modem_get_stats(modem_dte_t *dte, esp_modem_dte_stats_t *stats)
+{
+    MODEM_CHECK(stats, "stats is NULL", err);
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    *stats = esp_dte->stats;
+    stats->tx_queue_depth = esp_dte->tx_enqueued - esp_dte->tx_done;
+    stats->rx_frames = esp_dte->hdlc.frames;
+    stats->rx_frame_fcs_errors = esp_dte->hdlc.fcs_errors;
+    stats->rx_frames_dropped = esp_dte->hdlc.dropped;
+    stats->cmux_frames = esp_dte->cmux_rx.frames;
+    stats->cmux_fcs_errors = esp_dte->cmux_rx.fcs_errors;
+    stats->cmux_frames_dropped = esp_dte->cmux_rx.dropped;
+    stats->event_ring_pending = esp_modem_event_ring_pending(&esp_dte->event_ring);
+    stats->event_ring_peak = esp_dte->event_ring.peak;
+    stats->event_ring_dropped = esp_dte->event_ring.dropped;
+    return ESP_OK;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
+
+
+esp_err_t esp_modem_get_command_latency(modem_dte_t *dte, esp_modem_command_latency_t *latency, size_t *count)
+{
+    MODEM_CHECK(latency && count, "latency or count is NULL", err);
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    *count = esp_modem_latency_snapshot(&esp_dte->latency, latency, *count);
+    return ESP_OK;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_modem_get_arbiter_stats(modem_dte_t *dte, esp_modem_arbiter_stats_t *stats)
+{
+    MODEM_CHECK(stats, "stats is NULL", err);
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    esp_modem_arbiter_get_stats(&esp_dte->arbiter, stats);
+    return ESP_OK;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
+
+/**
+ * @brief Pass an unsolicited line to the handlers of its prefix
+ *
+ * @return true if at least one handler took the line
+ */
+static bool esp_dte_route_urc(esp_modem_dte_t *esp_dte, const esp_modem_line_t *line)
+{
+    bool routed = false;
+    for (int i = 0; i < ESP_MODEM_URC_HANDLERS_MAX; i++) {
+        /* copied under the lock, called outside */
+        portENTER_CRITICAL(&esp_dte->urc_lock);
+        esp_modem_urc_handler_t handler = esp_dte->urc_handlers[i];
+        portEXIT_CRITICAL(&esp_dte->urc_lock);
+        if (handler.prefix == NULL || handler.prefix[0] != line->text[0] || handler.prefix_len > line->len) {
+            continue;
+        }
+        if (esp_modem_line_has_prefix(line, handler.prefix)) {
+            handler.cb(&esp_dte->parent, line, handler.context);
+            routed = true;
+        }
+    }
+    return routed;
+}
+
+/**
+ * @brief Handle one line in DTE
+ *
+ * @param esp_dte ESP modem DTE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t esp_dte_handle_line(esp_modem_dte_t *esp_dte)
+{
+    esp_err_t err = ESP_FAIL;
+    modem_dce_t *dce = esp_dte->parent.dce;
+    MODEM_CHECK(dce, "DTE has not yet bind with DCE", err);
+    const char *line = (const char *)(esp_dte->buffer);
+    size_t len = strlen(line);
+    /* Skip pure "\r\n" lines */
+    if (len > 2 && !is_only_cr_lf(line, len)) {
+        /* classified once, the handlers only look at the class and the payload */
+        esp_modem_line_t classified;
+        esp_modem_line_classify(line, &classified);
+        if (dce->handle_line && dce->handle_line(dce, &classified) == ESP_OK) {
+            return ESP_OK;
+        }
+        /* not part of a response: to the handlers of its prefix, or to the user handlers */
+        if (esp_dte_route_urc(esp_dte, &classified)) {
+            esp_dte->stats.urc_routed++;
+            return ESP_OK;
+        }
+        ESP_LOGD(MODEM_TAG, "No handler for line: %s", line);
+        if (esp_dte->arena) {
+            /* esp_event copies the event data on the heap: only the URC handlers get lines */
+            esp_dte->stats.urc_dropped++;
+            return ESP_OK;
+        }
+        /* never wait for room in the event queue from the receive task */
+        if (esp_modem_publish_event(esp_dte, ESP_MODEM_EVENT_UNKNOWN, esp_dte->buffer, len + 1) != ESP_OK) {
+            esp_dte->stats.urc_dropped++;
+            return ESP_FAIL;
+        }
+        esp_dte->stats.urc_posted++;
+    }
+    return ESP_OK;
+err:
+    return err;
+}
+
+/**
+ * @brief Pass a framed segment to the DCE handlers
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param segment line segment, stored in the DTE line buffer
+ * @param len length of the segment
+ * @param line_end true if the segment ends the line
+ * @param continued state of the channel the segment was framed from: the previous segment did not end its line
+ */
+static void esp_dte_dispatch_segment(esp_modem_dte_t *esp_dte, const char *segment, size_t len, bool line_end,
+                                     bool *continued)
+{
+    modem_dce_t *dce = esp_dte->parent.dce;
+    bool continuation = *continued;
+    *continued = !line_end;
+    /* the command side clears the handlers under this lock: none is left running once send_cmd returns */
+    xSemaphoreTake(esp_dte->handler_lock, portMAX_DELAY);
+    if (dce && dce->handle_segment) {
+        /* streamed response, any line length */
+        dce->handle_segment(dce, segment, len, !continuation, line_end);
+    } else if (!continuation) {
+        /* the rest of a line which did not fit the line buffer is dropped */
+        if (!line_end) {
+            ESP_LOGW(MODEM_TAG, "ESP Modem Line buffer too small");
+        }
+        ESP_LOG_BUFFER_HEXDUMP("esp-modem: debug_data", segment, len, ESP_LOG_DEBUG);
+        esp_dte_handle_line(esp_dte);
+    }
+    xSemaphoreGive(esp_dte->handler_lock);
+}
+
+/**
+ * @brief Handle a segment framed by the line framer (UART, or AT channel of the multiplexer)
+ *
+ * @param context ESP32 Modem DTE object
+ * @param segment line segment, stored in the DTE line buffer
+ * @param len length of the segment
+ * @param line_end true if the segment ends the line
+ */
+static void esp_dte_handle_segment(void *context, const char *segment, size_t len, bool line_end)
+{
+    esp_modem_dte_t *esp_dte = context;
+    esp_dte_dispatch_segment(esp_dte, segment, len, line_end, &esp_dte->line_continued);
+}
+
+/**
+ * @brief Handle a segment framed from the PPP channel of the multiplexer, before CONNECT
+ *
+ * @param context ESP32 Modem DTE object
+ * @param segment line segment, stored in the DTE line buffer
+ * @param len length of the segment
+ * @param line_end true if the segment ends the line
+ */
+static void esp_dte_handle_cmux_ppp_segment(void *context, const char *segment, size_t len, bool line_end)
+{
+    esp_modem_dte_t *esp_dte = context;
+    esp_dte_dispatch_segment(esp_dte, segment, len, line_end, &esp_dte->cmux_ppp_line_continued);
+}
+
+/**
+ * @brief Detach the response handlers of the command, waiting for a handler running in the UART event task
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param dce Modem DCE object
+ */
+static void esp_dte_clear_handlers(esp_modem_dte_t *esp_dte, modem_dce_t *dce)
+{
+    xSemaphoreTake(esp_dte->handler_lock, portMAX_DELAY);
+    dce->handle_line = NULL;
+    dce->handle_segment = NULL;
+    xSemaphoreGive(esp_dte->handler_lock);
+}
+
+/**
+ * @brief Read from the UART ring buffer, keeping track of the read position
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param buf destination buffer
+ * @param len max number of bytes to read
+ * @param timeout read timeout
+ * @return number of bytes read, -1 on error
+ */
+static int esp_dte_read(esp_modem_dte_t *esp_dte, uint8_t *buf, size_t len, TickType_t timeout)
+{
+    int read_len = uart_read_bytes(esp_dte->uart_port, buf, len, timeout);
+    if (read_len > 0) {
+        esp_dte->rx_read += read_len;
+    }
+    return read_len;
+}
+
+/**
+ * @brief Discard the data in the UART ring buffer
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ */
+static void esp_dte_flush_input(esp_modem_dte_t *esp_dte)
+{
+    size_t length = 0;
+    uart_get_buffered_data_len(esp_dte->uart_port, &length);
+    uart_flush_input(esp_dte->uart_port);
+    esp_dte->rx_read += length;
+}
+
+/**
+ * @brief Get the number of bytes to read, bounded by the ring buffer content and max
+ */
+static size_t esp_dte_readable(esp_modem_dte_t *esp_dte, size_t max)
+{
+    size_t length = 0;
+    uart_get_buffered_data_len(esp_dte->uart_port, &length);
+    return MIN(length, max);
+}
+
+/**
+ * @brief Check if the PPP frames are decoded in the DTE
+ */
+static inline bool esp_dte_ppp_framing(esp_modem_dte_t *esp_dte)
+{
+    return esp_dte->ppp_rx_framing && esp_dte->rx_buffer_ops.get && esp_dte->rx_buffer_ops.receive_frame;
+}
+
+/**
+ * @brief Pass PPP data copied out of the UART to the network layer, as raw data or decoded frames
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param data PPP data
+ * @param len length of data
+ */
+static void esp_dte_deliver_ppp(esp_modem_dte_t *esp_dte, uint8_t *data, size_t len)
+{
+    /* copied once out of the UART and once more by the network layer (or the frame decoder) */
+    esp_dte->stats.rx_bytes += len;
+    esp_dte->stats.rx_copied_bytes += 2 * len;
+    if (esp_dte_ppp_framing(esp_dte)) {
+        esp_modem_hdlc_decode(&esp_dte->hdlc, data, len);
+        return;
+    }
+    esp_dte->receive_cb(data, len, esp_dte->receive_cb_ctx);
+}
+
+/**
+ * @brief HDLC decoder callback getting a frame buffer from the network layer
+ */
+static void *esp_dte_get_frame(size_t size, uint8_t **payload, void *context)
+{
+    esp_modem_dte_t *esp_dte = context;
+    return esp_dte->rx_buffer_ops.get(size, payload, esp_dte->rx_buffer_ops.context);
+}
+
+/**
+ * @brief HDLC decoder callback passing a valid frame to the network layer
+ */
+static void esp_dte_deliver_frame(void *frame, size_t offset, size_t len, void *context)
+{
+    esp_modem_dte_t *esp_dte = context;
+    esp_dte->rx_buffer_ops.receive_frame(frame, offset, len, esp_dte->rx_buffer_ops.context);
+}
+
+/**
+ * @brief HDLC decoder callback releasing a frame buffer
+ */
+static void esp_dte_drop_frame(void *frame, void *context)
+{
+    esp_modem_dte_t *esp_dte = context;
+    esp_dte->rx_buffer_ops.free(frame, esp_dte->rx_buffer_ops.context);
+}
+
+/**
+ * @brief Drop the received data up to the next frame boundary after an overflow
+ *
+ * In PPP mode the data are dropped up to the next HDLC flag, which is kept so that the network layer discards
+ * the damaged frame and starts the next one. In command mode the data are dropped up to the end of the line.
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param max max number of bytes to read
+ * @return number of bytes read
+ */
+static size_t esp_dte_resync(esp_modem_dte_t *esp_dte, size_t max)
+{
+    bool ppp = esp_dte->parent.dce->mode == MODEM_PPP_MODE;
+    size_t length = esp_dte_readable(esp_dte, max);
+    size_t total = 0;
+    while (esp_dte->rx_resync && length) {
+        uint8_t *buf = esp_dte->rx_buffer;
+        size_t room = esp_dte->ppp_rx_chunk_size;
+        if (!ppp) {
+            room = esp_modem_line_framer_get_write_ptr(&esp_dte->framer, &buf);
+        }
+        int read_len = esp_dte_read(esp_dte, buf, MIN(room, length), 0);
+        if (read_len <= 0) {
+            break;
+        }
+        length -= read_len;
+        total += read_len;
+        const uint8_t *sync = memchr(buf, ppp ? ESP_MODEM_PPP_FLAG : '\n', read_len);
+        if (sync == NULL) {
+            esp_dte->stats.rx_resync_dropped_bytes += read_len;
+            continue;
+        }
+        size_t skip = sync - buf + (ppp ? 0 : 1);
+        size_t keep = read_len - skip;
+        esp_dte->stats.rx_resync_dropped_bytes += skip;
+        esp_dte->rx_resync = false;
+        ESP_LOGD(MODEM_TAG, "resynchronized after %u bytes", esp_dte->stats.rx_resync_dropped_bytes);
+        if (keep == 0) {
+            break;
+        }
+        if (ppp) {
+            esp_dte_deliver_ppp(esp_dte, buf + skip, keep);
+        } else {
+            memmove(buf, buf + skip, keep);
+            esp_modem_line_framer_commit(&esp_dte->framer, keep);
+        }
+    }
+    return total;
+}
+
+/**
+ * @brief Release send_wait() if the pending data start with the expected prompt
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ */
+static void esp_dte_check_prompt(esp_modem_dte_t *esp_dte)
+{
+    const char *prompt = esp_dte->prompt;
+    if (prompt && esp_modem_line_framer_consume_prompt(&esp_dte->framer, prompt, strlen(prompt))) {
+        esp_dte->prompt = NULL;
+        xSemaphoreGive(esp_dte->process_sem);
+    }
+}
+
+/**
+ * @brief Read the available data in command mode and pass the complete lines to the DCE
+ *
+ * Partial lines stay in the line framer until the rest arrives with the next data event.
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param max max number of bytes to read
+ */
+static void esp_dte_read_lines(esp_modem_dte_t *esp_dte, size_t max)
+{
+    size_t length = esp_dte_readable(esp_dte, max);
+    if (esp_dte->rx_resync) {
+        length -= esp_dte_resync(esp_dte, length);
+    }
+    while (length) {
+        uint8_t *ptr;
+        size_t room = esp_modem_line_framer_get_write_ptr(&esp_dte->framer, &ptr);
+        int read_len = esp_dte_read(esp_dte, ptr, MIN(room, length), 0);
+        if (read_len <= 0) {
+            break;
+        }
+        esp_modem_line_framer_commit(&esp_dte->framer, read_len);
+        length -= read_len;
+    }
+    esp_dte_check_prompt(esp_dte);
+}
+
+/**
+ * @brief Pass PPP data from the UART ring buffer to the network layer
+ *
+ * With zero-copy reception the data are read straight into an rx buffer of the network layer,
+ * which is then handed over. Otherwise the data go through the DTE buffer and get copied again
+ * by the network layer, or by the frame decoder into the network layer's buffers with ppp_rx_framing.
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param length number of bytes to read
+ */
+static void esp_dte_receive_ppp(esp_modem_dte_t *esp_dte, size_t length)
+{
+    const esp_modem_rx_buffer_ops_t *ops = &esp_dte->rx_buffer_ops;
+    if (esp_dte->rx_zero_copy && ops->get && !esp_dte_ppp_framing(esp_dte)) {
+        uint8_t *payload = NULL;
+        void *rx_buffer = ops->get(length, &payload, ops->context);
+        if (rx_buffer) {
+            int read_len = esp_dte_read(esp_dte, payload, length, portMAX_DELAY);
+            if (read_len <= 0) {
+                ops->free(rx_buffer, ops->context);
+                return;
+            }
+            esp_dte->stats.rx_bytes += read_len;
+            esp_dte->stats.rx_copied_bytes += read_len;
+            ops->receive(rx_buffer, read_len, ops->context);
+            return;
+        }
+        ESP_LOGD(MODEM_TAG, "No rx buffer available, fall back to copy");
+    }
+    int read_len = esp_dte_read(esp_dte, esp_dte->rx_buffer, length, portMAX_DELAY);
+    /* pass the input data to configured callback */
+    if (read_len > 0) {
+        esp_dte_deliver_ppp(esp_dte, esp_dte->rx_buffer, read_len);
+    }
+}
+
+/**
+ * @brief Drain the UART ring buffer in PPP mode
+ *
+ * Reads in chunks of ppp_rx_chunk_size until the ring buffer is empty (bounded by ESP_MODEM_PPP_RX_MAX_CHUNKS
+ * so that other UART events still get served). Once everything is drained, the data events queued
+ * meanwhile carry no new data and are consumed here as well.
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param max max number of bytes to read
+ */
+static void esp_dte_drain_ppp(esp_modem_dte_t *esp_dte, size_t max)
+{
+    size_t length = 0;
+    uart_event_t event;
+
+    esp_dte->stats.rx_data_events++;
+    if (esp_modem_line_framer_pending(&esp_dte->framer)) {
+        /* data read in transition mode right after CONNECT belong to the PPP session */
+        length = esp_modem_line_framer_take(&esp_dte->framer, esp_dte->rx_buffer, esp_dte->ppp_rx_chunk_size);
+        esp_dte_deliver_ppp(esp_dte, esp_dte->rx_buffer, length);
+    }
+    if (esp_dte->rx_resync) {
+        max -= esp_dte_resync(esp_dte, max);
+    }
+    for (int i = 0; i < ESP_MODEM_PPP_RX_MAX_CHUNKS; i++) {
+        length = esp_dte_readable(esp_dte, max);
+        if (length == 0) {
+            break;
+        }
+        esp_dte->stats.rx_chunks++;
+        length = MIN(esp_dte->ppp_rx_chunk_size, length);
+        esp_dte_receive_ppp(esp_dte, length);
+        max -= length;
+    }
+    uart_get_buffered_data_len(esp_dte->uart_port, &length);
+    if (length) {
+        /* more to come, the pending data events will trigger the next round */
+        return;
+    }
+    while (xQueuePeek(esp_dte->event_queue, &event, 0) == pdTRUE && event.type == UART_DATA) {
+        xQueueReceive(esp_dte->event_queue, &event, 0);
+        esp_dte->rx_announced += event.size;
+        esp_dte->stats.rx_data_events_coalesced++;
+    }
+}
+
+/**
+ * @brief Write data to the UART as UIH frames of a CMUX channel
+ *
+ * Each UART write carries whole frames, so that frames of other channels written meanwhile do not get mixed in.
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param dlci channel
+ * @param data data
+ * @param len length of data
+ * @param buf buffer for the frames, at least ESP_MODEM_CMUX_FRAME_SIZE
+ * @param buf_size size of buf
+ * @return len on success, -1 on error
+ */
+static int esp_dte_cmux_write(esp_modem_dte_t *esp_dte, uint8_t dlci, const uint8_t *data, size_t len,
+                              uint8_t *buf, size_t buf_size)
+{
+    size_t done = 0;
+    while (done < len) {
+        size_t out = 0;
+        while (done < len && buf_size - out >= ESP_MODEM_CMUX_FRAME_SIZE) {
+            size_t chunk = MIN(len - done, ESP_MODEM_CMUX_N1);
+            out += esp_modem_cmux_encode(dlci, ESP_MODEM_CMUX_UIH, true, data + done, chunk, buf + out, buf_size - out);
+            done += chunk;
+        }
+        if (uart_write_bytes(esp_dte->uart_port, (const char *)buf, out) < 0) {
+            return -1;
+        }
+    }
+    return len;
+}
+
+/**
+ * @brief Set the V.24 signals of a CMUX channel with a modem status command
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param dlci channel
+ * @param ready true to signal DTR/RTS on (RTC and RTR set), false for DTR off (RTC clear)
+ */
+static void esp_dte_cmux_signals(esp_modem_dte_t *esp_dte, uint8_t dlci, bool ready)
+{
+    uint8_t frame[ESP_MODEM_CMUX_FRAME_SIZE];
+    /* V.24 signals: EA, RTC (bit 3), RTR (bit 4), DV (bit 8) */
+    const uint8_t msc[] = { ESP_MODEM_CMUX_MSG_MSC | ESP_MODEM_CMUX_CR, (2 << 1) | ESP_MODEM_CMUX_EA,
+                            (dlci << 2) | ESP_MODEM_CMUX_CR | ESP_MODEM_CMUX_EA, ready ? 0x8D : 0x89 };
+    size_t len = esp_modem_cmux_encode(ESP_MODEM_CMUX_DLCI_CONTROL, ESP_MODEM_CMUX_UIH, true, msc, sizeof(msc),
+                                       frame, sizeof(frame));
+    uart_write_bytes(esp_dte->uart_port, (const char *)frame, len);
+}
+
+/**
+ * @brief Write data to the DCE, on a CMUX channel while multiplexing
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param dlci channel, ignored if not multiplexing
+ * @param data data
+ * @param len length of data
+ * @return number of bytes written, -1 on error
+ */
+static int esp_dte_write(esp_modem_dte_t *esp_dte, uint8_t dlci, const char *data, size_t len)
+{
+    if (!esp_dte->parent.cmux) {
+        return uart_write_bytes(esp_dte->uart_port, data, len);
+    }
+    uint8_t frames[2 * ESP_MODEM_CMUX_FRAME_SIZE];
+    return esp_dte_cmux_write(esp_dte, dlci, (const uint8_t *)data, len, frames, sizeof(frames));
+}
+
+/**
+ * @brief Handle a message of the CMUX control channel
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param data message: type, length and value
+ * @param len length of data
+ */
+static void esp_dte_cmux_control(esp_modem_dte_t *esp_dte, uint8_t *data, size_t len)
+{
+    if (len < 2) {
+        return;
+    }
+    if (data[0] & ESP_MODEM_CMUX_CR) {
+        /* command of the module (e.g. modem status), acknowledged by the same message as response */
+        uint8_t frame[ESP_MODEM_CMUX_FRAME_SIZE];
+        data[0] &= ~ESP_MODEM_CMUX_CR;
+        size_t frame_len = esp_modem_cmux_encode(ESP_MODEM_CMUX_DLCI_CONTROL, ESP_MODEM_CMUX_UIH, true,
+                                                 data, len, frame, sizeof(frame));
+        uart_write_bytes(esp_dte->uart_port, (const char *)frame, frame_len);
+        return;
+    }
+    if (data[0] == ESP_MODEM_CMUX_MSG_CLD) {
+        xEventGroupSetBits(esp_dte->cmux_events, ESP_MODEM_CMUX_EVENT_CLD);
+    }
+}
+
+/**
+ * @brief Handle a decoded CMUX frame
+ *
+ * The AT channel and the PPP channel go through line framers of their own until CONNECT: their frames
+ * are independent, a partial line of one channel must not be joined with the next frame of the other.
+ * The PPP channel carries the PPP data in PPP mode.
+ *
+ * @param dlci channel
+ * @param control control field
+ * @param data information field
+ * @param len length of the information field
+ * @param context ESP32 Modem DTE object
+ */
+static void esp_dte_cmux_frame(uint8_t dlci, uint8_t control, uint8_t *data, size_t len, void *context)
+{
+    esp_modem_dte_t *esp_dte = context;
+    switch (control) {
+    case ESP_MODEM_CMUX_UA:
+        if (dlci <= ESP_MODEM_CMUX_DLCI_PPP) {
+            xEventGroupSetBits(esp_dte->cmux_events, ESP_MODEM_CMUX_EVENT_UA(dlci));
+        }
+        return;
+    case ESP_MODEM_CMUX_DM:
+        if (dlci <= ESP_MODEM_CMUX_DLCI_PPP) {
+            xEventGroupSetBits(esp_dte->cmux_events, ESP_MODEM_CMUX_EVENT_DM(dlci));
+        }
+        return;
+    case ESP_MODEM_CMUX_UIH:
+    case ESP_MODEM_CMUX_UI:
+        break;
+    default:
+        return;
+    }
+    if (dlci == ESP_MODEM_CMUX_DLCI_CONTROL) {
+        esp_dte_cmux_control(esp_dte, data, len);
+        return;
+    }
+    if (dlci == ESP_MODEM_CMUX_DLCI_PPP) {
+        esp_modem_line_framer_t *framer = &esp_dte->cmux_ppp_framer;
+        if (esp_dte->parent.dce->mode != MODEM_PPP_MODE) {
+            esp_modem_line_framer_feed(framer, data, len);
+            return;
+        }
+        if (esp_modem_line_framer_pending(framer)) {
+            /* data of the frame which carried CONNECT belong to the PPP session */
+            size_t length = esp_modem_line_framer_take(framer, esp_dte->rx_buffer, esp_dte->ppp_rx_chunk_size);
+            esp_dte_deliver_ppp(esp_dte, esp_dte->rx_buffer, length);
+        }
+        esp_dte_deliver_ppp(esp_dte, data, len);
+        return;
+    }
+    esp_modem_line_framer_feed(&esp_dte->framer, data, len);
+    esp_dte_check_prompt(esp_dte);
+}
+
+/**
+ * @brief Read the available data while multiplexing and decode the CMUX frames
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param max max number of bytes to read
+ */
+static void esp_dte_cmux_read(esp_modem_dte_t *esp_dte, size_t max)
+{
+    size_t length = esp_dte_readable(esp_dte, max);
+    while (length) {
+        int read_len = esp_dte_read(esp_dte, esp_dte->rx_buffer, MIN(length, esp_dte->ppp_rx_chunk_size), 0);
+        if (read_len <= 0) {
+            break;
+        }
+        esp_modem_cmux_decode(&esp_dte->cmux_rx, esp_dte->rx_buffer, read_len);
+        length -= read_len;
+    }
+}
+
+/**
+ * @brief Handle when new data received by UART
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param max max number of bytes to read, SIZE_MAX for all available data
+ */
+static void esp_handle_uart_data(esp_modem_dte_t *esp_dte, size_t max)
+{
+    if (esp_dte->parent.cmux) {
+        esp_dte_cmux_read(esp_dte, max);
+        return;
+    }
+    if (esp_dte->parent.dce->mode != MODEM_PPP_MODE) {
+        esp_dte_read_lines(esp_dte, max);
+        return;
+    }
+
+   if ( false == gEnableHandlingUartData )
+   {
+      ESP_LOGE(MODEM_TAG, "Discard Uart data too early ");
+      return;
+   }
+
+    esp_dte_drain_ppp(esp_dte, max);
+}
 
 /**
- * @brief Handle one line in DTE
+ * @brief Handle a UART hardware FIFO overflow
  *
- * @param esp_dte ESP modem DTE object
- * @return esp_err_t
- *      - ESP_OK on success
- *      - ESP_FAIL on error
+ * The driver resets the FIFO, so the data are lost at the point where the overflow event was raised.
+ * The data announced by the events before it are intact and get processed as usual, then the data
+ * are dropped up to the next frame (PPP) or line (command mode) boundary. The event queue is kept.
+ *
+ * @param esp_dte ESP32 Modem DTE object
  */
-static esp_err_t esp_dte_handle_line(esp_modem_dte_t *esp_dte)
+static void esp_handle_uart_overflow(esp_modem_dte_t *esp_dte)
 {
-    esp_err_t err = ESP_FAIL;
-    modem_dce_t *dce = esp_dte->parent.dce;
-    MODEM_CHECK(dce, "DTE has not yet bind with DCE", err);
-    const char *line = (const char *)(esp_dte->buffer);
-    size_t len = strlen(line);
-    /* Skip pure "\r\n" lines */
-    if (len > 2 && !is_only_cr_lf(line, len)) {
-        if (dce->handle_line == NULL) {
-            /* Received an asynchronous line, but no handler waiting this this */
-            ESP_LOGD(MODEM_TAG, "No handler for line: %s", line);
-            err = ESP_OK; /* Not an error, just propagate the line to user handler */
-            goto post_event_unknown;
-        }
-        MODEM_CHECK(dce->handle_line(dce, line) == ESP_OK, "handle line failed", post_event_unknown);
+    int32_t before_gap = (int32_t)(esp_dte->rx_announced - esp_dte->rx_read);
+    if (before_gap > 0) {
+        esp_handle_uart_data(esp_dte, before_gap);
     }
-    return ESP_OK;
-post_event_unknown:
-    /* Send ESP_MODEM_EVENT_UNKNOWN signal to event loop */
-    esp_event_post_to(esp_dte->event_loop_hdl, ESP_MODEM_EVENT, ESP_MODEM_EVENT_UNKNOWN,
-                      (void *)line, strlen(line) + 1, pdMS_TO_TICKS(100));
-err:
-    return err;
+    if (esp_dte->parent.cmux) {
+        /* frames are checked on their own, drop the damaged one and wait for the next flag */
+        esp_modem_cmux_decoder_reset(&esp_dte->cmux_rx);
+        esp_dte->stats.rx_resyncs++;
+        esp_handle_uart_data(esp_dte, SIZE_MAX);
+        return;
+    }
+    if (esp_dte->parent.dce->mode != MODEM_PPP_MODE) {
+        /* the partial line before the gap is damaged */
+        size_t pending = esp_modem_line_framer_pending(&esp_dte->framer);
+        esp_dte->stats.rx_resync_dropped_bytes += pending;
+        esp_modem_line_framer_reset(&esp_dte->framer);
+        esp_dte->line_continued = false;
+    }
+    esp_dte->rx_resync = true;
+    esp_dte->stats.rx_resyncs++;
+    esp_handle_uart_data(esp_dte, SIZE_MAX);
 }
 
 /**
- * @brief Handle when a pattern has been detected by UART
+ * @brief Take the enqueue time of the next frame and update the TX latency statistics
  *
  * @param esp_dte ESP32 Modem DTE object
  */
-static void esp_handle_uart_pattern(esp_modem_dte_t *esp_dte)
+static void esp_dte_tx_account(esp_modem_dte_t *esp_dte)
 {
-    int pos = uart_pattern_pop_pos(esp_dte->uart_port);
-    int read_len = 0;
-
-    if (esp_dte->parent.dce->mode == MODEM_PPP_MODE) {
-        ESP_LOGW(MODEM_TAG, "Pattern event in PPP mode ignored");
-        // Ignore potential pattern detection events in PPP mode
-        // Note 1: the interrupt is disabled, but some events might still be pending
-        // Note 2: checking the mode *after* uart_pattern_pop_pos() to consume the event
+    int64_t enqueued;
+    if (xQueueReceive(esp_dte->tx_stamps, &enqueued, 0) != pdTRUE) {
         return;
     }
+    uint32_t latency = (uint32_t)(esp_timer_get_time() - enqueued);
+    esp_dte->stats.tx_latency_last_us = latency;
+    esp_dte->stats.tx_latency_total_us += latency;
+    if (latency > esp_dte->stats.tx_latency_max_us) {
+        esp_dte->stats.tx_latency_max_us = latency;
+    }
+}
 
-    if (pos != -1) {
-        if (pos < esp_dte->line_buffer_size - 1) {
-            /* read one line(include '\n') */
-            read_len = pos + 1;
-        } else {
-            ESP_LOGW(MODEM_TAG, "ESP Modem Line buffer too small");
-            read_len = esp_dte->line_buffer_size - 1;
-        }
-        read_len = uart_read_bytes(esp_dte->uart_port, esp_dte->buffer, read_len, pdMS_TO_TICKS(100));
-        if (read_len) {
-            /* make sure the line is a standard string */
-            esp_dte->buffer[read_len] = '\0';
-            /* Send new line to handle */
-            esp_dte_handle_line(esp_dte);
-        } else {
-            ESP_LOGE(MODEM_TAG, "uart read bytes failed");
+/**
+ * @brief Modem TX Task Entry
+ *
+ * Writes the queued PPP frames to the UART, gathering the frames queued back to back into one write.
+ *
+ * @param param task parameter
+ */
+static void tx_task_entry(void *param)
+{
+    esp_modem_dte_t *esp_dte = (esp_modem_dte_t *)param;
+    while (1) {
+        size_t len = xMessageBufferReceive(esp_dte->tx_queue, esp_dte->tx_staging, ESP_MODEM_TX_COALESCE_SIZE,
+                                           portMAX_DELAY);
+        if (len == 0) {
+            continue;
         }
-    } else {
-        size_t length = 0;
-        uart_get_buffered_data_len(esp_dte->uart_port, &length);
-        if (length) {
-            ESP_LOGD(MODEM_TAG, "Pattern not found in the pattern queue, uart data length = %d", length);
-            length = MIN(esp_dte->line_buffer_size-1, length);
-            length = uart_read_bytes(esp_dte->uart_port, esp_dte->buffer, length, portMAX_DELAY);
-            ESP_LOG_BUFFER_HEXDUMP("esp-modem-pattern: debug_data", esp_dte->buffer, length, ESP_LOG_DEBUG);
+        uint32_t frames = 1;
+        esp_dte_tx_account(esp_dte);
+        size_t next;
+        while ((next = xMessageBufferNextLengthBytes(esp_dte->tx_queue)) != 0 &&
+               len + next <= ESP_MODEM_TX_COALESCE_SIZE) {
+            len += xMessageBufferReceive(esp_dte->tx_queue, esp_dte->tx_staging + len,
+                                         ESP_MODEM_TX_COALESCE_SIZE - len, 0);
+            esp_dte_tx_account(esp_dte);
+            esp_dte->stats.tx_frames_coalesced++;
+            frames++;
         }
-        uart_flush(esp_dte->uart_port);
+        if (esp_dte->parent.cmux) {
+            esp_dte_cmux_write(esp_dte, ESP_MODEM_CMUX_DLCI_PPP, esp_dte->tx_staging, len,
+                               esp_dte->cmux_tx, ESP_MODEM_CMUX_TX_SIZE);
+        } else {
+            uart_write_bytes(esp_dte->uart_port, (const char *)esp_dte->tx_staging, len);
+        }
+        esp_dte->stats.tx_writes++;
+        esp_dte->stats.tx_bytes += len;
+        esp_dte->tx_done += frames;
     }
+    vTaskDelete(NULL);
 }
 
 /**
- * @brief Handle when new data received by UART
+ * @brief Queue a PPP frame for the TX task
+ *
+ * Never blocks: the frame is rejected if the queue is full, so that the caller (tcpip thread) sees the
+ * backpressure right away. Frames must be queued from a single task.
  *
  * @param esp_dte ESP32 Modem DTE object
+ * @param data frame data
+ * @param length length of data
+ * @return length on success, -1 if the frame has been rejected
  */
-static void esp_handle_uart_data(esp_modem_dte_t *esp_dte)
+static int esp_dte_tx_enqueue(esp_modem_dte_t *esp_dte, const char *data, uint32_t length)
 {
-   size_t length = 0;
-
-   if ( false == gEnableHandlingUartData )
-   {
-      ESP_LOGE(MODEM_TAG, "Discard Uart data too early ");
-      return;
-   }
-
-   if (esp_dte->parent.dce->mode == MODEM_COMMAND_MODE) {
-       ESP_LOGE(MODEM_TAG, "Error: Got data event in CMD mode");
-       /* pattern detection mode -> ignore date event on uart
-        * (should never happen, but if it does, we could still
-        * read the valid data once pattern detect event fired) */
-       return;
-   }
-
-   uart_get_buffered_data_len(esp_dte->uart_port, &length);
+    if (length > ESP_MODEM_TX_COALESCE_SIZE ||
+        xMessageBufferSpacesAvailable(esp_dte->tx_queue) < length + sizeof(size_t)) {
+        goto err_full;
+    }
+    int64_t now = esp_timer_get_time();
+    if (xQueueSend(esp_dte->tx_stamps, &now, 0) != pdTRUE) {
+        goto err_full;
+    }
+    /* single sender: the space checked above is still available */
+    xMessageBufferSend(esp_dte->tx_queue, data, length, 0);
+    esp_dte->tx_enqueued++;
+    esp_dte->stats.tx_frames++;
+    uint32_t depth = esp_dte->tx_enqueued - esp_dte->tx_done;
+    if (depth > esp_dte->stats.tx_queue_depth_max) {
+        esp_dte->stats.tx_queue_depth_max = depth;
+    }
+    return length;
+err_full:
+    esp_dte->stats.tx_frames_dropped++;
+    return -1;
+}
 
-    if (esp_dte->parent.dce->mode != MODEM_PPP_MODE && length) {
-        // Check if matches the pattern to process the data as pattern
-        int pos = uart_pattern_get_pos(esp_dte->uart_port);
-        if (pos > -1) {
-            esp_handle_uart_pattern(esp_dte);
-            return;
-        }
-        // Read the data and process it using `handle_line` logic
-        length = MIN(esp_dte->line_buffer_size-1, length);
-        length = uart_read_bytes(esp_dte->uart_port, esp_dte->buffer, length, portMAX_DELAY);
-        esp_dte->buffer[length] = '\0';
-        if (strchr((char*)esp_dte->buffer, '\n') == NULL) {
-            size_t max = esp_dte->line_buffer_size-1;
-            size_t bytes;
-            // if pattern not found in the data,
-            // continue reading as long as the modem is in MODEM_STATE_PROCESSING, checking for the pattern
-            while (length < max && esp_dte->buffer[length-1] != '\n' &&
-                   esp_dte->parent.dce->state == MODEM_STATE_PROCESSING) {
-                bytes = uart_read_bytes(esp_dte->uart_port,
-                                        esp_dte->buffer + length, 1, pdMS_TO_TICKS(100));
-                length += bytes;
-                ESP_LOGV("esp-modem: debug_data", "Continuous read in non-data mode: length: %d char: %x", length, esp_dte->buffer[length-1]);
-            }
-            esp_dte->buffer[length] = '\0';
-        }
-        ESP_LOG_BUFFER_HEXDUMP("esp-modem: debug_data", esp_dte->buffer, length, ESP_LOG_DEBUG);
-        if (esp_dte->parent.dce->handle_line) {
-            /* Send new line to handle if handler registered */
-            esp_dte_handle_line(esp_dte);
+/**
+ * @brief Wait until the queued PPP frames have been written to the UART
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param timeout_ms max wait
+ */
+static void esp_dte_tx_drain(esp_modem_dte_t *esp_dte, uint32_t timeout_ms)
+{
+    TickType_t start = xTaskGetTickCount();
+    while (esp_dte->tx_queue && esp_dte->tx_done != esp_dte->tx_enqueued) {
+        if (xTaskGetTickCount() - start > pdMS_TO_TICKS(timeout_ms)) {
+            ESP_LOGW(MODEM_TAG, "TX queue not drained");
+            break;
         }
-        return;
+        vTaskDelay(1);
     }
+}
 
-    length = MIN(esp_dte->line_buffer_size, length);
-    length = uart_read_bytes(esp_dte->uart_port, esp_dte->buffer, length, portMAX_DELAY);
-    /* pass the input data to configured callback */
-    if (length) {
-        esp_dte->receive_cb(esp_dte->buffer, length, esp_dte->receive_cb_ctx);
+/**
+ * @brief Modem Event Loop Task Entry
+ *
+ * Runs the modem event loop whenever an event has been posted, so that the UART event task
+ * neither delays the events nor gets stalled by slow event handlers.
+ *
+ * @param param task parameter
+ */
+static void event_loop_task_entry(void *param)
+{
+    esp_modem_dte_t *esp_dte = (esp_modem_dte_t *)param;
+    bool drained = true;
+    while (1) {
+        /* events left in the ring are posted again once the loop has made room */
+        ulTaskNotifyTake(pdTRUE, drained ? portMAX_DELAY : pdMS_TO_TICKS(10));
+        drained = esp_modem_drain_events(esp_dte);
+        esp_event_loop_run(esp_dte->event_loop_hdl, pdMS_TO_TICKS(0));
     }
+    vTaskDelete(NULL);
 }
 
 /**
@@ -251,46 +1265,72 @@ static void uart_event_task_entry(void *param)
 {
     esp_modem_dte_t *esp_dte = (esp_modem_dte_t *)param;
     uart_event_t event;
+    /* Without event loop task, wake up regularly to drive the event loop */
+    TickType_t wait = esp_dte->event_loop_task_hdl ? portMAX_DELAY : pdMS_TO_TICKS(100);
     while (1) {
-        /* Drive the event loop */
-        esp_event_loop_run(esp_dte->event_loop_hdl, pdMS_TO_TICKS(0));
+        if (esp_dte->event_loop_task_hdl == NULL) {
+            /* Drive the event loop */
+            esp_modem_drain_events(esp_dte);
+            esp_event_loop_run(esp_dte->event_loop_hdl, pdMS_TO_TICKS(0));
+        }
 
         /* Process UART events */
-        if (xQueueReceive(esp_dte->event_queue, &event, pdMS_TO_TICKS(100))) {
+        if (xQueueReceive(esp_dte->event_queue, &event, wait)) {
             if (esp_dte->parent.dce == NULL) {
                 ESP_LOGD(MODEM_TAG, "Ignore UART event for DTE with no DCE attached");
                 // No action on any uart event with null DCE.
                 // This might happen before DCE gets initialized and attached to running DTE,
                 // or after destroying the DCE when DTE is up and gets a data event.
-                uart_flush(esp_dte->uart_port);
+                esp_dte_flush_input(esp_dte);
                 continue;
             }
 
             switch (event.type) {
             case UART_DATA:
-                esp_handle_uart_data(esp_dte);
+                esp_dte->rx_announced += event.size;
+                esp_handle_uart_data(esp_dte, SIZE_MAX);
                 break;
             case UART_FIFO_OVF:
                 ESP_LOGW(MODEM_TAG, "HW FIFO Overflow");
+                esp_dte->stats.rx_fifo_overflows++;
+                if (esp_dte->rx_overflow_resync) {
+                    esp_handle_uart_overflow(esp_dte);
+                    break;
+                }
                 uart_flush_input(esp_dte->uart_port);
                 xQueueReset(esp_dte->event_queue);
+                esp_dte->rx_read = esp_dte->rx_announced;
                 break;
             case UART_BUFFER_FULL:
                 ESP_LOGW(MODEM_TAG, "Ring Buffer Full");
+                esp_dte->stats.rx_buffer_full++;
+                /* the driver holds the data back until there is room again, nothing is lost yet */
+                esp_dte->rx_announced += event.size;
+                if (esp_dte->rx_overflow_resync) {
+                    esp_handle_uart_data(esp_dte, SIZE_MAX);
+                    break;
+                }
                 uart_flush_input(esp_dte->uart_port);
                 xQueueReset(esp_dte->event_queue);
+                esp_dte->rx_read = esp_dte->rx_announced;
                 break;
             case UART_BREAK:
                 ESP_LOGW(MODEM_TAG, "Rx Break");
+                esp_dte->stats.rx_breaks++;
                 break;
             case UART_PARITY_ERR:
                 ESP_LOGE(MODEM_TAG, "Parity Error");
+                esp_dte->stats.rx_parity_errors++;
                 break;
             case UART_FRAME_ERR:
                 ESP_LOGE(MODEM_TAG, "Frame Error");
+                esp_dte->stats.rx_frame_errors++;
                 break;
             case UART_PATTERN_DET:
-                esp_handle_uart_pattern(esp_dte);
+                /* lines are framed in software, just consume the pattern position */
+                uart_pattern_pop_pos(esp_dte->uart_port);
+                esp_dte->rx_announced += event.size;
+                esp_handle_uart_data(esp_dte, SIZE_MAX);
                 break;
             default:
                 ESP_LOGW(MODEM_TAG, "unknown uart event type: %d", event.type);
@@ -302,33 +1342,91 @@ static void uart_event_task_entry(void *param)
 }
 
 /**
- * @brief Send command to DCE
+ * @brief Run one command: send it (or pulse DTR) and wait for the DCE handler to complete it
  *
- * @param dte Modem DTE object
- * @param command command string
+ * The completion left by a late answer to a previous command is dropped before the command is sent,
+ * so that an answer arriving right after the send is not lost.
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param command command string, NULL to pulse DTR instead
+ * @param dtr_off_ms time DTR stays off, without command
  * @param timeout timeout value, unit: ms
  * @return esp_err_t
  *      - ESP_OK on success
  *      - ESP_FAIL on error
  */
-static esp_err_t esp_modem_dte_send_cmd(modem_dte_t *dte, const char *command, uint32_t timeout)
+static esp_err_t esp_dte_run_command(esp_modem_dte_t *esp_dte, const char *command, uint32_t dtr_off_ms,
+                                     uint32_t timeout)
 {
     esp_err_t ret = ESP_FAIL;
-    modem_dce_t *dce = dte->dce;
-    MODEM_CHECK(dce, "DTE has not yet bind with DCE", err);
-    MODEM_CHECK(command, "command is NULL", err);
-    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
-    /* Calculate timeout clock tick */
+    modem_dce_t *dce = esp_dte->parent.dce;
+    const char *name = command ? command : "DTR";
+    /* a single command if the caller did not open a transaction */
+    MODEM_CHECK(esp_modem_arbiter_acquire(&esp_dte->arbiter, ESP_MODEM_CMD_PRIORITY_NORMAL, timeout) == ESP_OK,
+                "command arbiter busy", err_acquire);
+    /* Drop a completion left by a late answer to a previous command */
+    xSemaphoreTake(esp_dte->process_sem, 0);
+    MODEM_CHECK(esp_modem_arbiter_begin_command(&esp_dte->arbiter), "preempted, [%s] not sent", err, name);
+    int latency_index = -1;
+    uint32_t effective = timeout;
+    if (command) {
+        effective = esp_modem_latency_timeout(&esp_dte->latency, command, timeout, &latency_index);
+    }
     /* Reset runtime information */
     dce->state = MODEM_STATE_PROCESSING;
-    /* Send command via UART */
-    uart_write_bytes(esp_dte->uart_port, command, strlen(command));
+    if (command) {
+        /* Send command via UART */
+        esp_dte_write(esp_dte, esp_dte->cmux_cmd_dlci, command, strlen(command));
+    } else if (esp_dte->parent.cmux) {
+        /* the physical DTR belongs to the multiplexer, the PPP channel gets the pulse */
+        esp_dte_cmux_signals(esp_dte, ESP_MODEM_CMUX_DLCI_PPP, false);
+        vTaskDelay(pdMS_TO_TICKS(dtr_off_ms));
+        esp_dte_cmux_signals(esp_dte, ESP_MODEM_CMUX_DLCI_PPP, true);
+    } else {
+        esp_modem_dtr_pulse(esp_dte->dtr_io_num, dtr_off_ms);
+    }
+    int64_t sent = esp_timer_get_time();
     /* Check timeout */
-    MODEM_CHECK(xSemaphoreTake(esp_dte->process_sem, pdMS_TO_TICKS(timeout)) == pdTRUE, "process command timeout", err);
+    bool answered = xSemaphoreTake(esp_dte->process_sem, pdMS_TO_TICKS(effective)) == pdTRUE;
+    bool completed = esp_modem_arbiter_end_command(&esp_dte->arbiter);
+    MODEM_CHECK(completed, "preempted, [%s] aborted", err, name);
+    esp_modem_latency_record(&esp_dte->latency, latency_index, (esp_timer_get_time() - sent) / 1000, answered);
+    MODEM_CHECK(answered, "process command timeout (%u ms)", err, effective);
     ret = ESP_OK;
 err:
-    dce->handle_line = NULL;
+    if (ret != ESP_OK) {
+        dce->state = MODEM_STATE_FAIL;
+    }
+    esp_dte_clear_handlers(esp_dte, dce);
+    esp_modem_arbiter_release(&esp_dte->arbiter);
     return ret;
+err_acquire:
+    /* another task holds the arbiter: its handlers and the DCE state belong to its command */
+    return ret;
+}
+
+/**
+ * @brief Send command to DCE
+ *
+ * @param dte Modem DTE object
+ * @param command command string
+ * @param timeout timeout value, unit: ms
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t esp_modem_dte_send_cmd(modem_dte_t *dte, const char *command, uint32_t timeout)
+{
+    modem_dce_t *dce = dte->dce;
+    MODEM_CHECK(dce, "DTE has not yet bind with DCE", err_param);
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    MODEM_CHECK(command, "command is NULL", err);
+    return esp_dte_run_command(esp_dte, command, 0, timeout);
+err:
+    dce->state = MODEM_STATE_FAIL;
+    esp_dte_clear_handlers(esp_dte, dce);
+err_param:
+    return ESP_FAIL;
 }
 
 /**
@@ -347,7 +1445,13 @@ static int esp_modem_dte_send_data(modem_dte_t *dte, const char *data, uint32_t
         ESP_LOGD(MODEM_TAG, "Not sending data in transition mode");
         return -1;
     }
-    return uart_write_bytes(esp_dte->uart_port, data, length);
+    if (esp_dte->parent.dce->mode == MODEM_PPP_MODE) {
+        if (esp_dte->tx_queue) {
+            return esp_dte_tx_enqueue(esp_dte, data, length);
+        }
+        return esp_dte_write(esp_dte, ESP_MODEM_CMUX_DLCI_PPP, data, length);
+    }
+    return esp_dte_write(esp_dte, esp_dte->cmux_cmd_dlci, data, length);
 err:
     return -1;
 }
@@ -372,22 +1476,24 @@ static esp_err_t esp_modem_dte_send_wait(modem_dte_t *dte, const char *data, uin
     MODEM_CHECK(data, "data is NULL", err_param);
     MODEM_CHECK(prompt, "prompt is NULL", err_param);
     esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
-    // We'd better disable pattern detection here for a moment in case prompt string contains the pattern character
-    uart_disable_pattern_det_intr(esp_dte->uart_port);
-    // uart_disable_rx_intr(esp_dte->uart_port);
-    MODEM_CHECK(uart_write_bytes(esp_dte->uart_port, data, length) >= 0, "uart write bytes failed", err_write);
-    uint32_t len = strlen(prompt);
-    uint8_t *buffer = calloc(len + 1, sizeof(uint8_t));
-    int res = uart_read_bytes(esp_dte->uart_port, buffer, len, pdMS_TO_TICKS(timeout));
-    MODEM_CHECK(res >= len, "wait prompt [%s] timeout", err, prompt);
-    MODEM_CHECK(!strncmp(prompt, (const char *)buffer, len), "get wrong prompt: %s", err, buffer);
-    free(buffer);
-    uart_enable_pattern_det_baud_intr(esp_dte->uart_port, '\n', 1, MIN_PATTERN_INTERVAL, MIN_POST_IDLE, MIN_PRE_IDLE);
+    MODEM_CHECK(esp_modem_arbiter_acquire(&esp_dte->arbiter, ESP_MODEM_CMD_PRIORITY_NORMAL, timeout) == ESP_OK,
+                "command arbiter busy", err_param);
+    xSemaphoreTake(esp_dte->process_sem, 0);
+    MODEM_CHECK(esp_modem_arbiter_begin_command(&esp_dte->arbiter), "preempted, data not sent", err_arbiter);
+    // The prompt is not terminated by a line end, let the line framer look for it
+    esp_dte->prompt = prompt;
+    MODEM_CHECK(esp_dte_write(esp_dte, esp_dte->cmux_cmd_dlci, data, length) >= 0, "uart write bytes failed", err);
+    bool answered = xSemaphoreTake(esp_dte->process_sem, pdMS_TO_TICKS(timeout)) == pdTRUE;
+    MODEM_CHECK(esp_modem_arbiter_end_command(&esp_dte->arbiter), "preempted, wait prompt [%s] aborted", err_arbiter,
+                prompt);
+    MODEM_CHECK(answered, "wait prompt [%s] timeout", err_arbiter, prompt);
+    esp_modem_arbiter_release(&esp_dte->arbiter);
     return ESP_OK;
 err:
-    free(buffer);
-err_write:
-    uart_enable_pattern_det_baud_intr(esp_dte->uart_port, '\n', 1, MIN_PATTERN_INTERVAL, MIN_POST_IDLE, MIN_PRE_IDLE);
+    esp_modem_arbiter_end_command(&esp_dte->arbiter);
+err_arbiter:
+    esp_dte->prompt = NULL;
+    esp_modem_arbiter_release(&esp_dte->arbiter);
 err_param:
     return ESP_FAIL;
 }
@@ -410,26 +1516,29 @@ static esp_err_t esp_modem_dte_change_mode(modem_dte_t *dte, modem_mode_t new_mo
     MODEM_CHECK(current_mode != new_mode, "already in mode: %d", err, new_mode);
     dce->mode = MODEM_TRANSITION_MODE;  // mode switching will be finished in set_working_mode() on success
                                         // (or restored on failure)
+    /* while multiplexing, the data call is dialed and left on the PPP channel */
+    esp_dte->cmux_cmd_dlci = ESP_MODEM_CMUX_DLCI_PPP;
     switch (new_mode) {
     case MODEM_PPP_MODE:
+        esp_modem_hdlc_decoder_reset(&esp_dte->hdlc);
         MODEM_CHECK(dce->set_working_mode(dce, new_mode) == ESP_OK, "set new working mode:%d failed", err_restore_mode, new_mode);
-        uart_disable_pattern_det_intr(esp_dte->uart_port);
-        uart_enable_rx_intr(esp_dte->uart_port);
         break;
     case MODEM_COMMAND_MODE:
+        /* the PPP frames still queued go out before the escape sequence */
+        esp_dte_tx_drain(esp_dte, ESP_MODEM_TX_DRAIN_TIMEOUT_MS);
         MODEM_CHECK(dce->set_working_mode(dce, new_mode) == ESP_OK, "set new working mode:%d failed", err_restore_mode, new_mode);
-        uart_disable_rx_intr(esp_dte->uart_port);
-        uart_flush(esp_dte->uart_port);
-        //uart_enable_pattern_det_baud_intr(esp_dte->uart_port, '\n', 1, MIN_PATTERN_INTERVAL, MIN_POST_IDLE, MIN_PRE_IDLE);
-        uart_enable_pattern_det_intr(esp_dte->uart_port, '\n', 1, MIN_PATTERN_INTERVAL, MIN_POST_IDLE, MIN_PRE_IDLE);
-        uart_pattern_queue_reset(esp_dte->uart_port, esp_dte->pattern_queue_size);
+        if (!dte->cmux) {
+            esp_dte_flush_input(esp_dte);
+        }
         break;
     default:
         break;
     }
+    esp_dte->cmux_cmd_dlci = ESP_MODEM_CMUX_DLCI_AT;
     return ESP_OK;
 err_restore_mode:
     dce->mode = current_mode;
+    esp_dte->cmux_cmd_dlci = ESP_MODEM_CMUX_DLCI_AT;
 err:
     return ESP_FAIL;
 }
@@ -447,6 +1556,74 @@ err:
    return ESP_FAIL;
 }
 
+/**
+ * @brief Turn DTR off then on again, which makes the DCE leave the data mode (AT&D1/AT&D2), and wait for its answer
+ *
+ * The pulse is given in the same window as a command, after handle_line is set by the caller: the result code
+ * sent by the DCE right after the pulse is handled like the answer to a command.
+ * While multiplexing, the physical DTR belongs to the multiplexer: the PPP channel gets the pulse
+ * through modem status commands instead.
+ *
+ * @param dte Modem DTE object
+ * @param duration_ms time DTR stays off
+ * @param timeout timeout value, unit: ms
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_NOT_SUPPORTED if DTR is not wired (handle_line is left as is)
+ *      - ESP_FAIL on error
+ */
+static esp_err_t esp_modem_dte_send_dtr_escape(modem_dte_t *dte, uint32_t duration_ms, uint32_t timeout)
+{
+    MODEM_CHECK(dte->dce, "DTE has not yet bind with DCE", err);
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    if (!dte->cmux && esp_dte->dtr_io_num < 0) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    return esp_dte_run_command(esp_dte, NULL, duration_ms, timeout);
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Take the command arbiter for a transaction
+ *
+ * @param dte Modem DTE object
+ * @param priority class of the transaction
+ * @param timeout_ms max queueing delay
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_TIMEOUT if not granted in time
+ */
+static esp_err_t esp_modem_dte_acquire(modem_dte_t *dte, esp_modem_cmd_priority_t priority, uint32_t timeout_ms)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    return esp_modem_arbiter_acquire(&esp_dte->arbiter, priority, timeout_ms);
+}
+
+/**
+ * @brief Give the command arbiter back
+ *
+ * @param dte Modem DTE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if the calling task does not hold the arbiter
+ */
+static esp_err_t esp_modem_dte_release(modem_dte_t *dte)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    return esp_modem_arbiter_release(&esp_dte->arbiter);
+}
+
+/**
+ * @brief Release the sender of the command aborted by an emergency transaction
+ */
+static void esp_dte_abort_command(void *context)
+{
+    esp_modem_dte_t *esp_dte = context;
+    esp_dte->prompt = NULL;
+    xSemaphoreGive(esp_dte->process_sem);
+}
+
 static esp_err_t esp_modem_dte_process_cmd_done(modem_dte_t *dte)
 {
     esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
@@ -466,19 +1643,43 @@ static esp_err_t esp_modem_dte_deinit(modem_dte_t *dte)
     esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
     /* Delete UART event task */
     vTaskDelete(esp_dte->uart_event_task_hdl);
+    /* Delete event loop task */
+    if (esp_dte->event_loop_task_hdl) {
+        vTaskDelete(esp_dte->event_loop_task_hdl);
+    }
+    /* Delete TX task and queue */
+    if (esp_dte->tx_task_hdl) {
+        vTaskDelete(esp_dte->tx_task_hdl);
+        vQueueDelete(esp_dte->tx_stamps);
+        vMessageBufferDelete(esp_dte->tx_queue);
+        esp_modem_arena_free(esp_dte->arena, esp_dte->tx_staging);
+    }
+    /* Release DTR */
+    esp_modem_dtr_deinit(esp_dte->dtr_io_num);
+    /* Delete multiplexer resources */
+    if (esp_dte->cmux_events) {
+        vEventGroupDelete(esp_dte->cmux_events);
+    }
+    esp_modem_arena_free(esp_dte->arena, esp_dte->cmux_tx);
+    esp_modem_arena_free(esp_dte->arena, esp_dte->cmux_line_ring);
     /* Delete semaphores */
     vSemaphoreDelete(esp_dte->process_sem);
     vSemaphoreDelete(esp_dte->exit_sem);
+    vSemaphoreDelete(esp_dte->handler_lock);
     /* Delete event loop */
     esp_event_loop_delete(esp_dte->event_loop_hdl);
     /* Uninstall UART Driver */
     uart_driver_delete(esp_dte->uart_port);
     /* Free memory */
-    free(esp_dte->buffer);
+    esp_modem_arena_t *arena = esp_dte->arena;
+    esp_modem_arena_free(arena, esp_dte->rx_buffer);
+    esp_modem_arena_free(arena, esp_dte->event_ring_storage);
+    esp_modem_arena_free(arena, esp_dte->line_ring);
+    esp_modem_arena_free(arena, esp_dte->buffer);
     if (dte->dce) {
         dte->dce->dte = NULL;
     }
-    free(esp_dte);
+    esp_modem_arena_free(arena, esp_dte);
     return ESP_OK;
 }
 
@@ -487,36 +1688,86 @@ static esp_err_t esp_modem_dte_deinit(modem_dte_t *dte)
 modem_dte_t *esp_modem_dte_init(const esp_modem_dte_config_t *config)
 {
    esp_err_t res;
+   BaseType_t ret;
    DrvNvs_element_t *pDrvNvs_baudrate;
    pDrvNvs_baudrate = DrvNvs_GetElement( DRVNVS_FACTORY_PARAMS_ID, DRVNVS_F_LTE_BAUDRATE_ID );
 
+   esp_modem_timeline_reset();
+   esp_modem_timeline_mark(ESP_MODEM_MILESTONE_DTE_INIT_START);
+
    /* malloc memory for esp_dte object */
-   //esp_modem_dte_t *esp_dte = calloc( 1, sizeof(esp_modem_dte_t) );
-   esp_modem_dte_t *esp_dte = heap_caps_malloc( sizeof(esp_modem_dte_t), MALLOC_CAP_SPIRAM);
+   esp_modem_dte_t *esp_dte = esp_modem_alloc( config->arena, sizeof(esp_modem_dte_t), config->placement.dte_caps, "dte" );
    MODEM_CHECK( esp_dte, "calloc esp_dte failed", err_dte_mem );
+   memset( esp_dte, 0, sizeof(esp_modem_dte_t) );
+   esp_dte->arena = config->arena;
+   esp_dte_record_buffer( esp_dte, &esp_dte->footprint.dte, "dte", esp_dte, sizeof(esp_modem_dte_t),
+                          config->placement.dte_caps );
+   esp_dte->placement = config->placement;
+   portMUX_INITIALIZE( &esp_dte->urc_lock );
 
    /* malloc memory to storing lines from modem dce */
    esp_dte->line_buffer_size = config->line_buffer_size;
-   //esp_dte->buffer = calloc(1, config->line_buffer_size);
-   esp_dte->buffer = heap_caps_malloc( config->line_buffer_size, MALLOC_CAP_SPIRAM);
+   /* lines are published in place, with room for the post time kept after them in the event ring */
+   esp_dte->buffer = esp_dte_alloc( esp_dte, &esp_dte->footprint.line, "line",
+                                    config->line_buffer_size + ESP_MODEM_EVENT_STAMP_SIZE, config->placement.line_caps );
    MODEM_CHECK( esp_dte->buffer, "calloc line memory failed", err_line_mem );
 
+   /* malloc memory for the line framer */
+   size_t ring_size = esp_dte_line_ring_size( config->line_buffer_size );
+   esp_dte->line_ring = esp_dte_alloc( esp_dte, &esp_dte->footprint.line_ring, "line_ring", ring_size,
+                                       config->placement.line_caps );
+   MODEM_CHECK( esp_dte->line_ring, "calloc line ring memory failed", err_ring_mem );
+   MODEM_CHECK( esp_modem_line_framer_init( &esp_dte->framer, esp_dte->line_ring, ring_size, (char *)esp_dte->buffer,
+                                            config->line_buffer_size, esp_dte_handle_segment, esp_dte ),
+                "init line framer failed", err_rx_mem );
+
+   /* malloc memory to storing PPP data from modem dce */
+   esp_dte->ppp_rx_chunk_size = config->ppp_rx_chunk_size;
+   esp_dte->rx_buffer = esp_dte_alloc( esp_dte, &esp_dte->footprint.ppp_rx, "ppp_rx", config->ppp_rx_chunk_size,
+                                       config->placement.rx_caps );
+   MODEM_CHECK( esp_dte->rx_buffer, "calloc rx memory failed", err_rx_mem );
+
+   /* malloc memory for the events published by the UART event task, one line each at most */
+   size_t slot_size = config->line_buffer_size + ESP_MODEM_EVENT_STAMP_SIZE;
+   esp_dte->event_ring_storage = esp_dte_alloc( esp_dte, &esp_dte->footprint.event_ring, "event_ring",
+                                                ESP_MODEM_EVENT_RING_STORAGE_SIZE( config->event_ring_slots, slot_size ),
+                                                config->placement.event_caps );
+   MODEM_CHECK( esp_dte->event_ring_storage, "calloc event ring memory failed", err_event_ring_mem );
+   MODEM_CHECK( esp_modem_event_ring_init( &esp_dte->event_ring, esp_dte->event_ring_storage, config->event_ring_slots,
+                                           slot_size ),
+                "init event ring failed", err_uart_config );
+
    /* Set attributes */
    esp_dte->uart_port = config->port_num;
    esp_dte->parent.flow_ctrl = config->flow_control;
+   esp_dte->rx_zero_copy = config->rx_zero_copy;
+   esp_dte->rx_overflow_resync = config->rx_overflow_resync;
+   esp_dte->ppp_rx_framing = config->ppp_rx_framing;
+   const esp_modem_hdlc_frame_ops_t frame_ops = {
+       .get = esp_dte_get_frame,
+       .deliver = esp_dte_deliver_frame,
+       .drop = esp_dte_drop_frame,
+       .context = esp_dte
+   };
+   esp_modem_hdlc_decoder_init(&esp_dte->hdlc, &frame_ops, ESP_MODEM_PPP_MRU);
+   esp_dte->cmux_cmd_dlci = ESP_MODEM_CMUX_DLCI_AT;
 
    /* Bind methods */
    esp_dte->parent.send_cmd = esp_modem_dte_send_cmd;
    esp_dte->parent.send_data = esp_modem_dte_send_data;
    esp_dte->parent.send_wait = esp_modem_dte_send_wait;
+   esp_dte->parent.acquire = esp_modem_dte_acquire;
+   esp_dte->parent.release = esp_modem_dte_release;
    esp_dte->parent.change_dte_baudrate = esp_modem_dte_change_baudrate;
    esp_dte->parent.change_mode = esp_modem_dte_change_mode;
+   esp_dte->parent.send_dtr_escape = esp_modem_dte_send_dtr_escape;
    esp_dte->parent.process_cmd_done = esp_modem_dte_process_cmd_done;
    esp_dte->parent.deinit = esp_modem_dte_deinit;
 
     /* Config UART */
    uart_config_t uart_config = {
-        .baud_rate = *(uint32_t*)pDrvNvs_baudrate->handler,
+        /* rate the module was last configured to, the DCE finds it again if they disagree */
+        .baud_rate = *(uint32_t*)pDrvNvs_baudrate->handler ? *(uint32_t*)pDrvNvs_baudrate->handler : config->baud_rate,
         .data_bits = config->data_bits,
         .parity = config->parity,
         .stop_bits = config->stop_bits,
@@ -544,6 +1795,9 @@ modem_dte_t *esp_modem_dte_init(const esp_modem_dte_config_t *config)
         res = uart_set_sw_flow_ctrl(esp_dte->uart_port, true, 8, UART_FIFO_LEN - 8);
     }
     MODEM_CHECK(res == ESP_OK, "config uart flow control failed", err_uart_config);
+    /* DTR is driven as a GPIO, on (low) while the DTE is up */
+    esp_dte->dtr_io_num = config->dtr_io_num;
+    MODEM_CHECK(esp_modem_dtr_init(config->dtr_io_num) == ESP_OK, "config dtr gpio failed", err_uart_config);
     /* Install UART driver and get event queue used inside driver */
     res = uart_driver_install(esp_dte->uart_port, config->rx_buffer_size, config->tx_buffer_size,
                               config->event_queue_size, &(esp_dte->event_queue), ESP_INTR_FLAG_IRAM);
@@ -551,31 +1805,52 @@ modem_dte_t *esp_modem_dte_init(const esp_modem_dte_config_t *config)
     res = uart_set_rx_timeout(esp_dte->uart_port, 1);
     MODEM_CHECK(res == ESP_OK, "set rx timeout failed", err_uart_config);
 
-    /* Set pattern interrupt, used to detect the end of a line. */
-//    res = uart_enable_pattern_det_baud_intr(esp_dte->uart_port, '\n', 1, MIN_PATTERN_INTERVAL, MIN_POST_IDLE, MIN_PRE_IDLE);
-    res = uart_enable_pattern_det_intr(esp_dte->uart_port, '\n', 1, MIN_PATTERN_INTERVAL, MIN_POST_IDLE, MIN_PRE_IDLE);
-
-    /* Set pattern queue size */
-    esp_dte->pattern_queue_size = config->pattern_queue_size;
-    res |= uart_pattern_queue_reset(esp_dte->uart_port, config->pattern_queue_size);
-    /* Starting in command mode -> explicitly disable RX interrupt */
-    uart_disable_rx_intr(esp_dte->uart_port);
-
-    MODEM_CHECK(res == ESP_OK, "config uart pattern failed", err_uart_pattern);
+    /* Lines are framed in software in all modes, RX interrupt stays enabled */
+    res = uart_enable_rx_intr(esp_dte->uart_port);
+    MODEM_CHECK(res == ESP_OK, "enable rx interrupt failed", err_uart_intr);
     /* Create Event loop */
     esp_event_loop_args_t loop_args = {
         .queue_size = ESP_MODEM_EVENT_QUEUE_SIZE,
         .task_name = NULL
     };
     MODEM_CHECK(esp_event_loop_create(&loop_args, &esp_dte->event_loop_hdl) == ESP_OK, "create event loop failed", err_eloop);
+    MODEM_CHECK(esp_event_handler_register_with(esp_dte->event_loop_hdl, ESP_MODEM_EVENT, ESP_EVENT_ANY_ID,
+                                                esp_modem_on_event_dispatch, esp_dte) == ESP_OK,
+                "register event dispatch handler failed", err_sem1);
     /* Create semaphore */
     esp_dte->process_sem = xSemaphoreCreateBinary();
     MODEM_CHECK(esp_dte->process_sem, "create process semaphore failed", err_sem1);
+    esp_dte->handler_lock = xSemaphoreCreateMutex();
+    MODEM_CHECK(esp_dte->handler_lock, "create handler lock failed", err_sem);
+    esp_modem_arbiter_init(&esp_dte->arbiter, esp_dte_abort_command, esp_dte);
+    esp_modem_latency_init(&esp_dte->latency, config->adaptive_timeouts, MODEM_COMMAND_TIMEOUT_MIN,
+                           MODEM_COMMAND_TIMEOUT_LIMIT);
     esp_dte->exit_sem = xSemaphoreCreateBinary();
     MODEM_CHECK(esp_dte->exit_sem, "create exit semaphore failed", err_sem);
 
+    /* Create TX task */
+    if (config->tx_queue_size) {
+        esp_dte->tx_staging = esp_dte_alloc(esp_dte, &esp_dte->footprint.tx_staging, "tx_staging",
+                                            ESP_MODEM_TX_COALESCE_SIZE, config->placement.tx_caps);
+        MODEM_CHECK(esp_dte->tx_staging, "alloc tx staging buffer failed", err_tx_mem);
+        esp_dte->tx_queue = xMessageBufferCreate(config->tx_queue_size);
+        MODEM_CHECK(esp_dte->tx_queue, "create tx queue failed", err_tx_queue);
+        esp_dte->tx_stamps = xQueueCreate(ESP_MODEM_TX_QUEUE_FRAMES, sizeof(int64_t));
+        MODEM_CHECK(esp_dte->tx_stamps, "create tx stamp queue failed", err_tx_stamps);
+        ret = xTaskCreate(tx_task_entry, "modem_tx", config->tx_task_stack_size,
+                          esp_dte, config->tx_task_priority, &(esp_dte->tx_task_hdl));
+        MODEM_CHECK(ret == pdTRUE, "create modem tx task failed", err_tx_tsk_create);
+    }
+
+    /* Create event loop task, before the UART event task which checks for it */
+    if (config->event_loop_task_stack_size) {
+        ret = xTaskCreate(event_loop_task_entry, "modem_event", config->event_loop_task_stack_size,
+                          esp_dte, config->event_loop_task_priority, &(esp_dte->event_loop_task_hdl));
+        MODEM_CHECK(ret == pdTRUE, "create modem event task failed", err_loop_tsk_create);
+    }
+
     /* Create UART Event task */
-    BaseType_t ret = xTaskCreate(uart_event_task_entry,             //Task Entry
+    ret = xTaskCreate(uart_event_task_entry,             //Task Entry
                                  "uart_event",              //Task Name
                                  config->event_task_stack_size,           //Task Stack Size(Bytes)
                                  esp_dte,                           //Task Parameter
@@ -583,22 +1858,71 @@ modem_dte_t *esp_modem_dte_init(const esp_modem_dte_config_t *config)
                                  & (esp_dte->uart_event_task_hdl)   //Task Handler
                                 );
     MODEM_CHECK(ret == pdTRUE, "create uart event task failed", err_tsk_create);
+    if (esp_dte->arena) {
+        /* multiplexer resources are taken now rather than when the multiplexer starts */
+        esp_dte->cmux_events = xEventGroupCreate();
+        MODEM_CHECK(esp_dte->cmux_events, "create cmux event group failed", err_cmux);
+        if (esp_dte->tx_queue) {
+            esp_dte->cmux_tx = esp_dte_alloc(esp_dte, &esp_dte->footprint.cmux_tx, "cmux_tx", ESP_MODEM_CMUX_TX_SIZE,
+                                             esp_dte->placement.tx_caps);
+            MODEM_CHECK(esp_dte->cmux_tx, "alloc cmux tx buffer failed", err_cmux);
+        }
+        esp_dte->cmux_line_ring = esp_dte_alloc(esp_dte, &esp_dte->footprint.cmux_line_ring, "cmux_ring",
+                                                esp_dte_line_ring_size(esp_dte->line_buffer_size),
+                                                esp_dte->placement.line_caps);
+        MODEM_CHECK(esp_dte->cmux_line_ring, "alloc cmux line ring failed", err_cmux);
+        ESP_LOGI(MODEM_TAG, "arena: %u of %u bytes used", esp_dte->arena->used, esp_dte->arena->size);
+    }
+    ESP_LOGI(MODEM_TAG, "dte memory: %u bytes internal, %u bytes SPIRAM",
+             esp_dte->footprint.internal_bytes, esp_dte->footprint.external_bytes);
+    esp_modem_timeline_mark(ESP_MODEM_MILESTONE_DTE_INIT_DONE);
     return &(esp_dte->parent);
     /* Error handling */
+err_cmux:
+    if (esp_dte->cmux_events) {
+        vEventGroupDelete(esp_dte->cmux_events);
+    }
+    vTaskDelete(esp_dte->uart_event_task_hdl);
 err_tsk_create:
+    if (esp_dte->event_loop_task_hdl) {
+        vTaskDelete(esp_dte->event_loop_task_hdl);
+    }
+err_loop_tsk_create:
+    if (esp_dte->tx_task_hdl) {
+        vTaskDelete(esp_dte->tx_task_hdl);
+    }
+err_tx_tsk_create:
+    if (esp_dte->tx_stamps) {
+        vQueueDelete(esp_dte->tx_stamps);
+    }
+err_tx_stamps:
+    if (esp_dte->tx_queue) {
+        vMessageBufferDelete(esp_dte->tx_queue);
+    }
+err_tx_queue:
+    esp_modem_arena_free(esp_dte->arena, esp_dte->tx_staging);
+err_tx_mem:
     vSemaphoreDelete(esp_dte->exit_sem);
 err_sem:
+    if (esp_dte->handler_lock) {
+        vSemaphoreDelete(esp_dte->handler_lock);
+    }
     vSemaphoreDelete(esp_dte->process_sem);
 err_sem1:
     esp_event_loop_delete(esp_dte->event_loop_hdl);
 err_eloop:
-    uart_disable_pattern_det_intr(esp_dte->uart_port);
-err_uart_pattern:
+err_uart_intr:
     uart_driver_delete(esp_dte->uart_port);
 err_uart_config:
-    free(esp_dte->buffer);
+    esp_modem_arena_free(config->arena, esp_dte->event_ring_storage);
+err_event_ring_mem:
+    esp_modem_arena_free(config->arena, esp_dte->rx_buffer);
+err_rx_mem:
+    esp_modem_arena_free(config->arena, esp_dte->line_ring);
+err_ring_mem:
+    esp_modem_arena_free(config->arena, esp_dte->buffer);
 err_line_mem:
-    free(esp_dte);
+    esp_modem_arena_free(config->arena, esp_dte);
 err_dte_mem:
     return NULL;
 }
@@ -615,11 +1939,54 @@ esp_err_t esp_modem_remove_event_handler(modem_dte_t *dte, esp_event_handler_t h
     return esp_event_handler_unregister_with(esp_dte->event_loop_hdl, ESP_MODEM_EVENT, ESP_EVENT_ANY_ID, handler);
 }
 
+esp_err_t esp_modem_add_urc_handler(modem_dte_t *dte, const char *prefix, esp_modem_urc_cb_t handler, void *context)
+{
+    MODEM_CHECK(dte && prefix && prefix[0] && handler, "invalid arguments", err);
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    portENTER_CRITICAL(&esp_dte->urc_lock);
+    for (int i = 0; i < ESP_MODEM_URC_HANDLERS_MAX; i++) {
+        esp_modem_urc_handler_t *entry = &esp_dte->urc_handlers[i];
+        if (entry->prefix == NULL) {
+            entry->prefix_len = strlen(prefix);
+            entry->cb = handler;
+            entry->context = context;
+            entry->prefix = prefix;
+            ret = ESP_OK;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&esp_dte->urc_lock);
+    if (ret != ESP_OK) {
+        ESP_LOGE(MODEM_TAG, "no room for the handler of %s", prefix);
+    }
+    return ret;
+err:
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_modem_remove_urc_handler(modem_dte_t *dte, const char *prefix, esp_modem_urc_cb_t handler)
+{
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    portENTER_CRITICAL(&esp_dte->urc_lock);
+    for (int i = 0; i < ESP_MODEM_URC_HANDLERS_MAX; i++) {
+        esp_modem_urc_handler_t *entry = &esp_dte->urc_handlers[i];
+        if (entry->prefix && entry->cb == handler && (prefix == NULL || !strcmp(entry->prefix, prefix))) {
+            memset(entry, 0, sizeof(esp_modem_urc_handler_t));
+            ret = ESP_OK;
+        }
+    }
+    portEXIT_CRITICAL(&esp_dte->urc_lock);
+    return ret;
+}
+
 esp_err_t esp_modem_start_ppp(modem_dte_t *dte)
 {
     modem_dce_t *dce = dte->dce;
     MODEM_CHECK(dce, "DTE has not yet bind with DCE", err);
     esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    esp_modem_timeline_mark(ESP_MODEM_MILESTONE_PPP_START);
     /* Set PDP Context */
     MODEM_CHECK(dce->define_pdp_context(dce, 1, "IP", esp_modem_apn) == ESP_OK, "set MODEM APN failed", err);
     ESP_LOGD( __func__, "APN SET IS: %s",esp_modem_apn );
@@ -629,7 +1996,7 @@ esp_err_t esp_modem_start_ppp(modem_dte_t *dte)
     MODEM_CHECK(dte->change_mode(dte, MODEM_PPP_MODE) == ESP_OK, "enter ppp mode failed", err);
 
     /* post PPP mode started event */
-    esp_event_post_to(esp_dte->event_loop_hdl, ESP_MODEM_EVENT, ESP_MODEM_EVENT_PPP_START, NULL, 0, 0);
+    esp_modem_post_event(esp_dte, ESP_MODEM_EVENT_PPP_START, NULL, 0, 0);
     return ESP_OK;
 err:
     return ESP_FAIL;
@@ -644,7 +2011,8 @@ esp_err_t esp_modem_stop_ppp(modem_dte_t *dte)
     /* Enter command mode */
     MODEM_CHECK(dte->change_mode(dte, MODEM_COMMAND_MODE) == ESP_OK, "enter command mode failed", err);
     /* post PPP mode stopped event */
-    esp_event_post_to(esp_dte->event_loop_hdl, ESP_MODEM_EVENT, ESP_MODEM_EVENT_PPP_STOP, NULL, 0, 0);
+    esp_modem_timeline_mark(ESP_MODEM_MILESTONE_PPP_STOP);
+    esp_modem_post_event(esp_dte, ESP_MODEM_EVENT_PPP_STOP, NULL, 0, 0);
     /* Hang up */
     MODEM_CHECK(dce->hang_up(dce) == ESP_OK, "hang up failed", err);
     /* wait for the PPP mode to exit gracefully */
@@ -656,6 +2024,126 @@ err:
     return ESP_FAIL;
 }
 
+/**
+ * @brief Send a frame without information field and wait for one of the answers
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param frame frame to send
+ * @param len length of frame
+ * @param answers event bits of the expected answers
+ * @return event bits of the answers received, 0 on timeout
+ */
+static EventBits_t esp_dte_cmux_request(esp_modem_dte_t *esp_dte, const uint8_t *frame, size_t len, EventBits_t answers)
+{
+    xEventGroupClearBits(esp_dte->cmux_events, answers);
+    uart_write_bytes(esp_dte->uart_port, (const char *)frame, len);
+    return xEventGroupWaitBits(esp_dte->cmux_events, answers, pdTRUE, pdFALSE,
+                               pdMS_TO_TICKS(ESP_MODEM_CMUX_TIMEOUT_MS)) & answers;
+}
+
+/**
+ * @brief Open a CMUX channel, and raise its V.24 signals (DTR, RTS) for a data channel
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @param dlci channel
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL on error
+ */
+static esp_err_t esp_dte_cmux_open(esp_modem_dte_t *esp_dte, uint8_t dlci)
+{
+    uint8_t frame[ESP_MODEM_CMUX_FRAME_SIZE];
+    size_t len = esp_modem_cmux_encode(dlci, ESP_MODEM_CMUX_SABM | ESP_MODEM_CMUX_PF, true, NULL, 0, frame, sizeof(frame));
+    EventBits_t answer = esp_dte_cmux_request(esp_dte, frame, len,
+                                              ESP_MODEM_CMUX_EVENT_UA(dlci) | ESP_MODEM_CMUX_EVENT_DM(dlci));
+    MODEM_CHECK(answer & ESP_MODEM_CMUX_EVENT_UA(dlci), "channel %d %s", err, dlci, answer ? "refused" : "not answering");
+    if (dlci != ESP_MODEM_CMUX_DLCI_CONTROL) {
+        esp_dte_cmux_signals(esp_dte, dlci, true);
+    }
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Close down the multiplexer, the module goes back to AT commands on the UART
+ *
+ * @param esp_dte ESP32 Modem DTE object
+ * @return esp_err_t
+ *      - ESP_OK on success
+ *      - ESP_FAIL if the module did not acknowledge
+ */
+static esp_err_t esp_dte_cmux_close_down(esp_modem_dte_t *esp_dte)
+{
+    uint8_t frame[ESP_MODEM_CMUX_FRAME_SIZE];
+    const uint8_t cld[] = { ESP_MODEM_CMUX_MSG_CLD | ESP_MODEM_CMUX_CR, ESP_MODEM_CMUX_EA };
+    size_t len = esp_modem_cmux_encode(ESP_MODEM_CMUX_DLCI_CONTROL, ESP_MODEM_CMUX_UIH, true, cld, sizeof(cld),
+                                       frame, sizeof(frame));
+    return esp_dte_cmux_request(esp_dte, frame, len, ESP_MODEM_CMUX_EVENT_CLD) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_modem_start_cmux(modem_dte_t *dte)
+{
+    modem_dce_t *dce = dte->dce;
+    MODEM_CHECK(dce, "DTE has not yet bind with DCE", err);
+    MODEM_CHECK(dce->mode == MODEM_COMMAND_MODE && !dte->cmux, "not in command mode", err);
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    if (esp_dte->cmux_events == NULL) {
+        esp_dte->cmux_events = xEventGroupCreate();
+        MODEM_CHECK(esp_dte->cmux_events, "create cmux event group failed", err);
+    }
+    if (esp_dte->tx_queue && esp_dte->cmux_tx == NULL) {
+        esp_dte->cmux_tx = esp_dte_alloc(esp_dte, &esp_dte->footprint.cmux_tx, "cmux_tx", ESP_MODEM_CMUX_TX_SIZE,
+                                         esp_dte->placement.tx_caps);
+        MODEM_CHECK(esp_dte->cmux_tx, "malloc cmux tx buffer failed", err);
+    }
+    size_t ring_size = esp_dte_line_ring_size(esp_dte->line_buffer_size);
+    if (esp_dte->cmux_line_ring == NULL) {
+        esp_dte->cmux_line_ring = esp_dte_alloc(esp_dte, &esp_dte->footprint.cmux_line_ring, "cmux_ring", ring_size,
+                                                esp_dte->placement.line_caps);
+        MODEM_CHECK(esp_dte->cmux_line_ring, "malloc cmux line ring failed", err);
+    }
+    /* the lines of both channels are handled one at a time by the UART event task, they share the line buffer */
+    MODEM_CHECK(esp_modem_line_framer_init(&esp_dte->cmux_ppp_framer, esp_dte->cmux_line_ring, ring_size,
+                                           (char *)esp_dte->buffer, esp_dte->line_buffer_size,
+                                           esp_dte_handle_cmux_ppp_segment, esp_dte),
+                "init cmux line framer failed", err);
+    esp_dte->cmux_ppp_line_continued = false;
+    esp_modem_cmux_decoder_init(&esp_dte->cmux_rx, esp_dte_cmux_frame, esp_dte);
+    MODEM_CHECK(esp_modem_dce_enter_cmux(dce) == ESP_OK, "enter multiplexer mode failed", err);
+    /* from now on the module only understands frames */
+    dte->cmux = true;
+    MODEM_CHECK(esp_dte_cmux_open(esp_dte, ESP_MODEM_CMUX_DLCI_CONTROL) == ESP_OK, "open control channel failed", err_open);
+    MODEM_CHECK(esp_dte_cmux_open(esp_dte, ESP_MODEM_CMUX_DLCI_AT) == ESP_OK, "open AT channel failed", err_open);
+    MODEM_CHECK(esp_dte_cmux_open(esp_dte, ESP_MODEM_CMUX_DLCI_PPP) == ESP_OK, "open PPP channel failed", err_open);
+    ESP_LOGI(MODEM_TAG, "multiplexer started");
+    return ESP_OK;
+err_open:
+    esp_dte_cmux_close_down(esp_dte);
+    dte->cmux = false;
+err:
+    return ESP_FAIL;
+}
+
+esp_err_t esp_modem_stop_cmux(modem_dte_t *dte)
+{
+    modem_dce_t *dce = dte->dce;
+    MODEM_CHECK(dce, "DTE has not yet bind with DCE", err);
+    MODEM_CHECK(dte->cmux, "multiplexer not started", err);
+    MODEM_CHECK(dce->mode == MODEM_COMMAND_MODE, "PPP mode must be stopped first", err);
+    esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
+    if (esp_dte_cmux_close_down(esp_dte) != ESP_OK) {
+        ESP_LOGW(MODEM_TAG, "close down not acknowledged");
+    }
+    dte->cmux = false;
+    esp_modem_line_framer_reset(&esp_dte->framer);
+    esp_dte->line_continued = false;
+    ESP_LOGI(MODEM_TAG, "multiplexer stopped");
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
 esp_err_t esp_modem_notify_ppp_netif_closed(modem_dte_t *dte)
 {
     esp_modem_dte_t *esp_dte = __containerof(dte, esp_modem_dte_t, parent);
@@ -0,0 +1,198 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_modem_arbiter.h"
+
+/**
+ * @brief Queued transaction, on the stack of the waiting task
+ *
+ */
+struct esp_modem_arbiter_waiter {
+    esp_modem_arbiter_waiter_t *next;       /*!< Next in the queue */
+    TaskHandle_t task;                      /*!< Waiting task */
+    esp_modem_cmd_priority_t priority;      /*!< Class of the transaction */
+    bool granted;                           /*!< Arbiter handed over, sem given or about to be */
+    SemaphoreHandle_t sem;                  /*!< Given when granted */
+    StaticSemaphore_t sem_storage;          /*!< Storage of sem */
+};
+
+void esp_modem_arbiter_init(esp_modem_arbiter_t *arbiter, esp_modem_arbiter_abort_cb_t abort_cb, void *context)
+{
+    memset(arbiter, 0, sizeof(esp_modem_arbiter_t));
+    portMUX_INITIALIZE(&arbiter->lock);
+    arbiter->abort_cb = abort_cb;
+    arbiter->abort_context = context;
+}
+
+/**
+ * @brief Check if an emergency transaction waits for a transaction of another class (lock held)
+ */
+static inline bool esp_modem_arbiter_preempting(const esp_modem_arbiter_t *arbiter)
+{
+    return arbiter->owner_priority != ESP_MODEM_CMD_PRIORITY_EMERGENCY && arbiter->waiters &&
+           arbiter->waiters->priority == ESP_MODEM_CMD_PRIORITY_EMERGENCY;
+}
+
+/**
+ * @brief Hand the arbiter over to a task (lock held)
+ */
+static void esp_modem_arbiter_grant(esp_modem_arbiter_t *arbiter, TaskHandle_t task,
+                                    esp_modem_cmd_priority_t priority)
+{
+    arbiter->owner = task;
+    arbiter->depth = 1;
+    arbiter->owner_priority = priority;
+    arbiter->in_flight = false;
+    arbiter->aborted = false;
+    arbiter->stats.classes[priority].acquired++;
+}
+
+/**
+ * @brief Account the queueing delay of a granted transaction (lock held)
+ */
+static void esp_modem_arbiter_record_wait(esp_modem_arbiter_t *arbiter, esp_modem_cmd_priority_t priority,
+                                          int64_t wait_us)
+{
+    esp_modem_arbiter_class_stats_t *stats = &arbiter->stats.classes[priority];
+    stats->wait_last_us = wait_us;
+    stats->wait_total_us += wait_us;
+    if (wait_us > stats->wait_max_us) {
+        stats->wait_max_us = wait_us;
+    }
+}
+
+esp_err_t esp_modem_arbiter_acquire(esp_modem_arbiter_t *arbiter, esp_modem_cmd_priority_t priority,
+                                    uint32_t timeout_ms)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    int64_t start = esp_timer_get_time();
+    esp_modem_arbiter_waiter_t waiter = {
+        .task = self,
+        .priority = priority,
+    };
+    bool abort = false;
+    /* created out of the spinlock, the queue creation enters its own critical section */
+    waiter.sem = xSemaphoreCreateBinaryStatic(&waiter.sem_storage);
+    portENTER_CRITICAL(&arbiter->lock);
+    if (arbiter->owner == self) {
+        arbiter->depth++;
+        portEXIT_CRITICAL(&arbiter->lock);
+        vSemaphoreDelete(waiter.sem);
+        return ESP_OK;
+    }
+    if (arbiter->owner == NULL) {
+        esp_modem_arbiter_grant(arbiter, self, priority);
+        esp_modem_arbiter_record_wait(arbiter, priority, 0);
+        portEXIT_CRITICAL(&arbiter->lock);
+        vSemaphoreDelete(waiter.sem);
+        return ESP_OK;
+    }
+    /* behind the transactions of the same or a higher class */
+    esp_modem_arbiter_waiter_t **pos = &arbiter->waiters;
+    while (*pos && (*pos)->priority <= priority) {
+        pos = &(*pos)->next;
+    }
+    waiter.next = *pos;
+    *pos = &waiter;
+    if (esp_modem_arbiter_preempting(arbiter) && arbiter->waiters == &waiter) {
+        /* first emergency transaction for the one in progress */
+        arbiter->stats.classes[arbiter->owner_priority].preempted++;
+        if (arbiter->in_flight && !arbiter->aborted) {
+            arbiter->aborted = true;
+            abort = true;
+        }
+    }
+    portEXIT_CRITICAL(&arbiter->lock);
+    if (abort && arbiter->abort_cb) {
+        arbiter->abort_cb(arbiter->abort_context);
+    }
+
+    bool granted = xSemaphoreTake(waiter.sem, pdMS_TO_TICKS(timeout_ms)) == pdTRUE;
+    portENTER_CRITICAL(&arbiter->lock);
+    if (!granted && !waiter.granted) {
+        pos = &arbiter->waiters;
+        while (*pos != &waiter) {
+            pos = &(*pos)->next;
+        }
+        *pos = waiter.next;
+        arbiter->stats.classes[priority].timeouts++;
+    } else {
+        esp_modem_arbiter_record_wait(arbiter, priority, esp_timer_get_time() - start);
+    }
+    portEXIT_CRITICAL(&arbiter->lock);
+    if (!granted && waiter.granted) {
+        /* handed over right at the timeout, the semaphore is about to be given */
+        xSemaphoreTake(waiter.sem, portMAX_DELAY);
+        granted = true;
+    }
+    vSemaphoreDelete(waiter.sem);
+    return granted ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+esp_err_t esp_modem_arbiter_release(esp_modem_arbiter_t *arbiter)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    esp_modem_arbiter_waiter_t *next = NULL;
+    portENTER_CRITICAL(&arbiter->lock);
+    if (arbiter->owner != self) {
+        portEXIT_CRITICAL(&arbiter->lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (--arbiter->depth == 0) {
+        next = arbiter->waiters;
+        if (next) {
+            arbiter->waiters = next->next;
+            next->granted = true;
+            esp_modem_arbiter_grant(arbiter, next->task, next->priority);
+        } else {
+            arbiter->owner = NULL;
+        }
+    }
+    portEXIT_CRITICAL(&arbiter->lock);
+    if (next) {
+        xSemaphoreGive(next->sem);
+    }
+    return ESP_OK;
+}
+
+bool esp_modem_arbiter_begin_command(esp_modem_arbiter_t *arbiter)
+{
+    portENTER_CRITICAL(&arbiter->lock);
+    bool go = !esp_modem_arbiter_preempting(arbiter);
+    arbiter->in_flight = go;
+    arbiter->aborted = false;
+    portEXIT_CRITICAL(&arbiter->lock);
+    return go;
+}
+
+bool esp_modem_arbiter_end_command(esp_modem_arbiter_t *arbiter)
+{
+    portENTER_CRITICAL(&arbiter->lock);
+    bool completed = !arbiter->aborted;
+    arbiter->in_flight = false;
+    arbiter->aborted = false;
+    portEXIT_CRITICAL(&arbiter->lock);
+    return completed;
+}
+
+void esp_modem_arbiter_get_stats(esp_modem_arbiter_t *arbiter, esp_modem_arbiter_stats_t *stats)
+{
+    portENTER_CRITICAL(&arbiter->lock);
+    *stats = arbiter->stats;
+    portEXIT_CRITICAL(&arbiter->lock);
+}
@@ -0,0 +1,44 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_modem_arena.h"
+
+static const char *ARENA_TAG = "esp-modem-arena";
+
+#define ESP_MODEM_ARENA_ALIGN (8)
+
+void *esp_modem_arena_calloc(esp_modem_arena_t *arena, size_t size)
+{
+    if (arena == NULL) {
+        return calloc(1, size);
+    }
+    size_t start = (arena->used + ESP_MODEM_ARENA_ALIGN - 1) & ~(size_t)(ESP_MODEM_ARENA_ALIGN - 1);
+    if (start > arena->size || size > arena->size - start) {
+        ESP_LOGE(ARENA_TAG, "arena exhausted: %u bytes requested, %u of %u bytes used", size, arena->used, arena->size);
+        return NULL;
+    }
+    arena->used = start + size;
+    void *ptr = arena->base + start;
+    memset(ptr, 0, size);
+    return ptr;
+}
+
+void esp_modem_arena_free(esp_modem_arena_t *arena, void *ptr)
+{
+    if (arena == NULL) {
+        free(ptr);
+    }
+}
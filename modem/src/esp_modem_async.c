@@ -0,0 +1,256 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_modem_dce_service.h"
+#include "esp_modem_async.h"
+#include "esp_modem.h"
+
+/**
+ * @brief Macro defined for error checking
+ *
+ */
+static const char *ASYNC_TAG = "esp-modem-async";
+#define ASYNC_CHECK(a, str, goto_tag, ...)                                              \
+    do                                                                                  \
+    {                                                                                   \
+        if (!(a))                                                                       \
+        {                                                                               \
+            ESP_LOGE(ASYNC_TAG, "%s(%d): " str, __FUNCTION__, __LINE__, ##__VA_ARGS__); \
+            goto goto_tag;                                                              \
+        }                                                                               \
+    } while (0)
+
+/**
+ * @brief Asynchronous command engine
+ *
+ */
+struct esp_modem_async {
+    modem_dce_t *dce;                                   /*!< DCE the commands are sent to */
+    QueueHandle_t queue;                                /*!< Pending commands */
+    TaskHandle_t task_hdl;                              /*!< Engine task handle */
+    SemaphoreHandle_t exit_sem;                         /*!< Given by the engine task when stopped */
+    int max_batch;                                      /*!< Max commands on one command line */
+    esp_modem_async_cmd_t batch[ESP_MODEM_ASYNC_MAX_BATCH]; /*!< Commands in flight */
+    int batch_len;                                      /*!< Number of commands in flight */
+    char line[ESP_MODEM_ASYNC_MAX_LINE_LENGTH];         /*!< Command line being sent */
+    esp_modem_async_stats_t stats;                      /*!< Statistics */
+};
+
+/**
+ * @brief Handle the response lines of the command line in flight
+ */
+static esp_err_t esp_modem_async_handle_line(modem_dce_t *dce, const esp_modem_line_t *line)
+{
+    struct esp_modem_async *async = dce->async;
+    if (line->type == ESP_MODEM_LINE_OK) {
+        return esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+    }
+    if (esp_modem_line_is_error(line)) {
+        return esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+    }
+    for (int i = 0; i < async->batch_len; i++) {
+        const esp_modem_async_cmd_t *cmd = &async->batch[i];
+        if (cmd->prefix == NULL || esp_modem_line_has_prefix(line, cmd->prefix)) {
+            return cmd->line_cb ? cmd->line_cb(dce, line, cmd->context) : ESP_OK;
+        }
+    }
+    /* not part of the response, e.g. an unsolicited result code */
+    return ESP_FAIL;
+}
+
+/**
+ * @brief Complete commands
+ */
+static void esp_modem_async_complete(struct esp_modem_async *async, const esp_modem_async_cmd_t *cmds, int count,
+                                     esp_err_t result)
+{
+    for (int i = 0; i < count; i++) {
+        async->stats.commands++;
+        if (cmds[i].done_cb) {
+            cmds[i].done_cb(async->dce, result, cmds[i].context);
+        }
+    }
+}
+
+/**
+ * @brief Send commands on one command line and wait for the final result code
+ *
+ * @return ESP_OK on success, ESP_FAIL on error result code, ESP_ERR_TIMEOUT without result code
+ */
+static esp_err_t esp_modem_async_run(struct esp_modem_async *async, const esp_modem_async_cmd_t *cmds, int count)
+{
+    modem_dce_t *dce = async->dce;
+    modem_dte_t *dte = dce->dte;
+    uint32_t timeout = 0;
+    int len = snprintf(async->line, sizeof(async->line), "AT");
+    for (int i = 0; i < count; i++) {
+        len += snprintf(async->line + len, sizeof(async->line) - len, "%s%s", i ? ";" : "", cmds[i].command);
+        timeout += cmds[i].timeout;
+        async->batch[i] = cmds[i];
+    }
+    snprintf(async->line + len, sizeof(async->line) - len, "\r");
+    if (dce->mode != MODEM_COMMAND_MODE && !(dce->mode == MODEM_PPP_MODE && dte->cmux)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (dte->acquire(dte, ESP_MODEM_CMD_PRIORITY_BACKGROUND, MODEM_ARBITER_TIMEOUT_DEFAULT) != ESP_OK) {
+        return ESP_ERR_TIMEOUT;
+    }
+    async->batch_len = count;
+    async->stats.command_lines++;
+    dce->handle_line = esp_modem_async_handle_line;
+    esp_err_t err = dte->send_cmd(dte, async->line, timeout);
+    async->batch_len = 0;
+    bool success = dce->state == MODEM_STATE_SUCCESS;
+    dte->release(dte);
+    if (err != ESP_OK) {
+        return ESP_ERR_TIMEOUT;
+    }
+    return success ? ESP_OK : ESP_FAIL;
+}
+
+/**
+ * @brief Check if a queued command can be appended to the command line
+ */
+static bool esp_modem_async_can_batch(struct esp_modem_async *async, const esp_modem_async_cmd_t *cmds, int count,
+                                      const esp_modem_async_cmd_t *next)
+{
+    if (next->command == NULL || next->prefix == NULL || count >= async->max_batch) {
+        return false;
+    }
+    /* "AT" + commands separated by ';' + "\r" + NUL */
+    size_t len = strlen("AT\r") + 1 + strlen(next->command);
+    for (int i = 0; i < count; i++) {
+        len += strlen(cmds[i].command) + 1;
+    }
+    return len <= ESP_MODEM_ASYNC_MAX_LINE_LENGTH;
+}
+
+/**
+ * @brief Engine Task Entry
+ *
+ * @param param task parameter
+ */
+static void esp_modem_async_task_entry(void *param)
+{
+    struct esp_modem_async *async = param;
+    esp_modem_async_cmd_t cmds[ESP_MODEM_ASYNC_MAX_BATCH];
+    while (1) {
+        xQueueReceive(async->queue, &cmds[0], portMAX_DELAY);
+        if (cmds[0].command == NULL) {
+            break;
+        }
+        int count = 1;
+        if (cmds[0].prefix) {
+            /* gather the independent queries queued meanwhile */
+            while (count < async->max_batch && xQueuePeek(async->queue, &cmds[count], 0) == pdTRUE &&
+                   esp_modem_async_can_batch(async, cmds, count, &cmds[count])) {
+                xQueueReceive(async->queue, &cmds[count], 0);
+                async->stats.batched++;
+                count++;
+            }
+        }
+        esp_err_t result = esp_modem_async_run(async, cmds, count);
+        if (result == ESP_FAIL && count > 1) {
+            /* the whole line failed on one command, find out which one */
+            ESP_LOGD(ASYNC_TAG, "batch of %d commands failed, retry one by one", count);
+            async->stats.fallbacks++;
+            for (int i = 0; i < count; i++) {
+                esp_modem_async_complete(async, &cmds[i], 1, esp_modem_async_run(async, &cmds[i], 1));
+            }
+            continue;
+        }
+        esp_modem_async_complete(async, cmds, count, result);
+    }
+    /* stopped: fail the pending commands */
+    while (xQueueReceive(async->queue, &cmds[0], 0) == pdTRUE) {
+        esp_modem_async_complete(async, cmds, 1, ESP_ERR_INVALID_STATE);
+    }
+    xSemaphoreGive(async->exit_sem);
+    vTaskDelete(NULL);
+}
+
+esp_err_t esp_modem_async_start(modem_dce_t *dce, const esp_modem_async_config_t *config)
+{
+    ASYNC_CHECK(dce && config, "invalid arguments", err);
+    ASYNC_CHECK(dce->async == NULL, "already started", err);
+    struct esp_modem_async *async = esp_modem_arena_calloc(esp_modem_dte_get_arena(dce->dte),
+                                                           sizeof(struct esp_modem_async));
+    ASYNC_CHECK(async, "calloc async engine failed", err);
+    async->dce = dce;
+    async->max_batch = MAX(1, MIN(config->max_batch, ESP_MODEM_ASYNC_MAX_BATCH));
+    async->queue = xQueueCreate(config->queue_size, sizeof(esp_modem_async_cmd_t));
+    ASYNC_CHECK(async->queue, "create command queue failed", err_queue);
+    async->exit_sem = xSemaphoreCreateBinary();
+    ASYNC_CHECK(async->exit_sem, "create exit semaphore failed", err_sem);
+    dce->async = async;
+    BaseType_t ret = xTaskCreate(esp_modem_async_task_entry, "modem_async", config->task_stack_size,
+                                 async, config->task_priority, &async->task_hdl);
+    ASYNC_CHECK(ret == pdTRUE, "create engine task failed", err_task);
+    return ESP_OK;
+err_task:
+    dce->async = NULL;
+    vSemaphoreDelete(async->exit_sem);
+err_sem:
+    vQueueDelete(async->queue);
+err_queue:
+    esp_modem_arena_free(esp_modem_dte_get_arena(dce->dte), async);
+err:
+    return ESP_FAIL;
+}
+
+esp_err_t esp_modem_async_stop(modem_dce_t *dce)
+{
+    ASYNC_CHECK(dce && dce->async, "not started", err);
+    struct esp_modem_async *async = dce->async;
+    const esp_modem_async_cmd_t stop = { .command = NULL };
+    xQueueSend(async->queue, &stop, portMAX_DELAY);
+    xSemaphoreTake(async->exit_sem, portMAX_DELAY);
+    dce->async = NULL;
+    vSemaphoreDelete(async->exit_sem);
+    vQueueDelete(async->queue);
+    esp_modem_arena_free(esp_modem_dte_get_arena(dce->dte), async);
+    return ESP_OK;
+err:
+    return ESP_FAIL;
+}
+
+esp_err_t esp_modem_async_submit(modem_dce_t *dce, const esp_modem_async_cmd_t *cmd)
+{
+    ASYNC_CHECK(cmd && cmd->command, "invalid command", err_arg);
+    ASYNC_CHECK(dce && dce->async, "not started", err_state);
+    ASYNC_CHECK(xQueueSend(dce->async->queue, cmd, 0) == pdTRUE, "command queue full", err_full);
+    return ESP_OK;
+err_arg:
+    return ESP_ERR_INVALID_ARG;
+err_state:
+    return ESP_ERR_INVALID_STATE;
+err_full:
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t esp_modem_async_get_stats(modem_dce_t *dce, esp_modem_async_stats_t *stats)
+{
+    ASYNC_CHECK(dce && dce->async, "not started", err);
+    *stats = dce->async->stats;
+    return ESP_OK;
+err:
+    return ESP_ERR_INVALID_STATE;
+}
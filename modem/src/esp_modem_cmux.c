@@ -0,0 +1,224 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <string.h>
+#include "esp_modem_cmux.h"
+
+/**
+ * @brief Decoding states
+ */
+enum {
+    CMUX_STATE_HUNT,        /*!< Dropping data up to the next flag */
+    CMUX_STATE_ADDRESS,     /*!< Waiting for the address octet (extra flags skipped) */
+    CMUX_STATE_CONTROL,     /*!< Waiting for the control octet */
+    CMUX_STATE_LENGTH,      /*!< Waiting for the first length octet */
+    CMUX_STATE_LENGTH2,     /*!< Waiting for the second length octet */
+    CMUX_STATE_INFO,        /*!< Receiving the information field */
+    CMUX_STATE_FCS,         /*!< Waiting for the FCS */
+    CMUX_STATE_CLOSE,       /*!< Waiting for the closing flag */
+};
+
+/* CRC-8, reversed polynomial 0xE0 (x^8 + x^2 + x + 1), 27.010 annex B */
+static const uint8_t s_crc8_table[256] = {
+    0x00, 0x91, 0xE3, 0x72, 0x07, 0x96, 0xE4, 0x75,
+    0x0E, 0x9F, 0xED, 0x7C, 0x09, 0x98, 0xEA, 0x7B,
+    0x1C, 0x8D, 0xFF, 0x6E, 0x1B, 0x8A, 0xF8, 0x69,
+    0x12, 0x83, 0xF1, 0x60, 0x15, 0x84, 0xF6, 0x67,
+    0x38, 0xA9, 0xDB, 0x4A, 0x3F, 0xAE, 0xDC, 0x4D,
+    0x36, 0xA7, 0xD5, 0x44, 0x31, 0xA0, 0xD2, 0x43,
+    0x24, 0xB5, 0xC7, 0x56, 0x23, 0xB2, 0xC0, 0x51,
+    0x2A, 0xBB, 0xC9, 0x58, 0x2D, 0xBC, 0xCE, 0x5F,
+    0x70, 0xE1, 0x93, 0x02, 0x77, 0xE6, 0x94, 0x05,
+    0x7E, 0xEF, 0x9D, 0x0C, 0x79, 0xE8, 0x9A, 0x0B,
+    0x6C, 0xFD, 0x8F, 0x1E, 0x6B, 0xFA, 0x88, 0x19,
+    0x62, 0xF3, 0x81, 0x10, 0x65, 0xF4, 0x86, 0x17,
+    0x48, 0xD9, 0xAB, 0x3A, 0x4F, 0xDE, 0xAC, 0x3D,
+    0x46, 0xD7, 0xA5, 0x34, 0x41, 0xD0, 0xA2, 0x33,
+    0x54, 0xC5, 0xB7, 0x26, 0x53, 0xC2, 0xB0, 0x21,
+    0x5A, 0xCB, 0xB9, 0x28, 0x5D, 0xCC, 0xBE, 0x2F,
+    0xE0, 0x71, 0x03, 0x92, 0xE7, 0x76, 0x04, 0x95,
+    0xEE, 0x7F, 0x0D, 0x9C, 0xE9, 0x78, 0x0A, 0x9B,
+    0xFC, 0x6D, 0x1F, 0x8E, 0xFB, 0x6A, 0x18, 0x89,
+    0xF2, 0x63, 0x11, 0x80, 0xF5, 0x64, 0x16, 0x87,
+    0xD8, 0x49, 0x3B, 0xAA, 0xDF, 0x4E, 0x3C, 0xAD,
+    0xD6, 0x47, 0x35, 0xA4, 0xD1, 0x40, 0x32, 0xA3,
+    0xC4, 0x55, 0x27, 0xB6, 0xC3, 0x52, 0x20, 0xB1,
+    0xCA, 0x5B, 0x29, 0xB8, 0xCD, 0x5C, 0x2E, 0xBF,
+    0x90, 0x01, 0x73, 0xE2, 0x97, 0x06, 0x74, 0xE5,
+    0x9E, 0x0F, 0x7D, 0xEC, 0x99, 0x08, 0x7A, 0xEB,
+    0x8C, 0x1D, 0x6F, 0xFE, 0x8B, 0x1A, 0x68, 0xF9,
+    0x82, 0x13, 0x61, 0xF0, 0x85, 0x14, 0x66, 0xF7,
+    0xA8, 0x39, 0x4B, 0xDA, 0xAF, 0x3E, 0x4C, 0xDD,
+    0xA6, 0x37, 0x45, 0xD4, 0xA1, 0x30, 0x42, 0xD3,
+    0xB4, 0x25, 0x57, 0xC6, 0xB3, 0x22, 0x50, 0xC1,
+    0xBA, 0x2B, 0x59, 0xC8, 0xBD, 0x2C, 0x5E, 0xCF,
+};
+
+uint8_t esp_modem_cmux_crc8(const uint8_t *data, size_t len)
+{
+    uint8_t crc = 0xFF;
+    while (len--) {
+        crc = s_crc8_table[crc ^ *data++];
+    }
+    return crc;
+}
+
+void esp_modem_cmux_decoder_init(esp_modem_cmux_decoder_t *decoder, esp_modem_cmux_frame_cb_t frame_cb, void *context)
+{
+    memset(decoder, 0, sizeof(*decoder));
+    decoder->frame_cb = frame_cb;
+    decoder->context = context;
+    decoder->state = CMUX_STATE_HUNT;
+}
+
+void esp_modem_cmux_decoder_reset(esp_modem_cmux_decoder_t *decoder)
+{
+    decoder->state = CMUX_STATE_HUNT;
+    decoder->header_len = 0;
+    decoder->pos = 0;
+}
+
+/**
+ * @brief Check the FCS of the current frame and deliver it
+ *
+ * The FCS covers the address, control and length fields, and the information field of UI frames.
+ */
+static void cmux_end_frame(esp_modem_cmux_decoder_t *decoder, uint8_t fcs)
+{
+    uint8_t control = decoder->header[1] & ~ESP_MODEM_CMUX_PF;
+    uint8_t crc = esp_modem_cmux_crc8(decoder->header, decoder->header_len);
+    if (control == ESP_MODEM_CMUX_UI) {
+        for (size_t i = 0; i < decoder->len; i++) {
+            crc = s_crc8_table[crc ^ decoder->info[i]];
+        }
+    }
+    if (s_crc8_table[crc ^ fcs] != ESP_MODEM_CMUX_FCS_GOOD) {
+        decoder->fcs_errors++;
+        return;
+    }
+    decoder->frames++;
+    decoder->frame_cb(decoder->header[0] >> 2, control, decoder->info, decoder->len, decoder->context);
+}
+
+void esp_modem_cmux_decode(esp_modem_cmux_decoder_t *decoder, const uint8_t *data, size_t len)
+{
+    const uint8_t *end = data + len;
+    while (data < end) {
+        uint8_t byte = *data++;
+        switch (decoder->state) {
+        case CMUX_STATE_HUNT:
+            if (byte == ESP_MODEM_CMUX_FLAG) {
+                decoder->state = CMUX_STATE_ADDRESS;
+            }
+            break;
+        case CMUX_STATE_ADDRESS:
+            if (byte == ESP_MODEM_CMUX_FLAG) {
+                /* closing flag of the previous frame followed by an opening flag */
+                break;
+            }
+            if (!(byte & ESP_MODEM_CMUX_EA)) {
+                /* extended addresses are not used by the basic option */
+                decoder->dropped++;
+                decoder->state = CMUX_STATE_HUNT;
+                break;
+            }
+            decoder->header[0] = byte;
+            decoder->header_len = 1;
+            decoder->state = CMUX_STATE_CONTROL;
+            break;
+        case CMUX_STATE_CONTROL:
+            decoder->header[decoder->header_len++] = byte;
+            decoder->state = CMUX_STATE_LENGTH;
+            break;
+        case CMUX_STATE_LENGTH:
+            decoder->header[decoder->header_len++] = byte;
+            decoder->len = byte >> 1;
+            decoder->state = (byte & ESP_MODEM_CMUX_EA) ? CMUX_STATE_INFO : CMUX_STATE_LENGTH2;
+            break;
+        case CMUX_STATE_LENGTH2:
+            decoder->header[decoder->header_len++] = byte;
+            decoder->len |= (size_t)byte << 7;
+            decoder->state = CMUX_STATE_INFO;
+            break;
+        case CMUX_STATE_INFO: {
+            /* first byte of the information field (or the FCS for an empty frame), copy what is available */
+            if (decoder->len > ESP_MODEM_CMUX_N1) {
+                decoder->dropped++;
+                decoder->state = CMUX_STATE_HUNT;
+                break;
+            }
+            data--;
+            size_t chunk = decoder->len - decoder->pos;
+            if (chunk > (size_t)(end - data)) {
+                chunk = end - data;
+            }
+            memcpy(decoder->info + decoder->pos, data, chunk);
+            decoder->pos += chunk;
+            data += chunk;
+            if (decoder->pos == decoder->len) {
+                decoder->state = CMUX_STATE_FCS;
+            }
+            break;
+        }
+        case CMUX_STATE_FCS:
+            /* checked once the closing flag confirms the frame length */
+            decoder->fcs = byte;
+            decoder->state = CMUX_STATE_CLOSE;
+            break;
+        case CMUX_STATE_CLOSE:
+            if (byte == ESP_MODEM_CMUX_FLAG) {
+                cmux_end_frame(decoder, decoder->fcs);
+                decoder->state = CMUX_STATE_ADDRESS;
+            } else {
+                decoder->dropped++;
+                decoder->state = CMUX_STATE_HUNT;
+            }
+            break;
+        }
+        if (decoder->state == CMUX_STATE_ADDRESS || decoder->state == CMUX_STATE_HUNT) {
+            decoder->pos = 0;
+        }
+    }
+}
+
+size_t esp_modem_cmux_encode(uint8_t dlci, uint8_t control, bool command, const uint8_t *data, size_t len,
+                             uint8_t *out, size_t out_size)
+{
+    size_t header_len = (len > 127) ? 4 : 3;
+    if (len > ESP_MODEM_CMUX_N1 || out_size < header_len + len + 3) {
+        return 0;
+    }
+    uint8_t *p = out;
+    *p++ = ESP_MODEM_CMUX_FLAG;
+    *p++ = (dlci << 2) | (command ? ESP_MODEM_CMUX_CR : 0) | ESP_MODEM_CMUX_EA;
+    *p++ = control;
+    if (len > 127) {
+        *p++ = (len & 0x7F) << 1;
+        *p++ = len >> 7;
+    } else {
+        *p++ = (len << 1) | ESP_MODEM_CMUX_EA;
+    }
+    uint8_t crc = esp_modem_cmux_crc8(out + 1, header_len);
+    if (len) {
+        memcpy(p, data, len);
+        p += len;
+        if ((control & ~ESP_MODEM_CMUX_PF) == ESP_MODEM_CMUX_UI) {
+            for (size_t i = 0; i < len; i++) {
+                crc = s_crc8_table[crc ^ data[i]];
+            }
+        }
+    }
+    *p++ = 0xFF - crc;
+    *p++ = ESP_MODEM_CMUX_FLAG;
+    return p - out;
+}
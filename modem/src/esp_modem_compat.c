@@ -24,6 +24,8 @@ static const char *TAG = "esp-modem-compat";
 /* dealloc */
 void *modem_netif_adapter;
 esp_netif_t *esp_netif;
+/* DTE the netif is attached to */
+static modem_dte_t *modem_dte;
 
 static void on_modem_compat_handler(void *arg, esp_event_base_t event_base,
                         int32_t event_id, void *event_data)
@@ -90,6 +92,10 @@ esp_err_t esp_modem_setup_ppp(modem_dte_t *dte)
 #elif defined(CONFIG_EXAMPLE_MODEM_PPP_AUTH_USERNAME) && defined(CONFIG_EXAMPLE_MODEM_PPP_AUTH_PASSWORD)
 #error "Unsupported AUTH Negotiation while AUTH_USERNAME and PASSWORD defined"
 #endif
+    if (esp_netif && modem_dte == dte && esp_modem_dte_get_arena(dte)) {
+        /* static configuration: still attached since the previous session */
+        return ESP_OK;
+    }
     // Init netif object
     esp_netif_config_t cfg = ESP_NETIF_DEFAULT_PPP();
     esp_netif = esp_netif_new(&cfg);
@@ -102,6 +108,7 @@ esp_err_t esp_modem_setup_ppp(modem_dte_t *dte)
     esp_netif_ppp_set_auth(esp_netif, auth_type, CONFIG_EXAMPLE_MODEM_PPP_AUTH_USERNAME, CONFIG_EXAMPLE_MODEM_PPP_AUTH_PASSWORD);
 #endif
     modem_netif_adapter = esp_modem_netif_setup(dte);
+    modem_dte = dte;
     esp_modem_netif_set_default_handlers(modem_netif_adapter, esp_netif);
     /* attach the modem to the network interface */
     return esp_netif_attach(esp_netif, modem_netif_adapter);
@@ -115,11 +122,20 @@ esp_err_t esp_modem_exit_ppp(modem_dte_t *dte)
 
 void esp_modem_free_netif_adapter(void)
 {
+   if (modem_dte && esp_modem_dte_get_arena(modem_dte))
+   {
+      /* static configuration: kept for the next session, creating them again would allocate */
+      ESP_LOGD(__func__, "kept");
+      return;
+   }
    ESP_LOGI(__func__, "free");
 
    esp_event_handler_unregister(IP_EVENT, ESP_EVENT_ANY_ID, &on_ip_event);
    esp_modem_netif_clear_default_handlers(modem_netif_adapter);
    esp_modem_netif_teardown(modem_netif_adapter);
    esp_netif_destroy(esp_netif);
+   esp_netif = NULL;
+   modem_netif_adapter = NULL;
+   modem_dte = NULL;
 
 }
@@ -30,16 +30,16 @@ static const char *DCE_TAG = "dce_service";
         }                                                                             \
     } while (0)
 
-esp_err_t esp_modem_dce_handle_response_default( modem_dce_t * dce, const char * line )
+esp_err_t esp_modem_dce_handle_response_default( modem_dce_t * dce, const esp_modem_line_t * line )
 {
    esp_err_t err = ESP_FAIL;
-   if ( strstr( line, MODEM_RESULT_CODE_SUCCESS ) )
+   if ( line->type == ESP_MODEM_LINE_OK )
    {
       err = esp_modem_process_command_done( dce, MODEM_STATE_SUCCESS );
       dce->baudStatus = MODEM_BRS_OK;
       ESP_LOGD(DCE_TAG, "SUCCESS");
    }
-   else if ( strstr( line, MODEM_RESULT_CODE_ERROR ) )
+   else if ( esp_modem_line_is_error( line ) )
    {
       err = esp_modem_process_command_done( dce, MODEM_STATE_FAIL );
       dce->baudStatus = MODEM_BRS_OK;
@@ -47,75 +47,139 @@ esp_err_t esp_modem_dce_handle_response_default( modem_dce_t * dce, const char *
    }
    else
    {
-      ESP_LOGW(DCE_TAG, "Unexpected modem response: %s", line);
+      ESP_LOGW(DCE_TAG, "Unexpected modem response: %s", line->text);
    }
    return err;
 }
 
 
-esp_err_t esp_modem_dce_handle_at( modem_dce_t * dce, const char * line )
+esp_err_t esp_modem_dce_handle_at( modem_dce_t * dce, const esp_modem_line_t * line )
 {
    esp_err_t err = ESP_FAIL;
-   if ( strstr( line, MODEM_RESULT_CODE_SUCCESS ) )
+   if ( line->type == ESP_MODEM_LINE_OK )
    {
       err = esp_modem_process_command_done( dce, MODEM_STATE_SUCCESS );
       ESP_LOGW(DCE_TAG, MODEM_RESULT_CODE_SUCCESS);
    }
-   else if ( strstr( line, MODEM_RESULT_CODE_ERROR ) )
+   else if ( esp_modem_line_is_error( line ) )
    {
       err = esp_modem_process_command_done( dce, MODEM_STATE_FAIL );
       ESP_LOGW(DCE_TAG, MODEM_RESULT_CODE_ERROR);
    }
-   else if ( strstr( line, "AT" ) )
+   else if ( esp_modem_line_has_prefix( line, "AT" ) )
    {
       ESP_LOGW(DCE_TAG, "AT" );
       err = ESP_OK;
    }
    else
    {
-      ESP_LOGW(DCE_TAG, "DC %s", line);
+      ESP_LOGW(DCE_TAG, "DC %s", line->text);
    }
    return err;
 }
 
-esp_err_t esp_modem_dce_handle_ate( modem_dce_t * dce, const char * line )
+esp_err_t esp_modem_dce_handle_ate( modem_dce_t * dce, const esp_modem_line_t * line )
 {
    esp_err_t err = ESP_FAIL;
 
-   if ( strstr( line, MODEM_RESULT_CODE_ATE0 ) )
+   if ( esp_modem_line_has_prefix( line, MODEM_RESULT_CODE_ATE0 ) )
    {
       /* an echo disable command with echo on respond the last time with the echo */
       err = ESP_OK;
    }
-   else if ( strstr( line, MODEM_RESULT_CODE_ATE1 ) )
+   else if ( esp_modem_line_has_prefix( line, MODEM_RESULT_CODE_ATE1 ) )
    {
       err = ESP_OK;
    }
-   else if ( strstr( line, MODEM_RESULT_CODE_SUCCESS ) )
+   else if ( line->type == ESP_MODEM_LINE_OK )
    {
       err = esp_modem_process_command_done( dce, MODEM_STATE_SUCCESS );
    }
-   else if ( strstr( line, MODEM_RESULT_CODE_ERROR ) )
+   else if ( esp_modem_line_is_error( line ) )
    {
       err = esp_modem_process_command_done( dce, MODEM_STATE_FAIL );
    }
    return err;
 }
+
+/**
+ * @brief Handle line segments of a streamed response
+ */
+static esp_err_t esp_modem_dce_handle_segment_streamed(modem_dce_t *dce, const char *segment, size_t len,
+                                                       bool line_start, bool line_end)
+{
+    modem_response_stream_t *stream = dce->stream;
+    if (line_start && line_end) {
+        if (len <= 2) {
+            /* pure "\r\n" */
+            return ESP_OK;
+        }
+        esp_modem_line_t line;
+        esp_modem_line_classify(segment, &line);
+        if (line.type == ESP_MODEM_LINE_OK) {
+            return esp_modem_process_command_done(dce, MODEM_STATE_SUCCESS);
+        }
+        if (esp_modem_line_is_error(&line)) {
+            return esp_modem_process_command_done(dce, MODEM_STATE_FAIL);
+        }
+    }
+    return stream->cb(dce, segment, len, line_end, stream->context);
+}
+
+esp_err_t esp_modem_dce_send_cmd_streamed(modem_dce_t *dce, const char *command, uint32_t timeout,
+                                          modem_response_cb_t response_cb, void *context)
+{
+    modem_dte_t *dte = dce->dte;
+    modem_response_stream_t stream = {
+        .cb = response_cb,
+        .context = context
+    };
+    DCE_CHECK(response_cb, "response consumer is NULL", err_param);
+    DCE_CHECK(dte->acquire(dte, ESP_MODEM_CMD_PRIORITY_NORMAL, MODEM_ARBITER_TIMEOUT_DEFAULT) == ESP_OK,
+              "command arbiter busy", err_param);
+    dce->stream = &stream;
+    dce->handle_segment = esp_modem_dce_handle_segment_streamed;
+    /* send_cmd detaches the handler under the DTE handler lock, stream is no longer used once it returns */
+    DCE_CHECK(dte->send_cmd(dte, command, timeout) == ESP_OK, "send command failed", err_stream);
+    dce->stream = NULL;
+    DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "streamed command failed", err);
+    dte->release(dte);
+    return ESP_OK;
+err_stream:
+    dce->stream = NULL;
+err:
+    dte->release(dte);
+err_param:
+    return ESP_FAIL;
+}
+
+esp_err_t esp_modem_dce_get_profile(modem_dce_t *dce, modem_response_cb_t response_cb, void *context)
+{
+    return esp_modem_dce_send_cmd_streamed(dce, "AT&V\r", MODEM_COMMAND_TIMEOUT_DEFAULT, response_cb, context);
+}
+
 esp_err_t esp_modem_dce_sync(modem_dce_t *dce)
 {
     modem_dte_t *dte = dce->dte;
+    DCE_CHECK(dte->acquire(dte, ESP_MODEM_CMD_PRIORITY_NORMAL, MODEM_ARBITER_TIMEOUT_DEFAULT) == ESP_OK,
+              "command arbiter busy", err_acquire);
     dce->handle_line = esp_modem_dce_handle_response_default;
     DCE_CHECK(dte->send_cmd(dte, "AT\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
     DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "sync failed", err);
     ESP_LOGD(DCE_TAG, "sync ok");
+    dte->release(dte);
     return ESP_OK;
 err:
+    dte->release(dte);
+err_acquire:
     return ESP_FAIL;
 }
 
 esp_err_t esp_modem_dce_echo(modem_dce_t *dce, bool on)
 {
     modem_dte_t *dte = dce->dte;
+    DCE_CHECK(dte->acquire(dte, ESP_MODEM_CMD_PRIORITY_NORMAL, MODEM_ARBITER_TIMEOUT_DEFAULT) == ESP_OK,
+              "command arbiter busy", err_acquire);
     dce->handle_line = esp_modem_dce_handle_ate;
     if (on) {
         DCE_CHECK(dte->send_cmd(dte, "ATE1\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
@@ -126,33 +190,47 @@ esp_err_t esp_modem_dce_echo(modem_dce_t *dce, bool on)
         DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "disable echo failed", err);
         ESP_LOGD(DCE_TAG, "disable echo ok");
     }
+    dte->release(dte);
     return ESP_OK;
 err:
+    dte->release(dte);
+err_acquire:
     return ESP_FAIL;
 }
 
 esp_err_t esp_modem_dce_factory_reset( modem_dce_t * dce )
 {
    modem_dte_t *dte = dce->dte;
+   DCE_CHECK(dte->acquire(dte, ESP_MODEM_CMD_PRIORITY_NORMAL, MODEM_ARBITER_TIMEOUT_DEFAULT) == ESP_OK,
+             "command arbiter busy", err_acquire);
    dce->handle_line = esp_modem_dce_handle_response_default;
 
    DCE_CHECK( dte->send_cmd(dte, "AT&F\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err );
    DCE_CHECK( dce->state == MODEM_STATE_SUCCESS, "reset to factory failed", err );
    ESP_LOGI( DCE_TAG, "reset to factory ok" );
 
+   dte->release(dte);
    return ESP_OK;
-   err: return ESP_FAIL;
+   err:
+   dte->release(dte);
+   err_acquire:
+   return ESP_FAIL;
 }
 
 esp_err_t esp_modem_dce_store_profile(modem_dce_t *dce)
 {
     modem_dte_t *dte = dce->dte;
+    DCE_CHECK(dte->acquire(dte, ESP_MODEM_CMD_PRIORITY_NORMAL, MODEM_ARBITER_TIMEOUT_DEFAULT) == ESP_OK,
+              "command arbiter busy", err_acquire);
     dce->handle_line = esp_modem_dce_handle_response_default;
     DCE_CHECK(dte->send_cmd(dte, "AT&W\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
     DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "save settings failed", err);
     ESP_LOGD(DCE_TAG, "save settings ok");
+    dte->release(dte);
     return ESP_OK;
 err:
+    dte->release(dte);
+err_acquire:
     return ESP_FAIL;
 }
 
@@ -160,14 +238,19 @@ esp_err_t esp_modem_dce_set_flow_ctrl(modem_dce_t *dce, modem_flow_ctrl_t flow_c
 {
     modem_dte_t *dte = dce->dte;
     char command[16];
+    DCE_CHECK(dte->acquire(dte, ESP_MODEM_CMD_PRIORITY_NORMAL, MODEM_ARBITER_TIMEOUT_DEFAULT) == ESP_OK,
+              "command arbiter busy", err_acquire);
     int len = snprintf(command, sizeof(command), "AT+IFC=%d,%d\r", dte->flow_ctrl, flow_ctrl);
     DCE_CHECK(len < sizeof(command), "command too long: %s", err, command);
     dce->handle_line = esp_modem_dce_handle_response_default;
     DCE_CHECK(dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
     DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "set flow control failed", err);
     ESP_LOGD(DCE_TAG, "set flow control ok");
+    dte->release(dte);
     return ESP_OK;
 err:
+    dte->release(dte);
+err_acquire:
     return ESP_FAIL;
 }
 
@@ -175,6 +258,8 @@ esp_err_t esp_modem_dce_set_baud_rate(modem_dce_t *dce, uint32_t baudrate)
 {
     modem_dte_t *dte = dce->dte;
     char command[16];
+    DCE_CHECK(dte->acquire(dte, ESP_MODEM_CMD_PRIORITY_NORMAL, MODEM_ARBITER_TIMEOUT_DEFAULT) == ESP_OK,
+              "command arbiter busy", err_acquire);
     int len = snprintf(command, sizeof(command), "AT+IPR=%d\r", baudrate);
     DCE_CHECK(len < sizeof(command), "command too long: %s", err, command);
     dce->handle_line = esp_modem_dce_handle_response_default;
@@ -184,16 +269,38 @@ esp_err_t esp_modem_dce_set_baud_rate(modem_dce_t *dce, uint32_t baudrate)
 
 
     ESP_LOGD(DCE_TAG, "baudrate changed to: %d" , baudrate);
+    dte->release(dte);
     return ESP_OK;
 err:
+    dte->release(dte);
+err_acquire:
     return ESP_FAIL;
 }
 
 
+esp_err_t esp_modem_dce_enter_cmux(modem_dce_t *dce)
+{
+    modem_dte_t *dte = dce->dte;
+    DCE_CHECK(dte->acquire(dte, ESP_MODEM_CMD_PRIORITY_NORMAL, MODEM_ARBITER_TIMEOUT_DEFAULT) == ESP_OK,
+              "command arbiter busy", err_acquire);
+    dce->handle_line = esp_modem_dce_handle_response_default;
+    DCE_CHECK(dte->send_cmd(dte, "AT+CMUX=0\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
+    DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "enter cmux mode failed", err);
+    ESP_LOGD(DCE_TAG, "enter cmux mode ok");
+    dte->release(dte);
+    return ESP_OK;
+err:
+    dte->release(dte);
+err_acquire:
+    return ESP_FAIL;
+}
+
 esp_err_t esp_modem_dce_define_pdp_context(modem_dce_t *dce, uint32_t cid, const char *type, const char *apn)
 {
     modem_dte_t *dte = dce->dte;
     char command[64];
+    DCE_CHECK(dte->acquire(dte, ESP_MODEM_CMD_PRIORITY_NORMAL, MODEM_ARBITER_TIMEOUT_DEFAULT) == ESP_OK,
+              "command arbiter busy", err_acquire);
     int len = snprintf(command, sizeof(command), "AT+CGDCONT=%d,\"%s\",\"%s\"\r", cid, type, apn);
     DCE_CHECK(len < sizeof(command), "command too long: %s", err, command);
     ESP_LOGD(DCE_TAG, " = %s", command );
@@ -201,32 +308,45 @@ esp_err_t esp_modem_dce_define_pdp_context(modem_dce_t *dce, uint32_t cid, const
     DCE_CHECK(dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
     DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "define pdp context failed", err);
     ESP_LOGD(DCE_TAG, "define pdp context ok");
+    dte->release(dte);
     return ESP_OK;
 err:
+    dte->release(dte);
+err_acquire:
     return ESP_FAIL;
 }
 
 esp_err_t esp_modem_dce_hang_up(modem_dce_t *dce)
 {
     modem_dte_t *dte = dce->dte;
+    DCE_CHECK(dte->acquire(dte, ESP_MODEM_CMD_PRIORITY_CONTROL, MODEM_ARBITER_TIMEOUT_DEFAULT) == ESP_OK,
+              "command arbiter busy", err_acquire);
     dce->handle_line = esp_modem_dce_handle_response_default;
     DCE_CHECK(dte->send_cmd(dte, "ATH\r", MODEM_COMMAND_TIMEOUT_HANG_UP) == ESP_OK, "send command failed", err);
     DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "hang up failed", err);
     ESP_LOGD(DCE_TAG, "hang up ok");
+    dte->release(dte);
     return ESP_OK;
 err:
+    dte->release(dte);
+err_acquire:
     return ESP_FAIL;
 }
 
 esp_err_t esp_modem_dce_answer(modem_dce_t *dce)
 {
     modem_dte_t *dte = dce->dte;
+    DCE_CHECK(dte->acquire(dte, ESP_MODEM_CMD_PRIORITY_CONTROL, MODEM_ARBITER_TIMEOUT_DEFAULT) == ESP_OK,
+              "command arbiter busy", err_acquire);
     dce->handle_line = esp_modem_dce_handle_response_default;
     DCE_CHECK(dte->send_cmd(dte, "ATA\r", MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
     DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "answer failed", err);
     ESP_LOGD(DCE_TAG, "answer ok");
+    dte->release(dte);
     return ESP_OK;
 err:
+    dte->release(dte);
+err_acquire:
     return ESP_FAIL;
 }
 
@@ -234,13 +354,18 @@ esp_err_t esp_modem_dce_set_auto_answer(modem_dce_t *dce, uint32_t ringNumber )
 {
     modem_dte_t *dte = dce->dte;
     char command[16];
+    DCE_CHECK(dte->acquire(dte, ESP_MODEM_CMD_PRIORITY_NORMAL, MODEM_ARBITER_TIMEOUT_DEFAULT) == ESP_OK,
+              "command arbiter busy", err_acquire);
     int len = snprintf(command, sizeof(command), "ATS0=%d\r", ringNumber );
     DCE_CHECK(len < sizeof(command), "command too long: %s", err, command);
     dce->handle_line = esp_modem_dce_handle_response_default;
     DCE_CHECK(dte->send_cmd(dte, command, MODEM_COMMAND_TIMEOUT_DEFAULT) == ESP_OK, "send command failed", err);
     DCE_CHECK(dce->state == MODEM_STATE_SUCCESS, "set auto answer failed", err);
     ESP_LOGD(DCE_TAG, "set auto answer ok");
+    dte->release(dte);
     return ESP_OK;
 err:
+    dte->release(dte);
+err_acquire:
     return ESP_FAIL;
 }
@@ -0,0 +1,58 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/gpio.h"
+#include "esp_modem_dtr.h"
+
+/* DTR is active low: the pin is high while DTR is off */
+#define DTR_LEVEL_ON    (0)
+#define DTR_LEVEL_OFF   (1)
+
+esp_err_t esp_modem_dtr_init(int io_num)
+{
+    if (io_num < 0) {
+        return ESP_OK;
+    }
+    gpio_config_t io_config = {
+        .pin_bit_mask = 1ULL << io_num,
+        .mode = GPIO_MODE_OUTPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_DISABLE
+    };
+    if (gpio_config(&io_config) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    gpio_set_level(io_num, DTR_LEVEL_ON);
+    return ESP_OK;
+}
+
+esp_err_t esp_modem_dtr_pulse(int io_num, uint32_t duration_ms)
+{
+    if (io_num < 0) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    gpio_set_level(io_num, DTR_LEVEL_OFF);
+    vTaskDelay(pdMS_TO_TICKS(duration_ms));
+    gpio_set_level(io_num, DTR_LEVEL_ON);
+    return ESP_OK;
+}
+
+void esp_modem_dtr_deinit(int io_num)
+{
+    if (io_num >= 0) {
+        gpio_reset_pin(io_num);
+    }
+}
@@ -0,0 +1,71 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <string.h>
+#include "esp_modem_event_ring.h"
+
+bool esp_modem_event_ring_init(esp_modem_event_ring_t *ring, uint8_t *storage, uint32_t slot_count,
+                               uint32_t slot_size)
+{
+    if (storage == NULL || slot_count == 0 || (slot_count & (slot_count - 1)) || slot_size == 0) {
+        return false;
+    }
+    memset(ring, 0, sizeof(esp_modem_event_ring_t));
+    ring->storage = storage;
+    ring->slot_count = slot_count;
+    ring->slot_stride = ESP_MODEM_EVENT_SLOT_STRIDE(slot_size);
+    ring->slot_size = slot_size;
+    return true;
+}
+
+static inline esp_modem_event_slot_t *esp_modem_event_ring_slot(esp_modem_event_ring_t *ring, uint32_t index)
+{
+    return (esp_modem_event_slot_t *)(ring->storage + (index & (ring->slot_count - 1)) * ring->slot_stride);
+}
+
+bool esp_modem_event_ring_push(esp_modem_event_ring_t *ring, int32_t event_id, const void *data, size_t size)
+{
+    uint32_t head = ring->head;
+    uint32_t used = head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    if (used >= ring->slot_count || size > ring->slot_size) {
+        ring->dropped++;
+        return false;
+    }
+    esp_modem_event_slot_t *slot = esp_modem_event_ring_slot(ring, head);
+    slot->event_id = event_id;
+    slot->size = size;
+    if (size) {
+        memcpy(slot->data, data, size);
+    }
+    /* the slot content is visible to the consumer before the new head */
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    if (used + 1 > ring->peak) {
+        ring->peak = used + 1;
+    }
+    return true;
+}
+
+const esp_modem_event_slot_t *esp_modem_event_ring_peek(esp_modem_event_ring_t *ring)
+{
+    uint32_t tail = ring->tail;
+    if (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == tail) {
+        return NULL;
+    }
+    return esp_modem_event_ring_slot(ring, tail);
+}
+
+void esp_modem_event_ring_pop(esp_modem_event_ring_t *ring)
+{
+    /* the slot is read before it is given back to the producer */
+    __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+}
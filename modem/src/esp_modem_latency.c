@@ -0,0 +1,160 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <string.h>
+#include <sys/param.h>
+#include "esp_modem_latency.h"
+
+const uint32_t esp_modem_latency_bounds_ms[ESP_MODEM_LATENCY_BUCKETS] = {
+    10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000, UINT32_MAX
+};
+
+void esp_modem_latency_init(esp_modem_latency_table_t *table, bool adaptive, uint32_t floor_ms, uint32_t ceiling_ms)
+{
+    memset(table, 0, sizeof(esp_modem_latency_table_t));
+    portMUX_INITIALIZE(&table->lock);
+    table->adaptive = adaptive;
+    table->floor_ms = floor_ms;
+    table->ceiling_ms = ceiling_ms;
+}
+
+/**
+ * @brief Name a command up to its parameter values, keeping its form and the subcommand of the vendor commands
+ *
+ * "AT+CSQ\r" -> "AT+CSQ", "AT+CREG?\r" -> "AT+CREG?", "AT+CREG=2\r" -> "AT+CREG=", "AT+COPS=?\r" -> "AT+COPS=?",
+ * "AT+QCFG=\"band\"\r" -> "AT+QCFG=\"band\"", "AT+QCFG=\"band\",0,800d5,0,1\r" -> "AT+QCFG=\"band\","
+ */
+static void esp_modem_latency_name(const char *command, char *name)
+{
+    size_t len = strcspn(command, "=\r");
+    if (command[len] == '=') {
+        const char *param = command + len + 1;
+        len++;
+        if (param[0] == '?') {
+            /* test form */
+            len++;
+        } else if (param[0] == '"' && !strncmp(command, "AT+Q", 4)) {
+            /* the subcommand of the vendor commands (AT+QCFG="band"), read form alone, set form followed by
+               its values; other quoted values (PIN, number) are not part of the name */
+            size_t quoted = strcspn(param + 1, "\"\r");
+            if (param[1 + quoted] == '"') {
+                len += quoted + 2;
+                if (param[quoted + 2] == ',') {
+                    len++;
+                }
+            }
+        }
+    }
+    len = MIN(len, ESP_MODEM_LATENCY_NAME_MAX - 1);
+    memcpy(name, command, len);
+    name[len] = '\0';
+}
+
+/**
+ * @brief Derive the timeout of a command from its histogram (lock held)
+ */
+static uint32_t esp_modem_latency_derive(const esp_modem_latency_table_t *table,
+                                         const esp_modem_command_latency_t *entry, uint32_t nominal_ms)
+{
+    if (!table->adaptive || entry->samples < ESP_MODEM_LATENCY_MIN_SAMPLES) {
+        return nominal_ms;
+    }
+    uint32_t rank = (entry->samples * ESP_MODEM_LATENCY_PERCENTILE + 99) / 100;
+    uint32_t seen = 0;
+    int i = 0;
+    for (; i < ESP_MODEM_LATENCY_BUCKETS - 1; i++) {
+        seen += entry->buckets[i];
+        if (seen >= rank) {
+            break;
+        }
+    }
+    uint64_t bound = esp_modem_latency_bounds_ms[i];
+    if (i == ESP_MODEM_LATENCY_BUCKETS - 1) {
+        bound = MAX(entry->max_ms, esp_modem_latency_bounds_ms[i - 1]);
+    }
+    uint64_t timeout = bound * ESP_MODEM_LATENCY_MARGIN;
+    return MIN(MAX(timeout, table->floor_ms), MAX(nominal_ms, table->ceiling_ms));
+}
+
+uint32_t esp_modem_latency_timeout(esp_modem_latency_table_t *table, const char *command, uint32_t nominal_ms,
+                                   int *index)
+{
+    *index = -1;
+    if (strncmp(command, "AT", 2)) {
+        return nominal_ms;
+    }
+    char name[ESP_MODEM_LATENCY_NAME_MAX];
+    esp_modem_latency_name(command, name);
+    uint32_t timeout = nominal_ms;
+    portENTER_CRITICAL(&table->lock);
+    for (int i = 0; i < ESP_MODEM_LATENCY_COMMANDS_MAX; i++) {
+        esp_modem_command_latency_t *entry = &table->commands[i];
+        if (entry->command[0] == '\0') {
+            strcpy(entry->command, name);
+        } else if (strcmp(entry->command, name)) {
+            continue;
+        }
+        timeout = esp_modem_latency_derive(table, entry, nominal_ms);
+        entry->nominal_ms = nominal_ms;
+        entry->timeout_ms = timeout;
+        *index = i;
+        break;
+    }
+    if (*index < 0) {
+        table->untracked++;
+    }
+    portEXIT_CRITICAL(&table->lock);
+    return timeout;
+}
+
+void esp_modem_latency_record(esp_modem_latency_table_t *table, int index, uint32_t elapsed_ms, bool answered)
+{
+    if (index < 0) {
+        return;
+    }
+    portENTER_CRITICAL(&table->lock);
+    esp_modem_command_latency_t *entry = &table->commands[index];
+    if (entry->samples >= ESP_MODEM_LATENCY_WINDOW) {
+        /* older samples weigh half */
+        entry->samples = 0;
+        for (int i = 0; i < ESP_MODEM_LATENCY_BUCKETS; i++) {
+            entry->buckets[i] /= 2;
+            entry->samples += entry->buckets[i];
+        }
+    }
+    int i = 0;
+    while (elapsed_ms > esp_modem_latency_bounds_ms[i]) {
+        i++;
+    }
+    entry->buckets[i]++;
+    entry->samples++;
+    if (answered) {
+        entry->answered++;
+        entry->max_ms = MAX(entry->max_ms, elapsed_ms);
+    } else {
+        entry->timeouts++;
+    }
+    entry->timeout_ms = esp_modem_latency_derive(table, entry, entry->nominal_ms);
+    portEXIT_CRITICAL(&table->lock);
+}
+
+size_t esp_modem_latency_snapshot(esp_modem_latency_table_t *table, esp_modem_command_latency_t *latency, size_t max)
+{
+    size_t count = 0;
+    portENTER_CRITICAL(&table->lock);
+    for (int i = 0; i < ESP_MODEM_LATENCY_COMMANDS_MAX && count < max && table->commands[i].command[0]; i++) {
+        latency[count++] = table->commands[i];
+    }
+    portEXIT_CRITICAL(&table->lock);
+    return count;
+}
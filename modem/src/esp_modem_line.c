@@ -0,0 +1,225 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdlib.h>
+#include <string.h>
+#include "esp_modem_line.h"
+
+/**
+ * @brief Line classification rule
+ *
+ */
+typedef struct {
+    const char *prefix;             /*!< Head of the line */
+    size_t len;                     /*!< Length of prefix */
+    esp_modem_line_type_t type;     /*!< Class of the matching lines */
+    bool whole_line;                /*!< The prefix must fill the whole line */
+} esp_modem_line_rule_t;
+
+#define LINE_RULE(prefix, type, whole_line) { prefix, sizeof(prefix) - 1, type, whole_line }
+
+/**
+ * @brief Final result codes and known unsolicited result codes, by head of line
+ */
+static const esp_modem_line_rule_t s_line_rules[] = {
+    LINE_RULE("OK", ESP_MODEM_LINE_OK, true),
+    LINE_RULE("ERROR", ESP_MODEM_LINE_ERROR, true),
+    LINE_RULE("CONNECT", ESP_MODEM_LINE_CONNECT, false),
+    LINE_RULE("NO CARRIER", ESP_MODEM_LINE_NO_CARRIER, true),
+    LINE_RULE("NO DIALTONE", ESP_MODEM_LINE_NO_DIALTONE, true),
+    LINE_RULE("NO ANSWER", ESP_MODEM_LINE_NO_ANSWER, true),
+    LINE_RULE("BUSY", ESP_MODEM_LINE_BUSY, true),
+    LINE_RULE("+CME ERROR:", ESP_MODEM_LINE_CME_ERROR, false),
+    LINE_RULE("+CMS ERROR:", ESP_MODEM_LINE_CMS_ERROR, false),
+    LINE_RULE("RDY", ESP_MODEM_LINE_URC, true),
+    LINE_RULE("RING", ESP_MODEM_LINE_URC, true),
+    LINE_RULE("POWERED DOWN", ESP_MODEM_LINE_URC, true),
+    LINE_RULE("+CPIN:", ESP_MODEM_LINE_URC, false),
+    LINE_RULE("+QIND:", ESP_MODEM_LINE_URC, false),
+    LINE_RULE("+QUSIM:", ESP_MODEM_LINE_URC, false),
+    LINE_RULE("+CREG:", ESP_MODEM_LINE_URC, false),
+    LINE_RULE("+CEREG:", ESP_MODEM_LINE_URC, false),
+    LINE_RULE("+CGREG:", ESP_MODEM_LINE_URC, false),
+    LINE_RULE("+CMTI:", ESP_MODEM_LINE_URC, false),
+    LINE_RULE("+CRING:", ESP_MODEM_LINE_URC, false),
+    LINE_RULE("+QIURC:", ESP_MODEM_LINE_URC, false),
+};
+
+void esp_modem_line_classify(const char *text, esp_modem_line_t *line)
+{
+    /* blanks or stray line ends may precede the line */
+    while (*text == ' ' || *text == '\r' || *text == '\n') {
+        text++;
+    }
+    size_t len = strcspn(text, "\r\n");
+    line->type = ESP_MODEM_LINE_INFO;
+    line->text = text;
+    line->len = len;
+    line->prefix_len = 0;
+    line->payload = text;
+    line->payload_len = len;
+    line->code = -1;
+
+    for (int i = 0; i < sizeof(s_line_rules) / sizeof(s_line_rules[0]); i++) {
+        const esp_modem_line_rule_t *rule = &s_line_rules[i];
+        if (rule->prefix[0] != text[0] || rule->len > len || strncmp(text, rule->prefix, rule->len)) {
+            continue;
+        }
+        if (rule->whole_line ? rule->len == len : (rule->prefix[rule->len - 1] == ':' || rule->len == len ||
+                                                   text[rule->len] == ' ')) {
+            line->type = rule->type;
+            break;
+        }
+    }
+    if (text[0] == '+') {
+        /* +XXX: <parameters> */
+        const char *colon = memchr(text, ':', len);
+        if (colon) {
+            line->prefix_len = colon - text;
+            line->payload = colon + 1;
+            while (*line->payload == ' ') {
+                line->payload++;
+            }
+            line->payload_len = len - (line->payload - text);
+        }
+    }
+    if (line->type == ESP_MODEM_LINE_CME_ERROR || line->type == ESP_MODEM_LINE_CMS_ERROR ||
+        (line->type == ESP_MODEM_LINE_CONNECT && len > strlen("CONNECT"))) {
+        const char *params = line->type == ESP_MODEM_LINE_CONNECT ? text + strlen("CONNECT") : line->payload;
+        char *end = NULL;
+        long code = strtol(params, &end, 10);
+        if (end != params) {
+            line->code = (int)code;
+        }
+    }
+}
+
+bool esp_modem_fields_next(esp_modem_fields_t *fields, const char **field, size_t *len)
+{
+    const char *p = fields->pos;
+    if (p == NULL || p > fields->end) {
+        return false;
+    }
+    while (p < fields->end && *p == ' ') {
+        p++;
+    }
+    const char *start = p;
+    const char *stop;
+    if (p < fields->end && *p == '"') {
+        /* quoted: ',' may be part of the field */
+        start = ++p;
+        while (p < fields->end && *p != '"') {
+            p++;
+        }
+        stop = p;
+        while (p < fields->end && *p != ',') {
+            p++;
+        }
+    } else {
+        while (p < fields->end && *p != ',') {
+            p++;
+        }
+        stop = p;
+        while (stop > start && stop[-1] == ' ') {
+            stop--;
+        }
+    }
+    *field = start;
+    *len = stop - start;
+    /* past the end once the last field is read */
+    fields->pos = p + 1;
+    return true;
+}
+
+bool esp_modem_fields_skip(esp_modem_fields_t *fields, int count)
+{
+    const char *field;
+    size_t len;
+    while (count--) {
+        if (!esp_modem_fields_next(fields, &field, &len)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool esp_modem_fields_int(esp_modem_fields_t *fields, int32_t *value)
+{
+    const char *field;
+    size_t len;
+    if (!esp_modem_fields_next(fields, &field, &len) || len == 0) {
+        return false;
+    }
+    size_t i = 0;
+    bool negative = field[0] == '-';
+    if (negative || field[0] == '+') {
+        i++;
+    }
+    if (i == len) {
+        return false;
+    }
+    int32_t result = 0;
+    for (; i < len; i++) {
+        if (field[i] < '0' || field[i] > '9') {
+            return false;
+        }
+        result = result * 10 + (field[i] - '0');
+    }
+    *value = negative ? -result : result;
+    return true;
+}
+
+bool esp_modem_fields_hex(esp_modem_fields_t *fields, uint32_t *value)
+{
+    const char *field;
+    size_t len;
+    if (!esp_modem_fields_next(fields, &field, &len) || len == 0) {
+        return false;
+    }
+    if (len > 2 && field[0] == '0' && (field[1] == 'x' || field[1] == 'X')) {
+        field += 2;
+        len -= 2;
+    }
+    uint32_t result = 0;
+    for (size_t i = 0; i < len; i++) {
+        char c = field[i];
+        uint32_t digit;
+        if (c >= '0' && c <= '9') {
+            digit = c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            digit = c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            digit = c - 'A' + 10;
+        } else {
+            return false;
+        }
+        result = (result << 4) | digit;
+    }
+    *value = result;
+    return true;
+}
+
+bool esp_modem_fields_str(esp_modem_fields_t *fields, char *str, size_t size)
+{
+    const char *field;
+    size_t len;
+    if (!esp_modem_fields_next(fields, &field, &len)) {
+        return false;
+    }
+    if (len >= size) {
+        len = size - 1;
+    }
+    memcpy(str, field, len);
+    str[len] = '\0';
+    return true;
+}
@@ -0,0 +1,193 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <string.h>
+#include "esp_modem_line_framer.h"
+
+#define LF_WORD     (0x0A0A0A0Au)
+#define ONES_WORD   (0x01010101u)
+#define HIGHS_WORD  (0x80808080u)
+
+#define FRAMER_MIN(a, b) ((a) < (b) ? (a) : (b))
+
+/**
+ * @brief Find the first '\n', comparing a word at a time
+ *
+ * @param data data to scan
+ * @param len length of data
+ * @return offset of the '\n', len if not found
+ */
+static size_t find_lf(const uint8_t *data, size_t len)
+{
+    size_t i = 0;
+    /* bytewise up to the first word boundary */
+    while (i < len && ((uintptr_t)(data + i) & (sizeof(uint32_t) - 1))) {
+        if (data[i] == '\n') {
+            return i;
+        }
+        i++;
+    }
+    /* skip the words without any '\n' byte */
+    for (; i + sizeof(uint32_t) <= len; i += sizeof(uint32_t)) {
+        uint32_t word;
+        memcpy(&word, data + i, sizeof(word));
+        word ^= LF_WORD;
+        if ((word - ONES_WORD) & ~word & HIGHS_WORD) {
+            break;
+        }
+    }
+    for (; i < len; i++) {
+        if (data[i] == '\n') {
+            return i;
+        }
+    }
+    return len;
+}
+
+/**
+ * @brief Copy bytes from the ring buffer and release them
+ */
+static void ring_read(esp_modem_line_framer_t *framer, uint8_t *dst, size_t len)
+{
+    size_t start = framer->tail & (framer->ring_size - 1);
+    size_t first = FRAMER_MIN(len, framer->ring_size - start);
+    memcpy(dst, framer->ring + start, first);
+    memcpy(dst + first, framer->ring, len - first);
+    framer->tail += len;
+}
+
+/**
+ * @brief Pass one segment (at most line_size bytes) to the callback
+ */
+static void emit_segment(esp_modem_line_framer_t *framer, size_t len, bool line_end)
+{
+    ring_read(framer, (uint8_t *)framer->line, len);
+    framer->line[len] = '\0';
+    framer->scanned = framer->scanned > len ? framer->scanned - len : 0;
+    framer->line_cb(framer->context, framer->line, len, line_end);
+}
+
+/**
+ * @brief Pass all complete lines (and overlong partial lines) to the callback
+ */
+static void process(esp_modem_line_framer_t *framer)
+{
+    for (;;) {
+        size_t pending = framer->head - framer->tail;
+        size_t offset = framer->scanned;
+        size_t line_len = 0;
+        while (offset < pending) {
+            size_t start = (framer->tail + offset) & (framer->ring_size - 1);
+            size_t run = FRAMER_MIN(pending - offset, framer->ring_size - start);
+            size_t pos = find_lf(framer->ring + start, run);
+            if (pos < run) {
+                line_len = offset + pos + 1;
+                break;
+            }
+            offset += run;
+        }
+        if (line_len) {
+            while (line_len > framer->line_size) {
+                emit_segment(framer, framer->line_size, false);
+                line_len -= framer->line_size;
+            }
+            emit_segment(framer, line_len, true);
+            framer->scanned = 0;
+            continue;
+        }
+        framer->scanned = pending;
+        if (pending < framer->line_size) {
+            break;
+        }
+        /* no line end within a full line buffer: pass it on to keep room in the ring buffer */
+        emit_segment(framer, framer->line_size, false);
+    }
+}
+
+bool esp_modem_line_framer_init(esp_modem_line_framer_t *framer, uint8_t *ring, size_t ring_size,
+                                char *line, size_t line_buffer_size, esp_modem_line_cb line_cb, void *context)
+{
+    if (ring_size == 0 || (ring_size & (ring_size - 1)) || line_buffer_size < 2 ||
+        ring_size < 2 * line_buffer_size) {
+        return false;
+    }
+    framer->ring = ring;
+    framer->ring_size = ring_size;
+    framer->line = line;
+    framer->line_size = line_buffer_size - 1;
+    framer->line_cb = line_cb;
+    framer->context = context;
+    esp_modem_line_framer_reset(framer);
+    return true;
+}
+
+void esp_modem_line_framer_reset(esp_modem_line_framer_t *framer)
+{
+    framer->head = 0;
+    framer->tail = 0;
+    framer->scanned = 0;
+}
+
+size_t esp_modem_line_framer_get_write_ptr(esp_modem_line_framer_t *framer, uint8_t **ptr)
+{
+    size_t start = framer->head & (framer->ring_size - 1);
+    size_t free_len = framer->ring_size - (framer->head - framer->tail);
+    *ptr = framer->ring + start;
+    return FRAMER_MIN(free_len, framer->ring_size - start);
+}
+
+void esp_modem_line_framer_commit(esp_modem_line_framer_t *framer, size_t len)
+{
+    framer->head += len;
+    process(framer);
+}
+
+void esp_modem_line_framer_feed(esp_modem_line_framer_t *framer, const uint8_t *data, size_t len)
+{
+    while (len) {
+        uint8_t *ptr;
+        size_t room = FRAMER_MIN(esp_modem_line_framer_get_write_ptr(framer, &ptr), len);
+        memcpy(ptr, data, room);
+        esp_modem_line_framer_commit(framer, room);
+        data += room;
+        len -= room;
+    }
+}
+
+size_t esp_modem_line_framer_pending(const esp_modem_line_framer_t *framer)
+{
+    return framer->head - framer->tail;
+}
+
+size_t esp_modem_line_framer_take(esp_modem_line_framer_t *framer, uint8_t *dst, size_t max)
+{
+    size_t len = FRAMER_MIN(esp_modem_line_framer_pending(framer), max);
+    ring_read(framer, dst, len);
+    framer->scanned = framer->scanned > len ? framer->scanned - len : 0;
+    return len;
+}
+
+bool esp_modem_line_framer_consume_prompt(esp_modem_line_framer_t *framer, const char *prompt, size_t len)
+{
+    if (esp_modem_line_framer_pending(framer) < len) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (framer->ring[(framer->tail + i) & (framer->ring_size - 1)] != (uint8_t)prompt[i]) {
+            return false;
+        }
+    }
+    framer->tail += len;
+    framer->scanned = framer->scanned > len ? framer->scanned - len : 0;
+    return true;
+}
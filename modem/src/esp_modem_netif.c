@@ -14,7 +14,12 @@
 #include "esp_netif.h"
 #include "esp_netif_ppp.h"
 #include "esp_modem.h"
+#include "esp_modem_timeline.h"
 #include "esp_log.h"
+#include "lwip/pbuf.h"
+#include "lwip/tcpip.h"
+#include "netif/ppp/pppos.h"
+#include "netif/ppp/ppp_impl.h"
 
 static const char *TAG = "esp-modem-netif";
 
@@ -34,18 +39,31 @@ static void on_ppp_changed(void *arg, esp_event_base_t event_base,
         ESP_LOGI(TAG, "PPP state changed event %d", event_id);
         // only notify the modem on state/error events, ignoring phase transitions
         esp_modem_notify_ppp_netif_closed(dte);
+    } else if (event_id == NETIF_PPP_PHASE_AUTHENTICATE || event_id == NETIF_PPP_PHASE_NETWORK) {
+        // leaving the establish phase: LCP is opened, record it once per connection
+        if (esp_modem_timeline_get_time(ESP_MODEM_MILESTONE_LCP_UP) <
+            esp_modem_timeline_get_time(ESP_MODEM_MILESTONE_CONNECT)) {
+            esp_modem_timeline_mark(ESP_MODEM_MILESTONE_LCP_UP);
+        }
     }
 }
+
+static void on_ppp_got_ip(void *arg, esp_event_base_t event_base,
+                          int32_t event_id, void *event_data)
+{
+    esp_modem_timeline_mark(ESP_MODEM_MILESTONE_IP_ACQUIRED);
+}
 /**
  * @brief Transmit function called from esp_netif to output network stack data
  *
  * Note: This API has to conform to esp-netif transmit prototype
+ * In PPP mode the data are queued for the modem TX task, so this never blocks the tcpip thread.
  *
  * @param h Opaque pointer representing esp-netif driver, esp_dte in this case of esp_modem
  * @param data data buffer
  * @param length length of data to send
  *
- * @return ESP_OK on success
+ * @return ESP_OK on success, ESP_FAIL if the data could not be sent or queued (TX queue full)
  */
 static esp_err_t esp_modem_dte_transmit(void *h, void *buffer, size_t len)
 {
@@ -56,6 +74,19 @@ static esp_err_t esp_modem_dte_transmit(void *h, void *buffer, size_t len)
     return ESP_FAIL;
 }
 
+/**
+ * @brief Free an rx buffer which was handed over to the network layer
+ *
+ * Note: This API has to conform to esp-netif driver_free_rx_buffer prototype
+ *
+ * @param h Opaque pointer representing esp-netif driver, esp_dte in this case of esp_modem
+ * @param buffer rx buffer (pbuf) to free
+ */
+static void esp_modem_dte_free_rx_buffer(void *h, void *buffer)
+{
+    pbuf_free(buffer);
+}
+
 /**
  * @brief Post attach adapter for esp-modem
  *
@@ -71,7 +102,7 @@ static esp_err_t esp_modem_post_attach_start(esp_netif_t * esp_netif, void * arg
     esp_modem_netif_driver_t *driver = args;
     modem_dte_t *dte = driver->dte;
     const esp_netif_driver_ifconfig_t driver_ifconfig = {
-            .driver_free_rx_buffer = NULL,
+            .driver_free_rx_buffer = esp_modem_dte_free_rx_buffer,
             .transmit = esp_modem_dte_transmit,
             .handle = dte
     };
@@ -105,9 +136,124 @@ static esp_err_t modem_netif_receive_cb(void *buffer, size_t len, void *context)
     return ESP_OK;
 }
 
+/**
+ * @brief Get an rx buffer for zero-copy reception
+ *
+ * @param size payload size
+ * @param payload[out] payload of the rx buffer
+ * @param context context data used for esp-modem-netif handle
+ *
+ * @return rx buffer (pbuf), NULL if none is available
+ */
+static void *modem_netif_get_rx_buffer(size_t size, uint8_t **payload, void *context)
+{
+    esp_modem_netif_driver_t *driver = context;
+    if (driver->base.netif == NULL) {
+        return NULL;
+    }
+    struct pbuf *p = pbuf_alloc(PBUF_RAW, size, PBUF_RAM);
+    if (p) {
+        *payload = p->payload;
+    }
+    return p;
+}
+
+/**
+ * @brief Release an rx buffer that has not been filled
+ *
+ * @param rx_buffer rx buffer (pbuf)
+ * @param context context data used for esp-modem-netif handle
+ */
+static void modem_netif_free_rx_buffer(void *rx_buffer, void *context)
+{
+    esp_modem_netif_driver_t *driver = context;
+    esp_modem_dte_free_rx_buffer(driver->dte, rx_buffer);
+}
+
+/**
+ * @brief Feed a received rx buffer to PPPoS, runs in the tcpip thread
+ *
+ * The pbuf is consumed in place and freed afterwards, unlike pppos_input_tcpip() which copies the data
+ * into a new pbuf first.
+ *
+ * @param p rx buffer
+ * @param inp lwip netif of the PPP interface
+ *
+ * @return ERR_OK
+ */
+static err_t modem_netif_input_rx_buffer(struct pbuf *p, struct netif *inp)
+{
+    ppp_pcb *ppp = inp->state;
+    pppos_input(ppp, p->payload, p->len);
+    esp_modem_dte_free_rx_buffer(NULL, p);
+    return ERR_OK;
+}
+
+/**
+ * @brief Zero-copy data path callback from esp-modem, takes the ownership of the rx buffer
+ *
+ * @param rx_buffer rx buffer (pbuf) filled by esp-modem
+ * @param len data length
+ * @param context context data used for esp-modem-netif handle
+ *
+ * @return ESP_OK on success
+ */
+static esp_err_t modem_netif_receive_rx_buffer(void *rx_buffer, size_t len, void *context)
+{
+    esp_modem_netif_driver_t *driver = context;
+    struct pbuf *p = rx_buffer;
+    if (p->len != len) {
+        pbuf_realloc(p, len);
+    }
+    if (tcpip_inpkt(p, esp_netif_get_netif_impl(driver->base.netif), modem_netif_input_rx_buffer) != ERR_OK) {
+        esp_netif_free_rx_buffer(driver->base.netif, p);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Feed a decoded PPP frame to the PPP stack, runs in the tcpip thread
+ *
+ * @param p frame: protocol number followed by the information field
+ * @param inp lwip netif of the PPP interface
+ *
+ * @return ERR_OK
+ */
+static err_t modem_netif_input_frame(struct pbuf *p, struct netif *inp)
+{
+    ppp_pcb *ppp = inp->state;
+    /* takes the ownership of the pbuf */
+    ppp_input(ppp, p);
+    return ERR_OK;
+}
+
+/**
+ * @brief Decoded frame path callback from esp-modem, takes the ownership of the rx buffer
+ *
+ * @param rx_buffer rx buffer (pbuf) holding the frame
+ * @param offset offset of the frame in the rx buffer
+ * @param len frame length
+ * @param context context data used for esp-modem-netif handle
+ *
+ * @return ESP_OK on success
+ */
+static esp_err_t modem_netif_receive_frame(void *rx_buffer, size_t offset, size_t len, void *context)
+{
+    esp_modem_netif_driver_t *driver = context;
+    struct pbuf *p = rx_buffer;
+    pbuf_remove_header(p, offset);
+    pbuf_realloc(p, len);
+    if (tcpip_inpkt(p, esp_netif_get_netif_impl(driver->base.netif), modem_netif_input_frame) != ERR_OK) {
+        esp_netif_free_rx_buffer(driver->base.netif, p);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
 void *esp_modem_netif_setup(modem_dte_t *dte)
 {
-    esp_modem_netif_driver_t *driver =  calloc(1, sizeof(esp_modem_netif_driver_t));
+    esp_modem_netif_driver_t *driver = esp_modem_arena_calloc(esp_modem_dte_get_arena(dte), sizeof(esp_modem_netif_driver_t));
     if (driver == NULL) {
         ESP_LOGE(TAG, "Cannot allocate esp_modem_netif_driver_t");
         goto drv_create_failed;
@@ -117,6 +263,18 @@ void *esp_modem_netif_setup(modem_dte_t *dte)
         ESP_LOGE(TAG, "esp_modem_set_rx_cb failed with: %d", err);
         goto drv_create_failed;
     }
+    const esp_modem_rx_buffer_ops_t rx_buffer_ops = {
+            .get = modem_netif_get_rx_buffer,
+            .receive = modem_netif_receive_rx_buffer,
+            .free = modem_netif_free_rx_buffer,
+            .receive_frame = modem_netif_receive_frame,
+            .context = driver
+    };
+    err = esp_modem_set_rx_buffer_ops(dte, &rx_buffer_ops);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_modem_set_rx_buffer_ops failed with: %d", err);
+        goto drv_create_failed;
+    }
 
     driver->base.post_attach = esp_modem_post_attach_start;
     driver->dte = dte;
@@ -129,7 +287,8 @@ drv_create_failed:
 void esp_modem_netif_teardown(void *h)
 {
     esp_modem_netif_driver_t *driver = h;
-    free(driver);
+    esp_modem_set_rx_buffer_ops(driver->dte, NULL);
+    esp_modem_arena_free(esp_modem_dte_get_arena(driver->dte), driver);
 }
 
 esp_err_t esp_modem_netif_clear_default_handlers(void *h)
@@ -144,6 +303,10 @@ esp_err_t esp_modem_netif_clear_default_handlers(void *h)
     if (ret != ESP_OK) {
         goto clear_event_failed;
     }
+    ret = esp_event_handler_unregister(IP_EVENT, IP_EVENT_PPP_GOT_IP, on_ppp_got_ip);
+    if (ret != ESP_OK) {
+        goto clear_event_failed;
+    }
     return ESP_OK;
 
 clear_event_failed:
@@ -172,6 +335,10 @@ esp_err_t esp_modem_netif_set_default_handlers(void *h, esp_netif_t * esp_netif)
     if (ret != ESP_OK) {
         goto set_event_failed;
     }
+    ret = esp_event_handler_register(IP_EVENT, IP_EVENT_PPP_GOT_IP, on_ppp_got_ip, NULL);
+    if (ret != ESP_OK) {
+        goto set_event_failed;
+    }
     return ESP_OK;
 
 set_event_failed:
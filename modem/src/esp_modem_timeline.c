@@ -0,0 +1,176 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdbool.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_modem_timeline.h"
+
+static const char *TIMELINE_TAG = "esp-modem-timeline";
+
+static const char *const s_milestone_names[ESP_MODEM_MILESTONE_MAX] = {
+    [ESP_MODEM_MILESTONE_DTE_INIT_START] = "dte_init_start",
+    [ESP_MODEM_MILESTONE_DTE_INIT_DONE] = "dte_init_done",
+    [ESP_MODEM_MILESTONE_DCE_INIT] = "dce_init",
+    [ESP_MODEM_MILESTONE_RDY] = "rdy",
+    [ESP_MODEM_MILESTONE_SIM_READY] = "sim_ready",
+    [ESP_MODEM_MILESTONE_CONFIGURE_START] = "configure_start",
+    [ESP_MODEM_MILESTONE_SYNC] = "sync",
+    [ESP_MODEM_MILESTONE_FACTORY_RESET] = "factory_reset",
+    [ESP_MODEM_MILESTONE_ECHO_OFF] = "echo_off",
+    [ESP_MODEM_MILESTONE_BAUDRATE] = "baudrate",
+    [ESP_MODEM_MILESTONE_SIM_STATUS] = "sim_status",
+    [ESP_MODEM_MILESTONE_DTR_MODE] = "dtr_mode",
+    [ESP_MODEM_MILESTONE_FAST_SHUTDOWN] = "fast_shutdown",
+    [ESP_MODEM_MILESTONE_CONFIGURE_DONE] = "configure_done",
+    [ESP_MODEM_MILESTONE_MODULE_INFO] = "module_info",
+    [ESP_MODEM_MILESTONE_REGISTERED] = "registered",
+    [ESP_MODEM_MILESTONE_PPP_START] = "ppp_start",
+    [ESP_MODEM_MILESTONE_CONNECT] = "connect",
+    [ESP_MODEM_MILESTONE_LCP_UP] = "lcp_up",
+    [ESP_MODEM_MILESTONE_IP_ACQUIRED] = "ip_acquired",
+    [ESP_MODEM_MILESTONE_PPP_STOP] = "ppp_stop",
+};
+
+/**
+ * @brief Lifecycle timeline
+ *
+ */
+static struct {
+    portMUX_TYPE lock;                                          /*!< Protects the timeline */
+    esp_modem_timeline_entry_t ring[ESP_MODEM_TIMELINE_SIZE];   /*!< Milestones, oldest ones overwritten */
+    uint32_t count;                                             /*!< Milestones recorded (free running) */
+    int64_t last[ESP_MODEM_MILESTONE_MAX];                      /*!< Latest time of each milestone, -1 if none */
+    bool initialized;                                           /*!< last[] has been initialized */
+} s_timeline = {
+    .lock = portMUX_INITIALIZER_UNLOCKED
+};
+
+/**
+ * @brief Clear the timeline, called with the lock held
+ */
+static void timeline_clear(void)
+{
+    s_timeline.count = 0;
+    for (int i = 0; i < ESP_MODEM_MILESTONE_MAX; i++) {
+        s_timeline.last[i] = -1;
+    }
+    s_timeline.initialized = true;
+}
+
+void esp_modem_timeline_mark(esp_modem_milestone_t milestone)
+{
+    if (milestone >= ESP_MODEM_MILESTONE_MAX) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_timeline.lock);
+    if (!s_timeline.initialized) {
+        timeline_clear();
+    }
+    esp_modem_timeline_entry_t *entry = &s_timeline.ring[s_timeline.count % ESP_MODEM_TIMELINE_SIZE];
+    entry->milestone = milestone;
+    entry->time_us = now;
+    s_timeline.count++;
+    s_timeline.last[milestone] = now;
+    portEXIT_CRITICAL(&s_timeline.lock);
+}
+
+void esp_modem_timeline_reset(void)
+{
+    portENTER_CRITICAL(&s_timeline.lock);
+    timeline_clear();
+    portEXIT_CRITICAL(&s_timeline.lock);
+}
+
+size_t esp_modem_timeline_get(esp_modem_timeline_entry_t *entries, size_t max)
+{
+    size_t copied = 0;
+    portENTER_CRITICAL(&s_timeline.lock);
+    uint32_t kept = s_timeline.count < ESP_MODEM_TIMELINE_SIZE ? s_timeline.count : ESP_MODEM_TIMELINE_SIZE;
+    for (uint32_t i = s_timeline.count - kept; i < s_timeline.count && copied < max; i++) {
+        entries[copied++] = s_timeline.ring[i % ESP_MODEM_TIMELINE_SIZE];
+    }
+    portEXIT_CRITICAL(&s_timeline.lock);
+    return copied;
+}
+
+int64_t esp_modem_timeline_get_time(esp_modem_milestone_t milestone)
+{
+    int64_t time_us = -1;
+    if (milestone >= ESP_MODEM_MILESTONE_MAX) {
+        return -1;
+    }
+    portENTER_CRITICAL(&s_timeline.lock);
+    if (s_timeline.initialized) {
+        time_us = s_timeline.last[milestone];
+    }
+    portEXIT_CRITICAL(&s_timeline.lock);
+    return time_us;
+}
+
+/**
+ * @brief Duration between two milestones, -1 if unknown or out of order
+ */
+static int64_t phase_duration(esp_modem_milestone_t from, esp_modem_milestone_t to)
+{
+    int64_t start = esp_modem_timeline_get_time(from);
+    int64_t end = esp_modem_timeline_get_time(to);
+    if (start < 0 || end < start) {
+        return -1;
+    }
+    return end - start;
+}
+
+esp_err_t esp_modem_timeline_get_phases(esp_modem_timeline_phases_t *phases)
+{
+    if (phases == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    phases->dte_init_us = phase_duration(ESP_MODEM_MILESTONE_DTE_INIT_START, ESP_MODEM_MILESTONE_DTE_INIT_DONE);
+    phases->module_boot_us = phase_duration(ESP_MODEM_MILESTONE_DTE_INIT_DONE, ESP_MODEM_MILESTONE_RDY);
+    phases->configure_us = phase_duration(ESP_MODEM_MILESTONE_CONFIGURE_START, ESP_MODEM_MILESTONE_CONFIGURE_DONE);
+    phases->module_info_us = phase_duration(ESP_MODEM_MILESTONE_CONFIGURE_DONE, ESP_MODEM_MILESTONE_MODULE_INFO);
+    phases->registration_us = phase_duration(ESP_MODEM_MILESTONE_CONFIGURE_DONE, ESP_MODEM_MILESTONE_REGISTERED);
+    phases->dial_us = phase_duration(ESP_MODEM_MILESTONE_PPP_START, ESP_MODEM_MILESTONE_CONNECT);
+    phases->lcp_us = phase_duration(ESP_MODEM_MILESTONE_CONNECT, ESP_MODEM_MILESTONE_LCP_UP);
+    phases->ip_us = phase_duration(ESP_MODEM_MILESTONE_LCP_UP, ESP_MODEM_MILESTONE_IP_ACQUIRED);
+    phases->total_us = phase_duration(ESP_MODEM_MILESTONE_DTE_INIT_START, ESP_MODEM_MILESTONE_IP_ACQUIRED);
+    return ESP_OK;
+}
+
+const char *esp_modem_milestone_name(esp_modem_milestone_t milestone)
+{
+    if (milestone >= ESP_MODEM_MILESTONE_MAX) {
+        return "unknown";
+    }
+    return s_milestone_names[milestone];
+}
+
+void esp_modem_timeline_log(void)
+{
+    esp_modem_timeline_entry_t entries[ESP_MODEM_TIMELINE_SIZE];
+    size_t count = esp_modem_timeline_get(entries, ESP_MODEM_TIMELINE_SIZE);
+    for (size_t i = 0; i < count; i++) {
+        ESP_LOGI(TIMELINE_TAG, "%10lld us %s", entries[i].time_us, esp_modem_milestone_name(entries[i].milestone));
+    }
+    esp_modem_timeline_phases_t phases;
+    esp_modem_timeline_get_phases(&phases);
+    ESP_LOGI(TIMELINE_TAG, "dte init %lld, module boot %lld, configure %lld, module info %lld, registration %lld (us)",
+             phases.dte_init_us, phases.module_boot_us, phases.configure_us, phases.module_info_us,
+             phases.registration_us);
+    ESP_LOGI(TIMELINE_TAG, "dial %lld, lcp %lld, ip %lld, total %lld (us)",
+             phases.dial_us, phases.lcp_us, phases.ip_us, phases.total_us);
+}
@@ -0,0 +1,238 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * PPP receive framing: esp_modem_hdlc_decode() against the byte at a time state machine of lwIP's pppos_input()
+ * (flag/escape/ACCM test and FCS table update per byte, then a copy into the frame buffer).
+ *
+ *   bench_hdlc [iterations]
+ *
+ * Both decoders must deliver every frame of the stream with a good FCS, the test fails otherwise.
+ */
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAVE_TSC 1
+#endif
+#include "esp_modem_hdlc.h"
+#include "host_test.h"
+
+#define STREAM_FRAMES   (512)
+#define MRU             (1500)
+
+static uint16_t s_fcs_table[256];
+static uint8_t s_frame_buffer[MRU + ESP_MODEM_HDLC_OVERHEAD];
+static uint32_t s_delivered;
+
+static void fcs_table_init(void)
+{
+    for (int i = 0; i < 256; i++) {
+        uint16_t v = i;
+        for (int b = 0; b < 8; b++) {
+            v = (v & 1) ? (v >> 1) ^ 0x8408 : v >> 1;
+        }
+        s_fcs_table[i] = v;
+    }
+}
+
+static inline uint16_t fcs_byte(uint16_t fcs, uint8_t c)
+{
+    return (fcs >> 8) ^ s_fcs_table[(fcs ^ c) & 0xFF];
+}
+
+static size_t put_escaped(uint8_t *out, uint8_t c)
+{
+    if (c == ESP_MODEM_HDLC_FLAG || c == ESP_MODEM_HDLC_ESCAPE) {
+        out[0] = ESP_MODEM_HDLC_ESCAPE;
+        out[1] = c ^ ESP_MODEM_HDLC_TRANS;
+        return 2;
+    }
+    out[0] = c;
+    return 1;
+}
+
+/**
+ * @brief Encode one frame with address/control fields and an ACCM of 0, as pppos_output() does after LCP
+ */
+static size_t encode_frame(const uint8_t *data, size_t len, uint8_t *out)
+{
+    const uint8_t header[] = { 0xFF, 0x03 };
+    uint16_t fcs = ESP_MODEM_HDLC_FCS_INIT;
+    size_t pos = 0;
+    out[pos++] = ESP_MODEM_HDLC_FLAG;
+    for (size_t i = 0; i < sizeof(header); i++) {
+        fcs = fcs_byte(fcs, header[i]);
+        pos += put_escaped(out + pos, header[i]);
+    }
+    for (size_t i = 0; i < len; i++) {
+        fcs = fcs_byte(fcs, data[i]);
+        pos += put_escaped(out + pos, data[i]);
+    }
+    fcs ^= 0xFFFF;
+    pos += put_escaped(out + pos, fcs & 0xFF);
+    pos += put_escaped(out + pos, fcs >> 8);
+    out[pos++] = ESP_MODEM_HDLC_FLAG;
+    return pos;
+}
+
+/**
+ * @brief Byte at a time decoder, following pppos_input()
+ */
+typedef struct {
+    uint32_t in_accm;
+    bool escaped;
+    uint16_t fcs;
+    size_t len;
+    uint32_t frames;
+    uint32_t errors;
+} bytewise_decoder_t;
+
+static void bytewise_decode(bytewise_decoder_t *d, const uint8_t *data, size_t len)
+{
+    while (len--) {
+        uint8_t c = *data++;
+        if (c == ESP_MODEM_HDLC_FLAG) {
+            if (d->len) {
+                if (d->fcs == ESP_MODEM_HDLC_FCS_GOOD && d->len >= 4) {
+                    d->frames++;
+                    s_delivered += d->len - 2;
+                } else {
+                    d->errors++;
+                }
+            }
+            d->len = 0;
+            d->fcs = ESP_MODEM_HDLC_FCS_INIT;
+            d->escaped = false;
+            continue;
+        }
+        if (c < 0x20 && (d->in_accm & (1u << c))) {
+            continue;
+        }
+        if (c == ESP_MODEM_HDLC_ESCAPE) {
+            d->escaped = true;
+            continue;
+        }
+        if (d->escaped) {
+            c ^= ESP_MODEM_HDLC_TRANS;
+            d->escaped = false;
+        }
+        d->fcs = fcs_byte(d->fcs, c);
+        if (d->len < sizeof(s_frame_buffer)) {
+            s_frame_buffer[d->len++] = c;
+        }
+    }
+}
+
+static void *frame_get(size_t size, uint8_t **payload, void *context)
+{
+    *payload = s_frame_buffer;
+    return s_frame_buffer;
+}
+
+static void frame_deliver(void *frame, size_t offset, size_t len, void *context)
+{
+    s_delivered += len;
+}
+
+static void frame_drop(void *frame, void *context)
+{
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint64_t now_cycles(void)
+{
+#ifdef BENCH_HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static void report(const char *name, size_t bytes, double ns, uint64_t cycles)
+{
+    if (cycles) {
+        printf("%-12s %8.3f ns/byte %8.1f MB/s %6.3f bytes/cycle\n", name, ns / bytes, bytes * 1e3 / ns,
+               (double)bytes / cycles);
+    } else {
+        printf("%-12s %8.3f ns/byte %8.1f MB/s\n", name, ns / bytes, bytes * 1e3 / ns);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 200;
+    fcs_table_init();
+
+    /* IP sized frames of pseudo random content, flags and escapes where the data has them */
+    static uint8_t payload[MRU];
+    static uint8_t stream[STREAM_FRAMES * (2 * (MRU + 4) + 2)];
+    size_t stream_len = 0;
+    uint32_t seed = 12345;
+    for (int f = 0; f < STREAM_FRAMES; f++) {
+        size_t len = 40 + (f * 97) % (MRU - 40);
+        payload[0] = 0x00;
+        payload[1] = 0x21;
+        for (size_t i = 2; i < len; i++) {
+            seed = seed * 1103515245 + 12345;
+            payload[i] = seed >> 16;
+        }
+        stream_len += encode_frame(payload, len, stream + stream_len);
+    }
+
+    bytewise_decoder_t bytewise = { .fcs = ESP_MODEM_HDLC_FCS_INIT };
+    s_delivered = 0;
+    double start = now_ns();
+    uint64_t cycles = now_cycles();
+    for (int i = 0; i < iterations; i++) {
+        bytewise_decode(&bytewise, stream, stream_len);
+    }
+    cycles = now_cycles() - cycles;
+    double bytewise_ns = now_ns() - start;
+    uint32_t bytewise_delivered = s_delivered;
+    HOST_CHECK(bytewise.frames == (uint32_t)iterations * STREAM_FRAMES);
+    HOST_CHECK(bytewise.errors == 0);
+    report("pppos-like", stream_len * iterations, bytewise_ns, cycles);
+
+    esp_modem_hdlc_decoder_t decoder;
+    const esp_modem_hdlc_frame_ops_t ops = {
+        .get = frame_get,
+        .deliver = frame_deliver,
+        .drop = frame_drop,
+    };
+    esp_modem_hdlc_decoder_init(&decoder, &ops, MRU);
+    s_delivered = 0;
+    start = now_ns();
+    cycles = now_cycles();
+    for (int i = 0; i < iterations; i++) {
+        esp_modem_hdlc_decode(&decoder, stream, stream_len);
+    }
+    cycles = now_cycles() - cycles;
+    double hdlc_ns = now_ns() - start;
+    HOST_CHECK(decoder.frames == (uint32_t)iterations * STREAM_FRAMES);
+    HOST_CHECK(decoder.fcs_errors == 0 && decoder.dropped == 0);
+    /* the address/control fields are stripped, the protocol field is kept by both */
+    HOST_CHECK(s_delivered == bytewise_delivered - 2 * decoder.frames);
+    report("hdlc", stream_len * iterations, hdlc_ns, cycles);
+
+    printf("speedup      %8.2fx\n", bytewise_ns / hdlc_ns);
+    return 0;
+}
@@ -0,0 +1,159 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Parse time per response line: the field tokenizer of esp_modem_line (including the line classification)
+ * against the sscanf / malloc + strtok_r parsing it replaced in ec21.c.
+ *
+ *   bench_line_parse [iterations]
+ *
+ * Both parsers must read the same values, the test fails otherwise.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include "esp_modem_line.h"
+#include "host_test.h"
+
+#define OPER_SIZE   (32)
+
+static const char CSQ_LINE[] = "+CSQ: 23,99\r\n";
+static const char CREG_LINE[] = "+CREG: 2,1,\"1A2B\",\"01C3D4E\",7\r\n";
+static const char COPS_LINE[] = "+COPS: 0,0,\"Vodafone, IT\",7\r\n";
+
+typedef struct {
+    int32_t a;
+    int32_t b;
+    uint32_t lac;
+    uint32_t ci;
+    int32_t act;
+    char oper[OPER_SIZE];
+} parsed_t;
+
+static void csq_sscanf(const char *text, parsed_t *out)
+{
+    int rssi, ber;
+    sscanf(text + strlen("+CSQ: "), "%d,%d", &rssi, &ber);
+    out->a = rssi;
+    out->b = ber;
+}
+
+static void csq_fields(const char *text, parsed_t *out)
+{
+    esp_modem_line_t line;
+    esp_modem_fields_t fields;
+    esp_modem_line_classify(text, &line);
+    esp_modem_fields_init(&fields, &line);
+    esp_modem_fields_int(&fields, &out->a);
+    esp_modem_fields_int(&fields, &out->b);
+}
+
+static void creg_sscanf(const char *text, parsed_t *out)
+{
+    int stat = 0, act = -1;
+    unsigned int lac = 0, ci = 0;
+    /* <n> skipped, then <stat>[,"<lac>","<ci>"[,<AcT>]] */
+    const char *params = strchr(text, ',') + 1;
+    sscanf(params, "%d,\"%x\",\"%x\",%d", &stat, &lac, &ci, &act);
+    out->a = stat;
+    out->lac = lac;
+    out->ci = ci;
+    out->act = act;
+}
+
+static void creg_fields(const char *text, parsed_t *out)
+{
+    esp_modem_line_t line;
+    esp_modem_fields_t fields;
+    esp_modem_line_classify(text, &line);
+    esp_modem_fields_init(&fields, &line);
+    esp_modem_fields_skip(&fields, 1);
+    esp_modem_fields_int(&fields, &out->a);
+    esp_modem_fields_hex(&fields, &out->lac);
+    esp_modem_fields_hex(&fields, &out->ci);
+    esp_modem_fields_int(&fields, &out->act);
+}
+
+static void cops_strtok(const char *text, parsed_t *out)
+{
+    size_t len = strcspn(text, "\r\n");
+    char *line_copy = malloc(len + 1);
+    memcpy(line_copy, text, len);
+    line_copy[len] = '\0';
+    char *str_ptr = NULL;
+    char *p[8];
+    int i = 0;
+    p[i] = strtok_r(line_copy, ",", &str_ptr);
+    while (p[i] && i < 7) {
+        p[++i] = strtok_r(NULL, ",", &str_ptr);
+    }
+    /* the name was split on its ',' and kept its quotes: join the pieces and strip the quotes, as the tokenizer does */
+    snprintf(out->oper, sizeof(out->oper), "%s,%s", p[2] + 1, p[3]);
+    out->oper[strlen(out->oper) - 1] = '\0';
+    free(line_copy);
+}
+
+static void cops_fields(const char *text, parsed_t *out)
+{
+    esp_modem_line_t line;
+    esp_modem_fields_t fields;
+    esp_modem_line_classify(text, &line);
+    esp_modem_fields_init(&fields, &line);
+    esp_modem_fields_skip(&fields, 2);
+    esp_modem_fields_str(&fields, out->oper, sizeof(out->oper));
+}
+
+typedef void (*parse_fn_t)(const char *text, parsed_t *out);
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static double time_parser(parse_fn_t parse, const char *text, int iterations, parsed_t *out)
+{
+    /* the line is copied to a buffer the compiler cannot see through, as the line buffer of the DTE */
+    static char buffer[128];
+    strcpy(buffer, text);
+    __asm__ volatile("" : : "r"(buffer) : "memory");
+    double start = now_ns();
+    for (int i = 0; i < iterations; i++) {
+        parse(buffer, out);
+        __asm__ volatile("" : : "r"(out) : "memory");
+    }
+    return (now_ns() - start) / iterations;
+}
+
+static void compare(const char *name, const char *label, parse_fn_t reference, parse_fn_t tokenizer,
+                    const char *text, int iterations)
+{
+    parsed_t expected = { 0 };
+    parsed_t actual = { 0 };
+    double reference_ns = time_parser(reference, text, iterations, &expected);
+    double tokenizer_ns = time_parser(tokenizer, text, iterations, &actual);
+    HOST_CHECK(!memcmp(&expected, &actual, sizeof(parsed_t)));
+    printf("%-6s %-16s %6.1f ns   tokenizer %6.1f ns\n", name, label, reference_ns, tokenizer_ns);
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 2000000;
+    compare("CSQ", "sscanf", csq_sscanf, csq_fields, CSQ_LINE, iterations);
+    compare("CREG", "sscanf", creg_sscanf, creg_fields, CREG_LINE, iterations);
+    compare("COPS", "malloc+strtok_r", cops_strtok, cops_fields, COPS_LINE, iterations);
+    return 0;
+}
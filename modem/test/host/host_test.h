@@ -0,0 +1,34 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * @brief Minimal checks for the host tests, a failed check ends the test with a non zero exit code
+ */
+#define HOST_CHECK(cond)                                                            \
+    do {                                                                            \
+        if (!(cond)) {                                                              \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(1);                                                                \
+        }                                                                           \
+    } while (0)
+
+#define HOST_RUN(test)                      \
+    do {                                    \
+        printf("%s\n", #test);              \
+        test();                             \
+    } while (0)
@@ -0,0 +1,8 @@
+// Host stand-in of freertos/FreeRTOS.h, for the host tests only: one tick per millisecond
+#pragma once
+
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
@@ -0,0 +1,6 @@
+// Host stand-in of freertos/task.h, for the host tests only: implemented by the test
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+void vTaskDelay(TickType_t ticks);
@@ -0,0 +1,125 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <string.h>
+#include "driver/gpio.h"
+#include "freertos/task.h"
+#include "esp_modem_dtr.h"
+#include "host_test.h"
+
+#define DTR_PIN     (25)
+#define MAX_EVENTS  (16)
+
+/**
+ * @brief GPIO stand-in: pin state and level changes on a simulated clock
+ */
+typedef struct {
+    uint32_t now_ms;
+    int output_pin;
+    int level;
+    int reset_pin;
+    struct {
+        uint32_t at_ms;
+        int level;
+    } changes[MAX_EVENTS];
+    int count;
+} gpio_standin_t;
+
+static gpio_standin_t s_gpio;
+
+esp_err_t gpio_config(const gpio_config_t *config)
+{
+    HOST_CHECK(config->mode == GPIO_MODE_OUTPUT);
+    HOST_CHECK(config->intr_type == GPIO_INTR_DISABLE);
+    for (int pin = 0; pin < 64; pin++) {
+        if (config->pin_bit_mask == (1ULL << pin)) {
+            s_gpio.output_pin = pin;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t gpio_set_level(int gpio_num, uint32_t level)
+{
+    HOST_CHECK(gpio_num == s_gpio.output_pin);
+    HOST_CHECK(s_gpio.count < MAX_EVENTS);
+    s_gpio.level = level;
+    s_gpio.changes[s_gpio.count].at_ms = s_gpio.now_ms;
+    s_gpio.changes[s_gpio.count].level = level;
+    s_gpio.count++;
+    return ESP_OK;
+}
+
+esp_err_t gpio_reset_pin(int gpio_num)
+{
+    s_gpio.reset_pin = gpio_num;
+    s_gpio.output_pin = -1;
+    return ESP_OK;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    s_gpio.now_ms += ticks;
+}
+
+static void reset_standin(void)
+{
+    memset(&s_gpio, 0, sizeof(s_gpio));
+    s_gpio.output_pin = -1;
+    s_gpio.reset_pin = -1;
+    s_gpio.level = -1;
+}
+
+static void test_init_drives_dtr_on(void)
+{
+    reset_standin();
+    HOST_CHECK(esp_modem_dtr_init(DTR_PIN) == ESP_OK);
+    HOST_CHECK(s_gpio.output_pin == DTR_PIN);
+    /* active low */
+    HOST_CHECK(s_gpio.count == 1 && s_gpio.level == 0);
+    esp_modem_dtr_deinit(DTR_PIN);
+    HOST_CHECK(s_gpio.reset_pin == DTR_PIN);
+}
+
+static void test_pulse(void)
+{
+    reset_standin();
+    HOST_CHECK(esp_modem_dtr_init(DTR_PIN) == ESP_OK);
+    s_gpio.now_ms = 1000;
+    HOST_CHECK(esp_modem_dtr_pulse(DTR_PIN, 20) == ESP_OK);
+    /* off (high) for 20 ms, then on again: tens of milliseconds instead of the 1 s "+++" guard time */
+    HOST_CHECK(s_gpio.count == 3);
+    HOST_CHECK(s_gpio.changes[1].level == 1 && s_gpio.changes[1].at_ms == 1000);
+    HOST_CHECK(s_gpio.changes[2].level == 0 && s_gpio.changes[2].at_ms == 1020);
+    HOST_CHECK(s_gpio.level == 0);
+}
+
+static void test_not_wired(void)
+{
+    reset_standin();
+    HOST_CHECK(esp_modem_dtr_init(-1) == ESP_OK);
+    HOST_CHECK(esp_modem_dtr_pulse(-1, 20) == ESP_ERR_NOT_SUPPORTED);
+    esp_modem_dtr_deinit(-1);
+    /* the pin is never touched */
+    HOST_CHECK(s_gpio.count == 0 && s_gpio.output_pin == -1 && s_gpio.reset_pin == -1);
+    HOST_CHECK(s_gpio.now_ms == 0);
+}
+
+int main(void)
+{
+    HOST_RUN(test_init_drives_dtr_on);
+    HOST_RUN(test_pulse);
+    HOST_RUN(test_not_wired);
+    return 0;
+}
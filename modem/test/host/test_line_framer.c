@@ -0,0 +1,193 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <string.h>
+#include "esp_modem_line_framer.h"
+#include "host_test.h"
+
+#define RING_SIZE   (64)
+#define LINE_SIZE   (16)
+#define MAX_LINES   (32)
+
+/**
+ * @brief Segments received by the callback, joined back into lines
+ */
+typedef struct {
+    char lines[MAX_LINES][RING_SIZE * 4];
+    int segments[MAX_LINES];
+    int count;
+    char current[RING_SIZE * 4];
+    int current_segments;
+} collector_t;
+
+static uint8_t s_ring[RING_SIZE];
+static char s_line[LINE_SIZE];
+
+static void collect(void *context, const char *segment, size_t len, bool line_end)
+{
+    collector_t *c = context;
+    HOST_CHECK(len <= LINE_SIZE - 1);
+    HOST_CHECK(strlen(segment) == len);
+    strncat(c->current, segment, len);
+    c->current_segments++;
+    if (line_end) {
+        HOST_CHECK(c->count < MAX_LINES);
+        strcpy(c->lines[c->count], c->current);
+        c->segments[c->count] = c->current_segments;
+        c->count++;
+        c->current[0] = '\0';
+        c->current_segments = 0;
+    }
+}
+
+static void setup(esp_modem_line_framer_t *framer, collector_t *c)
+{
+    memset(c, 0, sizeof(*c));
+    HOST_CHECK(esp_modem_line_framer_init(framer, s_ring, sizeof(s_ring), s_line, sizeof(s_line), collect, c));
+}
+
+static void feed_str(esp_modem_line_framer_t *framer, const char *str)
+{
+    esp_modem_line_framer_feed(framer, (const uint8_t *)str, strlen(str));
+}
+
+static void test_init_rejects_bad_sizes(void)
+{
+    esp_modem_line_framer_t framer;
+    HOST_CHECK(!esp_modem_line_framer_init(&framer, s_ring, 48, s_line, sizeof(s_line), collect, NULL));
+    HOST_CHECK(!esp_modem_line_framer_init(&framer, s_ring, 16, s_line, sizeof(s_line), collect, NULL));
+    HOST_CHECK(!esp_modem_line_framer_init(&framer, s_ring, sizeof(s_ring), s_line, 1, collect, NULL));
+}
+
+static void test_split_lines(void)
+{
+    esp_modem_line_framer_t framer;
+    collector_t c;
+    setup(&framer, &c);
+    /* one byte at a time, lines split at every position */
+    const char *stream = "\r\nOK\r\n+CSQ: 20,99\r\n\r\nOK\r\n";
+    for (const char *p = stream; *p; p++) {
+        esp_modem_line_framer_feed(&framer, (const uint8_t *)p, 1);
+    }
+    HOST_CHECK(c.count == 5);
+    HOST_CHECK(!strcmp(c.lines[0], "\r\n"));
+    HOST_CHECK(!strcmp(c.lines[1], "OK\r\n"));
+    HOST_CHECK(!strcmp(c.lines[2], "+CSQ: 20,99\r\n"));
+    HOST_CHECK(!strcmp(c.lines[3], "\r\n"));
+    HOST_CHECK(!strcmp(c.lines[4], "OK\r\n"));
+    HOST_CHECK(esp_modem_line_framer_pending(&framer) == 0);
+
+    /* a partial line waits in the ring for its end */
+    feed_str(&framer, "+CREG: 0,");
+    HOST_CHECK(c.count == 5);
+    HOST_CHECK(esp_modem_line_framer_pending(&framer) == 9);
+    feed_str(&framer, "1\r\nOK");
+    HOST_CHECK(c.count == 6);
+    HOST_CHECK(!strcmp(c.lines[5], "+CREG: 0,1\r\n"));
+    HOST_CHECK(esp_modem_line_framer_pending(&framer) == 2);
+}
+
+static void test_overlong_line(void)
+{
+    esp_modem_line_framer_t framer;
+    collector_t c;
+    setup(&framer, &c);
+    /* 37 bytes with a 15 bytes line buffer: passed in segments, the last one ends the line */
+    const char *line = "+QENG: \"servingcell\",\"NOCONN\",\"LTE\"\r\n";
+    feed_str(&framer, line);
+    HOST_CHECK(c.count == 1);
+    HOST_CHECK(!strcmp(c.lines[0], line));
+    HOST_CHECK(c.segments[0] == (int)(strlen(line) + LINE_SIZE - 2) / (LINE_SIZE - 1));
+
+    /* a line without end longer than the line buffer is passed on before the ring fills up */
+    char junk[RING_SIZE * 2];
+    memset(junk, 'x', sizeof(junk));
+    esp_modem_line_framer_feed(&framer, (const uint8_t *)junk, sizeof(junk));
+    HOST_CHECK(esp_modem_line_framer_pending(&framer) < LINE_SIZE);
+    feed_str(&framer, "\r\nOK\r\n");
+    HOST_CHECK(c.count == 3);
+    HOST_CHECK(strlen(c.lines[1]) == sizeof(junk) + 2);
+    HOST_CHECK(!strcmp(c.lines[2], "OK\r\n"));
+}
+
+static void test_ring_wrap(void)
+{
+    esp_modem_line_framer_t framer;
+    collector_t c;
+    setup(&framer, &c);
+    /* lines of 7 bytes move the write position across the ring end at changing offsets */
+    for (int i = 0; i < 3 * RING_SIZE; i++) {
+        char line[8];
+        snprintf(line, sizeof(line), "L%03d\r\n", i % 1000);
+        feed_str(&framer, line);
+        HOST_CHECK(c.count == 1);
+        HOST_CHECK(!strcmp(c.lines[0], line));
+        c.count = 0;
+    }
+    HOST_CHECK(framer.head > RING_SIZE);
+
+    /* in place writes stop at the ring end, the line continues at the start */
+    setup(&framer, &c);
+    feed_str(&framer, "0123456789abcdef0123456789abcdef0123456789abcdef0123456\r\n");
+    c.count = 0;
+    const char *line = "+CSQ: 31,99\r\n";
+    uint8_t *ptr;
+    size_t room = esp_modem_line_framer_get_write_ptr(&framer, &ptr);
+    HOST_CHECK(room == RING_SIZE - 57);
+    memcpy(ptr, line, room);
+    esp_modem_line_framer_commit(&framer, room);
+    HOST_CHECK(c.count == 0);
+    HOST_CHECK(esp_modem_line_framer_get_write_ptr(&framer, &ptr) == RING_SIZE - room);
+    HOST_CHECK(ptr == s_ring);
+    memcpy(ptr, line + room, strlen(line) - room);
+    esp_modem_line_framer_commit(&framer, strlen(line) - room);
+    HOST_CHECK(c.count == 1);
+    HOST_CHECK(!strcmp(c.lines[0], "+CSQ: 31,99\r\n"));
+}
+
+static void test_prompt(void)
+{
+    esp_modem_line_framer_t framer;
+    collector_t c;
+    setup(&framer, &c);
+    /* "> " of AT+CMGS has no line end: it stays pending until taken as a prompt */
+    feed_str(&framer, "\r\n> ");
+    HOST_CHECK(c.count == 1);
+    HOST_CHECK(!esp_modem_line_framer_consume_prompt(&framer, ">>", 2));
+    HOST_CHECK(esp_modem_line_framer_consume_prompt(&framer, "> ", 2));
+    HOST_CHECK(esp_modem_line_framer_pending(&framer) == 0);
+
+    /* an incomplete prompt is not consumed */
+    feed_str(&framer, ">");
+    HOST_CHECK(!esp_modem_line_framer_consume_prompt(&framer, "> ", 2));
+    feed_str(&framer, " ");
+    HOST_CHECK(esp_modem_line_framer_consume_prompt(&framer, "> ", 2));
+
+    /* raw data after a line are taken out without line processing */
+    feed_str(&framer, "CONNECT\r\n~\x7d\x23~");
+    HOST_CHECK(c.count == 2);
+    HOST_CHECK(!strcmp(c.lines[1], "CONNECT\r\n"));
+    uint8_t raw[8];
+    HOST_CHECK(esp_modem_line_framer_take(&framer, raw, sizeof(raw)) == 4);
+    HOST_CHECK(!memcmp(raw, "~\x7d\x23~", 4));
+}
+
+int main(void)
+{
+    HOST_RUN(test_init_rejects_bad_sizes);
+    HOST_RUN(test_split_lines);
+    HOST_RUN(test_overlong_line);
+    HOST_RUN(test_ring_wrap);
+    HOST_RUN(test_prompt);
+    return 0;
+}
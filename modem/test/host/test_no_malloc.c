@@ -0,0 +1,179 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Simulated command mode session with the static configuration: the buffers come from an arena, then responses
+ * and unsolicited result codes go through the line framer, the classifier, the field tokenizer and the event ring.
+ * malloc, calloc, realloc and free are wrapped at link time (-Wl,--wrap) and must not be called by the session.
+ */
+#include <string.h>
+#include "esp_modem_arena.h"
+#include "esp_modem_event_ring.h"
+#include "esp_modem_line.h"
+#include "esp_modem_line_framer.h"
+#include "host_test.h"
+
+#define LINE_BUFFER_SIZE    (128)
+#define LINE_RING_SIZE      (256)
+#define EVENT_RING_SLOTS    (8)
+#define ARENA_SIZE          (2048)
+#define SESSION_CHUNKS      (100000)
+
+static uint32_t s_heap_calls;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+void *__wrap_malloc(size_t size)
+{
+    s_heap_calls++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+    s_heap_calls++;
+    return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    s_heap_calls++;
+    return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void *ptr)
+{
+    s_heap_calls++;
+    __real_free(ptr);
+}
+
+/**
+ * @brief What the DTE and the DCE handlers do with the lines of the session
+ */
+typedef struct {
+    esp_modem_event_ring_t *events;
+    uint32_t finals;
+    uint32_t urcs;
+    uint32_t values;
+    uint32_t events_read;
+    char oper[32];
+} session_t;
+
+static void drain_events(session_t *session)
+{
+    const esp_modem_event_slot_t *slot;
+    while ((slot = esp_modem_event_ring_peek(session->events)) != NULL) {
+        HOST_CHECK(slot->size > 0 && slot->data[slot->size - 1] == '\0');
+        session->events_read++;
+        esp_modem_event_ring_pop(session->events);
+    }
+}
+
+static void on_line(void *context, const char *segment, size_t len, bool line_end)
+{
+    session_t *session = context;
+    HOST_CHECK(line_end);
+    esp_modem_line_t line;
+    esp_modem_line_classify(segment, &line);
+    if (line.len == 0) {
+        return;
+    }
+    esp_modem_fields_t fields;
+    esp_modem_fields_init(&fields, &line);
+    if (esp_modem_line_is_final(&line)) {
+        session->finals++;
+    } else if (esp_modem_line_has_prefix(&line, "+CSQ")) {
+        int32_t rssi, ber;
+        HOST_CHECK(esp_modem_fields_int(&fields, &rssi) && esp_modem_fields_int(&fields, &ber));
+        HOST_CHECK(rssi == 23 && ber == 99);
+        session->values++;
+    } else if (esp_modem_line_has_prefix(&line, "+COPS")) {
+        HOST_CHECK(esp_modem_fields_skip(&fields, 2));
+        HOST_CHECK(esp_modem_fields_str(&fields, session->oper, sizeof(session->oper)));
+        session->values++;
+    } else if (line.type == ESP_MODEM_LINE_URC) {
+        if (esp_modem_line_has_prefix(&line, "+CREG")) {
+            int32_t stat;
+            uint32_t lac, ci;
+            HOST_CHECK(esp_modem_fields_int(&fields, &stat) && esp_modem_fields_hex(&fields, &lac) &&
+                       esp_modem_fields_hex(&fields, &ci));
+            HOST_CHECK(stat == 1 && lac == 0x1A2B && ci == 0x01C3D4E);
+        }
+        session->urcs++;
+        /* published by the UART task, drained on the event loop side */
+        esp_modem_event_ring_push(session->events, 4, segment, len + 1);
+        if (esp_modem_event_ring_pending(session->events) == EVENT_RING_SLOTS) {
+            drain_events(session);
+        }
+    }
+}
+
+int main(void)
+{
+    static uint8_t storage[ARENA_SIZE] __attribute__((aligned(8)));
+    esp_modem_arena_t arena = { .base = storage, .size = sizeof(storage) };
+
+    /* the wrappers see the heap calls of the modem code */
+    uint32_t before = s_heap_calls;
+    esp_modem_arena_free(NULL, esp_modem_arena_calloc(NULL, 16));
+    HOST_CHECK(s_heap_calls == before + 2);
+
+    s_heap_calls = 0;
+    uint8_t *line_ring = esp_modem_arena_calloc(&arena, LINE_RING_SIZE);
+    char *line = esp_modem_arena_calloc(&arena, LINE_BUFFER_SIZE);
+    size_t slot_size = LINE_BUFFER_SIZE + sizeof(int64_t);
+    uint8_t *event_storage = esp_modem_arena_calloc(&arena, ESP_MODEM_EVENT_RING_STORAGE_SIZE(EVENT_RING_SLOTS,
+                                                    slot_size));
+    HOST_CHECK(line_ring && line && event_storage);
+    /* exhausted arenas fail instead of falling back to the heap */
+    HOST_CHECK(esp_modem_arena_calloc(&arena, ARENA_SIZE) == NULL);
+
+    esp_modem_event_ring_t events;
+    HOST_CHECK(esp_modem_event_ring_init(&events, event_storage, EVENT_RING_SLOTS, slot_size));
+    session_t session = { .events = &events };
+    esp_modem_line_framer_t framer;
+    HOST_CHECK(esp_modem_line_framer_init(&framer, line_ring, LINE_RING_SIZE, line, LINE_BUFFER_SIZE, on_line,
+                                          &session));
+
+    static const char stream[] =
+        "\r\n+CSQ: 23,99\r\n\r\nOK\r\n"
+        "\r\n+CREG: 1,\"1A2B\",\"01C3D4E\",7\r\n"
+        "\r\n+COPS: 0,0,\"Vodafone, IT\",7\r\n\r\nOK\r\n"
+        "\r\n+QIND: \"csq\",23,99\r\n"
+        "\r\nRING\r\n";
+    const size_t stream_len = sizeof(stream) - 1;
+    size_t pos = 0;
+    for (uint32_t i = 0; i < SESSION_CHUNKS; i++) {
+        /* UART reads of varying size, lines split anywhere */
+        size_t chunk = 1 + (i * 7) % 41;
+        while (chunk) {
+            size_t len = chunk < stream_len - pos ? chunk : stream_len - pos;
+            esp_modem_line_framer_feed(&framer, (const uint8_t *)stream + pos, len);
+            pos = (pos + len) % stream_len;
+            chunk -= len;
+        }
+    }
+    drain_events(&session);
+
+    printf("%u final result codes, %u values, %u URCs (%u events), %u heap calls\n", session.finals, session.values,
+           session.urcs, session.events_read, s_heap_calls);
+    HOST_CHECK(session.finals > 0 && session.values > 0 && session.urcs > 0);
+    HOST_CHECK(session.events_read == session.urcs);
+    HOST_CHECK(!strcmp(session.oper, "Vodafone, IT"));
+    HOST_CHECK(s_heap_calls == 0);
+    return 0;
+}